@@ -25,6 +25,10 @@ Usage:
         /path/to/pi-webrtc --camera=v4l2:8 --width=1920 --height=1080 ...   # View original camera feed
         /path/to/pi-webrtc --camera=v4l2:9 --width=1920 --height=1080 ...   # View YOLO-processed feed
 
+    6. (Optional) Give the detected objects more bits in the Jetson hardware encoder:
+        /path/to/pi-webrtc --camera=v4l2:8 --hw-accel --enable-ipc --enable-roi ...
+        python ./examples/yolo_cam.py ... --roi-socket /tmp/pi-webrtc-ipc.sock
+
 Requirements:
     - Raspberry Pi with Camera Module
     - v4l2loopback kernel module installed
@@ -33,9 +37,11 @@ Requirements:
 
 import os
 import cv2
+import json
 import time
 import fcntl
 import v4l2
+import socket
 import logging
 import argparse
 from ultralytics import YOLO
@@ -49,16 +55,21 @@ logging.basicConfig(
 
 
 class VirtualCameraStreamer:
-    def __init__(self, input_device, output_device, width=1920, height=1080):
+    def __init__(
+        self, input_device, output_device, width=1920, height=1080, roi_socket=None
+    ):
         self.width = width
         self.height = height
         self.input_device = input_device
         self.output_device = output_device
         self.fd = None
         self.cap = None
+        self.roi_sock = None
 
         self._initialize_camera()
         self._initialize_virtual_device()
+        if roi_socket:
+            self._initialize_roi_socket(roi_socket)
 
     def _initialize_camera(self):
         self.cap = cv2.VideoCapture(self.input_device)
@@ -84,9 +95,29 @@ class VirtualCameraStreamer:
         fcntl.ioctl(self.fd, v4l2.VIDIOC_S_FMT, format)
         logging.info(f"Set virtual camera: {self.output_device}")
 
+    def _initialize_roi_socket(self, path):
+        try:
+            self.roi_sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self.roi_sock.connect(path)
+            logging.info(f"Send the detections as regions of interest to {path}")
+        except OSError as e:
+            logging.warning(f"Failed to connect the roi socket {path}: {e}")
+            self.roi_sock = None
+
+    def _send_regions(self, regions):
+        if not self.roi_sock:
+            return
+        message = {"type": "roi", "ttl": 500, "regions": regions[:8]}
+        try:
+            self.roi_sock.sendall(json.dumps(message).encode())
+        except OSError as e:
+            logging.warning(f"Failed to send the regions: {e}")
+            self.roi_sock = None
+
     def _process_frame(self, frame):
         timestamp = time.strftime("%Y-%m-%d %X")
         results = model(frame)
+        regions = []
 
         for result in results:
             for box in result.boxes:
@@ -94,6 +125,15 @@ class VirtualCameraStreamer:
                 class_id = int(box.cls[0])
                 conf = float(box.conf[0])
                 label = f"{class_names[class_id]} {conf:.2%}"
+                regions.append(
+                    {
+                        "x": x1 / self.width,
+                        "y": y1 / self.height,
+                        "w": (x2 - x1) / self.width,
+                        "h": (y2 - y1) / self.height,
+                        "qp": -8,
+                    }
+                )
 
                 cv2.rectangle(frame, (x1, y1), (x2, y2), (0, 255, 0), 2)
                 text_size, _ = cv2.getTextSize(label, cv2.FONT_HERSHEY_SIMPLEX, 0.5, 2)
@@ -120,6 +160,8 @@ class VirtualCameraStreamer:
                     2,
                 )
 
+        self._send_regions(regions)
+
         yuv_frame = cv2.cvtColor(frame, cv2.COLOR_BGR2YUV_I420)
         try:
             os.write(self.fd, yuv_frame.tobytes())
@@ -153,6 +195,8 @@ class VirtualCameraStreamer:
             self.cap.release()
         if self.fd:
             os.close(self.fd)
+        if self.roi_sock:
+            self.roi_sock.close()
         logging.info("Streaming stopped.")
 
 
@@ -174,6 +218,12 @@ if __name__ == "__main__":
     )
     parser.add_argument("--width", type=int, default=1920, help="Frame width")
     parser.add_argument("--height", type=int, default=1080, help="Frame height")
+    parser.add_argument(
+        "--roi-socket",
+        type=str,
+        default=None,
+        help="The IPC socket of pi-webrtc to send the detections as regions of interest",
+    )
 
     args = parser.parse_args()
 
@@ -182,6 +232,7 @@ if __name__ == "__main__":
         output_device=args.output_device,
         width=args.width,
         height=args.height,
+        roi_socket=args.roi_socket,
     )
 
     streamer.start()
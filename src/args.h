@@ -115,18 +115,55 @@ struct Args {
     int record_mode = -1;
     std::string record_path = "";
     int file_duration = 60;
+    int record_bitrate = 0;    // kbps, 0: derived from the resolution
+    bool record_mjpeg = false; // mux the mjpeg frames into mkv without re-encoding
+    int record_mjpeg_decimation = 1;
+    int thumbnail_width = 640; // 0: same as the recorded stream
+    int max_record_size = 0;
+    int max_record_age = 0;
+    int min_free_space = 400;
+    int timelapse_interval = 1000;
+    int timelapse_fps = 30;
+    float timelapse_motion = 0.0f;
+
+    // low-bitrate proxy recorded alongside the main stream, 0: disabled
+    int proxy_width = 0;
+    int proxy_height = 0;
+    int proxy_bitrate = 0;       // kbps, 0: derived from the resolution
+    int proxy_file_duration = 0; // seconds, 0: same as file_duration
 
     // ipc
     bool enable_ipc = false;
     std::string socket_path = "/tmp/pi-webrtc-ipc.sock";
     std::string ipc_channel = "both";
     int ipc_channel_mode = -1;
+    bool enable_roi = false;
+    bool publish_encoder_stats = false;
 
     // webrtc
     int jpeg_quality = 30;
     int peer_timeout = 10;
     bool hw_accel = false;
     bool no_adaptive = false;
+    bool shared_encoder = false;
+    std::string shared_rate = "median";
+    int shared_rate_policy = 0;
+    int simulcast_layers = 1;
+    bool h264_passthrough = false;
+    int keyframe_merge_window = 250; // ms
+    int keyframe_min_interval = 500; // ms
+    int intra_refresh_period = 0; // frames, 0: recover from the losses with IDR frames
+    // the depth of the v4l2 memory-to-memory queues
+    int decoder_buffers = 2;
+    int encoder_buffers = 2;
+    int scaler_buffers = 2;
+    // the software vp8/vp9 encoders, the speeds of 0 keep WebRTC's own
+    int vp8_cpu_speed = 0;
+    int vp9_speed = 0;
+    int vpx_threads = 0;
+    bool vpx_no_denoise = false;
+    std::string vpx_content = "camera";
+    bool vpx_screen_content = false;
     std::string uid = "";
     std::string stun_url = "stun:stun.l.google.com:19302";
     std::string turn_url = "";
@@ -161,10 +198,15 @@ struct Args {
     std::string car_id = "";
     std::string car_api_key = "";
 
+    // metrics
+    std::string metrics_path = "";
+    int metrics_interval = 5;
+
     // uart control
     bool enable_uart_control = false;
     std::string uart_device = "/dev/ttyS0";
     int uart_baud = 115200;
+    int control_deadman_ms = 500;
 };
 
 #endif // ARGS_H_
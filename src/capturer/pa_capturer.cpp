@@ -1,6 +1,9 @@
 #include "capturer/pa_capturer.h"
 
+#include <time.h>
+
 #include "common/logging.h"
+#include "common/utils.h"
 
 #define BUFSIZE 1024
 #define CHANNELS 2
@@ -51,7 +54,20 @@ void PaCapturer::CaptureSamples() {
         return;
     }
 
-    shared_buffer_ = {.start = buf, .length = BUFSIZE, .channels = CHANNELS};
+    // the samples were captured a buffer duration plus the source latency ago.
+    pa_usec_t latency = pa_simple_get_latency(src, &error);
+    if (latency == (pa_usec_t)-1) {
+        latency = 0;
+    }
+    uint64_t duration_us = (uint64_t)BUFSIZE / CHANNELS * 1000000 / config_.sample_rate;
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t now_ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+    shared_buffer_ = {.start = buf,
+                      .length = BUFSIZE,
+                      .channels = CHANNELS,
+                      .timestamp = Utils::ToTimeval(now_ns - (latency + duration_us) * 1000)};
     Next(shared_buffer_);
 }
 
@@ -1,6 +1,8 @@
 #ifndef PA_CAPTURER_H_
 #define PA_CAPTURER_H_
 
+#include <sys/time.h>
+
 #include <pulse/error.h>
 #include <pulse/simple.h>
 
@@ -12,6 +14,8 @@ struct PaBuffer {
     uint8_t *start;
     unsigned int length;
     unsigned int channels;
+    // capture time of the first sample on CLOCK_MONOTONIC, the same as V4L2 buffers.
+    timeval timestamp;
 };
 
 class PaCapturer : public Subject<PaBuffer> {
@@ -27,6 +27,7 @@ V4L2Capturer::V4L2Capturer(Args args)
       rotation_(args.rotation),
       buffer_count_(4),
       hw_accel_(args.hw_accel),
+      passthrough_(args.h264_passthrough),
       has_first_keyframe_(false),
       format_(args.format),
       config_(args) {}
@@ -40,7 +41,7 @@ V4L2Capturer::~V4L2Capturer() {
 }
 
 void V4L2Capturer::Initialize() {
-    if (!hw_accel_ && format_ == V4L2_PIX_FMT_H264) {
+    if (!hw_accel_ && !passthrough_ && format_ == V4L2_PIX_FMT_H264) {
         INFO_PRINT("Software decoding H264 camera source is not supported.");
         exit(EXIT_FAILURE);
     }
@@ -61,7 +62,10 @@ void V4L2Capturer::Initialize() {
         if (!SetControls(V4L2_CID_MPEG_VIDEO_BITRATE_MODE, V4L2_MPEG_VIDEO_BITRATE_MODE_VBR)) {
             ERROR_PRINT("Unable to set VBR mode");
         }
-        if (!SetControls(V4L2_CID_MPEG_VIDEO_H264_PROFILE, V4L2_MPEG_VIDEO_H264_PROFILE_HIGH)) {
+        // the passthrough stream must match the profile negotiated with the browsers.
+        auto profile = passthrough_ ? V4L2_MPEG_VIDEO_H264_PROFILE_CONSTRAINED_BASELINE
+                                    : V4L2_MPEG_VIDEO_H264_PROFILE_HIGH;
+        if (!SetControls(V4L2_CID_MPEG_VIDEO_H264_PROFILE, profile)) {
             ERROR_PRINT("Unable to set H264 profile");
         }
         if (!SetControls(V4L2_CID_MPEG_VIDEO_REPEAT_SEQ_HEADER, true)) {
@@ -101,7 +105,7 @@ int V4L2Capturer::width(int stream_idx) const { return width_; }
 
 int V4L2Capturer::height(int stream_idx) const { return height_; }
 
-bool V4L2Capturer::is_dma_capture() const { return hw_accel_ && IsCompressedFormat(); }
+bool V4L2Capturer::is_dma_capture() const { return IsDecoding(); }
 
 uint32_t V4L2Capturer::format() const { return format_; }
 
@@ -111,6 +115,8 @@ bool V4L2Capturer::IsCompressedFormat() const {
     return format_ == V4L2_PIX_FMT_MJPEG || format_ == V4L2_PIX_FMT_H264;
 }
 
+bool V4L2Capturer::IsDecoding() const { return hw_accel_ && IsCompressedFormat() && !passthrough_; }
+
 bool V4L2Capturer::CheckMatchingDevice(std::string unique_name) {
     struct v4l2_capability cap;
     if (V4L2Util::QueryCapabilities(fd_, &cap) && cap.bus_info[0] != 0 &&
@@ -161,15 +167,22 @@ void V4L2Capturer::CaptureImage() {
 
     auto buffer = V4L2Buffer::FromV4L2((uint8_t *)capture_.buffers[buf.index].start, buf, format_);
 
-    if (hw_accel_ && format_ == V4L2_PIX_FMT_H264) {
+    if (format_ == V4L2_PIX_FMT_H264 && !has_first_keyframe_) {
         has_first_keyframe_ = (buffer.flags & V4L2_BUF_FLAG_KEYFRAME) != 0;
         if (!has_first_keyframe_) {
+            V4L2Util::QueueBuffer(fd_, &buf);
             return;
         }
     }
 
     frame_buffer_ = V4L2FrameBuffer::Create(width_, height_, buffer);
-    if (hw_accel_ && IsCompressedFormat()) {
+    frame_buffer_->SetStride(capture_.bytesperline);
+    if (passthrough_) {
+        // the buffer is requeued below while the frame still waits in the encoder queue.
+        stream_subject_.Next(frame_buffer_->Clone());
+    } else if (IsDecoding()) {
+        compressed_subject_.Next(frame_buffer_);
+
         if (!decoder_) {
             decoder_ = V4L2Decoder::Create(width_, height_, format_, true);
         }
@@ -199,6 +212,13 @@ Subscription V4L2Capturer::Subscribe(Subject<V4L2FrameBufferRef>::Callback callb
     return stream_subject_.Subscribe(std::move(callback));
 }
 
+Subscription V4L2Capturer::SubscribeCompressed(Subject<V4L2FrameBufferRef>::Callback callback) {
+    if (!IsDecoding()) {
+        return stream_subject_.Subscribe(std::move(callback));
+    }
+    return compressed_subject_.Subscribe(std::move(callback));
+}
+
 void V4L2Capturer::StartCapture() {
     if (!V4L2Util::AllocateBuffer(fd_, &capture_, buffer_count_) ||
         !V4L2Util::QueueBuffers(fd_, &capture_)) {
@@ -31,6 +31,7 @@ class V4L2Capturer : public VideoCapturer {
     rtc::scoped_refptr<webrtc::I420BufferInterface> GetI420Frame(int stream_idx = 0) override;
     Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
                            int stream_idx = 0) override;
+    Subscription SubscribeCompressed(Subject<V4L2FrameBufferRef>::Callback callback) override;
 
   private:
     int camera_id_;
@@ -41,6 +42,7 @@ class V4L2Capturer : public VideoCapturer {
     int rotation_;
     int buffer_count_;
     bool hw_accel_;
+    bool passthrough_;
     bool has_first_keyframe_;
     uint32_t format_;
     Args config_;
@@ -50,9 +52,11 @@ class V4L2Capturer : public VideoCapturer {
 
     V4L2FrameBufferRef frame_buffer_;
     Subject<V4L2FrameBufferRef> stream_subject_;
+    Subject<V4L2FrameBufferRef> compressed_subject_;
 
     void Initialize();
     bool IsCompressedFormat() const;
+    bool IsDecoding() const;
     void CaptureImage();
     bool CheckMatchingDevice(std::string unique_name);
     int GetCameraIndex(webrtc::VideoCaptureModule::DeviceInfo *device_info);
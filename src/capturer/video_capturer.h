@@ -24,6 +24,10 @@ class VideoCapturer {
     virtual bool SetControls(int key, int value) { return false; };
     virtual Subscription Subscribe(Subject<V4L2FrameBufferRef>::Callback callback,
                                    int stream_idx = 0) = 0;
+    // The frames as the camera sends them, before any decoding.
+    virtual Subscription SubscribeCompressed(Subject<V4L2FrameBufferRef>::Callback callback) {
+        return Subscribe(std::move(callback));
+    }
 };
 
 #endif
@@ -1,20 +1,26 @@
 #include "codecs/h264/openh264_encoder.h"
 
+#include <thread>
+
+#include <rtc_base/time_utils.h>
+
 #include "common/logging.h"
 #include "common/utils.h"
 
-std::unique_ptr<Openh264Encoder> Openh264Encoder::Create(int width, int height, int fps) {
-    auto ptr = std::make_unique<Openh264Encoder>(width, height, fps);
+std::unique_ptr<Openh264Encoder> Openh264Encoder::Create(int width, int height, int fps,
+                                                         int bitrate) {
+    auto ptr = std::make_unique<Openh264Encoder>(width, height, fps, bitrate);
     ptr->Init();
     return ptr;
 }
 
-Openh264Encoder::Openh264Encoder(int width, int height, int fps)
+Openh264Encoder::Openh264Encoder(int width, int height, int fps, int bitrate)
     : fps_(fps),
       width_(width),
       height_(height),
-      bitrate_(width_ * height_ * fps_ * 0.1),
-      encoder_(nullptr) {}
+      bitrate_(bitrate > 0 ? bitrate : width_ * height_ * fps_ * 0.1),
+      encoder_(nullptr),
+      stats_("openh264") {}
 
 Openh264Encoder::~Openh264Encoder() {
     encoder_->Uninitialize();
@@ -51,15 +57,39 @@ void Openh264Encoder::Init() {
     encoder_param.iTargetBitrate = spartialLayerConfiguration->iSpatialBitrate = bitrate_;
     encoder_param.iMaxBitrate = spartialLayerConfiguration->iMaxSpatialBitrate = bitrate_ * 1.2;
 
+    // one slice per thread, so the threads encode the slices of a frame in parallel.
+    int threads = NumberOfThreads(width_, height_);
+    encoder_param.iMultipleThreadIdc = threads;
+    spartialLayerConfiguration->sSliceArgument.uiSliceMode =
+        threads > 1 ? SM_FIXEDSLCNUM_SLICE : SM_SINGLE_SLICE;
+    spartialLayerConfiguration->sSliceArgument.uiSliceNum = threads;
+
     rv = encoder_->InitializeExt(&encoder_param);
     if (rv != 0) {
         ERROR_PRINT("Failed to initialize OpenH264 encoder.");
         return;
     }
+    stats_.OnRates(bitrate_, bitrate_);
+    DEBUG_PRINT("OpenH264 encoder: %dx%d@%d, %d bps, %d threads", width_, height_, fps_, bitrate_,
+                threads);
+}
+
+int Openh264Encoder::NumberOfThreads(int width, int height) {
+    // leave a core to the capture and the other recorders, the small frames don't gain much.
+    int cores = std::thread::hardware_concurrency();
+    int pixels = width * height;
+    if (pixels >= 1920 * 1080 && cores > 8) {
+        return 8;
+    } else if (pixels > 1280 * 960 && cores >= 4) {
+        return cores - 1;
+    } else if (pixels > 640 * 480 && cores >= 3) {
+        return 2;
+    }
+    return 1;
 }
 
 void Openh264Encoder::Encode(rtc::scoped_refptr<webrtc::I420BufferInterface> frame_buffer,
-                             std::function<void(uint8_t *, int)> on_capture) {
+                             std::function<void(uint8_t *, int, bool)> on_capture) {
     src_pic_ = {0};
     src_pic_.iPicWidth = width_;
     src_pic_.iPicHeight = height_;
@@ -73,31 +103,40 @@ void Openh264Encoder::Encode(rtc::scoped_refptr<webrtc::I420BufferInterface> fra
 
     SFrameBSInfo info;
     memset(&info, 0, sizeof(SFrameBSInfo));
+    int64_t encode_start_us = rtc::TimeMicros();
     int rv = encoder_->EncodeFrame(&src_pic_, &info);
+    if (rv != 0 || info.eFrameType == videoFrameTypeSkip || info.iLayerNum == 0) {
+        return;
+    }
 
-    if (info.eFrameType != videoFrameTypeSkip) {
-        int required_capacity = 0;
-        for (int i = 0; i < info.iLayerNum; i++) {
-            const SLayerBSInfo *layer = &info.sLayerInfo[i];
-            for (int nal = 0; nal < layer->iNalCount; ++nal) {
-                required_capacity += layer->pNalLengthInByte[nal];
-            }
+    // the layers are usually laid out back to back, then the encoder's memory is handed over.
+    uint8_t *start = info.sLayerInfo[0].pBsBuf;
+    int encoded_size = 0;
+    bool is_contiguous = true;
+    for (int i = 0; i < info.iLayerNum; i++) {
+        const SLayerBSInfo *layer = &info.sLayerInfo[i];
+        is_contiguous &= layer->pBsBuf == start + encoded_size;
+        for (int nal = 0; nal < layer->iNalCount; ++nal) {
+            encoded_size += layer->pNalLengthInByte[nal];
         }
+    }
 
-        std::vector<uint8_t> encoded_buf(required_capacity);
-
-        int encoded_size = 0;
+    if (!is_contiguous) {
+        encoded_buf_.resize(encoded_size);
+        int offset = 0;
         for (int i = 0; i < info.iLayerNum; i++) {
             const SLayerBSInfo *layer = &info.sLayerInfo[i];
             int layer_len = 0;
             for (int nal = 0; nal < layer->iNalCount; ++nal) {
                 layer_len += layer->pNalLengthInByte[nal];
             }
-
-            memcpy(encoded_buf.data() + encoded_size, layer->pBsBuf, layer_len);
-            encoded_size += layer_len;
+            memcpy(encoded_buf_.data() + offset, layer->pBsBuf, layer_len);
+            offset += layer_len;
         }
-
-        on_capture(encoded_buf.data(), encoded_size);
+        start = encoded_buf_.data();
     }
+
+    bool is_keyframe = info.eFrameType == videoFrameTypeIDR;
+    stats_.OnEncoded(start, encoded_size, is_keyframe, encode_start_us);
+    on_capture(start, encoded_size, is_keyframe);
 }
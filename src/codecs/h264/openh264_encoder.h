@@ -2,21 +2,26 @@
 #define OPENH264_ENCODER_
 
 #include <functional>
+#include <vector>
 
 #include <api/video/i420_buffer.h>
 #include <third_party/openh264/src/codec/api/wels/codec_api.h>
 
 #include "args.h"
+#include "common/encoder_stats.h"
 #include "common/v4l2_utils.h"
 
 class Openh264Encoder {
   public:
-    static std::unique_ptr<Openh264Encoder> Create(int width, int height, int fps);
-    Openh264Encoder(int width, int height, int fps);
+    // `bitrate` in bps, 0 derives it from the resolution and fps.
+    static std::unique_ptr<Openh264Encoder> Create(int width, int height, int fps,
+                                                   int bitrate = 0);
+    Openh264Encoder(int width, int height, int fps, int bitrate);
     ~Openh264Encoder();
     void Init();
+    // The encoded data is only valid during the callback.
     void Encode(rtc::scoped_refptr<webrtc::I420BufferInterface> frame_buffer,
-                std::function<void(uint8_t *, int)> on_capture);
+                std::function<void(uint8_t *, int, bool)> on_capture);
 
   private:
     int fps_;
@@ -25,6 +30,11 @@ class Openh264Encoder {
     int bitrate_;
     ISVCEncoder *encoder_;
     SSourcePicture src_pic_;
+    // reused when the layers are not contiguous in the encoder's memory.
+    std::vector<uint8_t> encoded_buf_;
+    EncoderStats stats_;
+
+    static int NumberOfThreads(int width, int height);
 };
 
 #endif // OPENH264_ENCODER_
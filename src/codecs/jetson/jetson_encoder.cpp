@@ -1,5 +1,7 @@
 #include "codecs/jetson/jetson_encoder.h"
 #include "common/logging.h"
+#include "common/roi_controller.h"
+#include <algorithm>
 #include <cstring>
 
 #include "Error.h"
@@ -43,6 +45,7 @@ JetsonEncoder::JetsonEncoder(JetsonEncoderConfig config, const char *name)
       src_pix_fmt_(V4L2_PIX_FMT_NV12M),
       dst_pix_fmt_(config.dst_pix_fmt),
       is_dma_src_(config.is_dma_src),
+      enable_roi_(config.enable_roi),
       rate_control_mode_(config.rc_mode) {}
 
 JetsonEncoder::~JetsonEncoder() {
@@ -128,6 +131,15 @@ bool JetsonEncoder::CreateVideoEncoder() {
     if (ret < 0)
         ORIGINATE_ERROR("Could not set encoder HW Preset");
 
+    if (enable_roi_) {
+        v4l2_enc_enable_roi_param roi_param;
+        memset(&roi_param, 0, sizeof(roi_param));
+        roi_param.bEnableROI = true;
+        ret = encoder_->enableROI(roi_param);
+        if (ret < 0)
+            ORIGINATE_ERROR("Could not enable ROI");
+    }
+
     /* Query, Export and Map the output plane buffers so that we can read
        raw data into the buffers */
     if (is_dma_src_) {
@@ -217,15 +229,15 @@ void JetsonEncoder::Start() {
     abort_ = false;
 }
 
-void JetsonEncoder::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
+bool JetsonEncoder::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
                                   std::function<void(V4L2FrameBufferRef)> on_capture) {
     if (encoder_->isInError()) {
         ERROR_PRINT("ERROR in encoder");
-        return;
+        return false;
     }
 
     if (abort_) {
-        return;
+        return false;
     }
 
     struct v4l2_buffer v4l2_output_buf;
@@ -241,7 +253,7 @@ void JetsonEncoder::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
     if (encoder_->output_plane.getNumQueuedBuffers() == encoder_->output_plane.getNumBuffers()) {
         if (encoder_->output_plane.dqBuffer(v4l2_output_buf, &nv_buffer, NULL, 10) < 0) {
             ERROR_PRINT("Failed to dqBuffer at encoder output_plane");
-            return;
+            return false;
         }
     } else {
         nv_buffer =
@@ -256,12 +268,45 @@ void JetsonEncoder::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
         ConvertI420ToYUV420M(nv_buffer, frame_buffer->ToI420());
     }
 
+    if (enable_roi_) {
+        SetRoiParams(v4l2_output_buf);
+    }
+
     if (encoder_->output_plane.qBuffer(v4l2_output_buf, nullptr) < 0) {
         ERROR_PRINT("Failed to qBuffer at encoder output_plane");
-        return;
+        return false;
     }
 
     capturing_tasks_.push(on_capture);
+    return true;
+}
+
+void JetsonEncoder::SetRoiParams(struct v4l2_buffer &v4l2_buf) {
+    auto regions = RoiController::Instance().Regions();
+
+    // an empty set is sent as well, so the expired regions stop taking the bits.
+    v4l2_enc_frame_ROI_params roi_params;
+    memset(&roi_params, 0, sizeof(roi_params));
+    roi_params.num_ROI_regions = std::min<uint32_t>(regions.size(), V4L2_MAX_ROI_REGIONS);
+    for (uint32_t i = 0; i < roi_params.num_ROI_regions; i++) {
+        auto &param = roi_params.ROI_params[i];
+        param.ROIRect.left = regions[i].x * width_;
+        param.ROIRect.top = regions[i].y * height_;
+        param.ROIRect.width = regions[i].width * width_;
+        param.ROIRect.height = regions[i].height * height_;
+        param.QPdelta = regions[i].qp_delta;
+    }
+
+    v4l2_ctrl_videoenc_input_metadata metadata;
+    memset(&metadata, 0, sizeof(metadata));
+    metadata.flag = V4L2_ENC_INPUT_ROI_PARAM_FLAG;
+    metadata.VideoEncROIParams = &roi_params;
+    if (encoder_->SetInputMetaParams(v4l2_buf.index, metadata) < 0) {
+        ERROR_PRINT("Failed to set the roi params of buffer %d", v4l2_buf.index);
+        return;
+    }
+    // tell the encoder which stored metadata belongs to the frame.
+    v4l2_buf.reserved2 = v4l2_buf.index;
 }
 
 bool JetsonEncoder::EncoderCapturePlaneDqCallback(struct v4l2_buffer *v4l2_buf, NvBuffer *buffer,
@@ -20,6 +20,8 @@ struct JetsonEncoderConfig {
     int i_interval = 0;
     int idr_interval = 256;
     v4l2_mpeg_video_bitrate_mode rc_mode = V4L2_MPEG_VIDEO_BITRATE_MODE_CBR;
+    // apply the regions of the `RoiController` to every frame.
+    bool enable_roi = false;
 };
 
 class JetsonEncoder : public IFrameProcessor {
@@ -31,7 +33,7 @@ class JetsonEncoder : public IFrameProcessor {
     JetsonEncoder(JetsonEncoderConfig config, const char *name);
     ~JetsonEncoder() override;
 
-    void EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
+    bool EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
                        std::function<void(V4L2FrameBufferRef)> on_capture) override;
     void ForceKeyFrame();
     void SetFps(int adjusted_fps);
@@ -50,6 +52,7 @@ class JetsonEncoder : public IFrameProcessor {
     uint32_t src_pix_fmt_;
     uint32_t dst_pix_fmt_;
     bool is_dma_src_;
+    bool enable_roi_;
     v4l2_mpeg_video_bitrate_mode rate_control_mode_;
     ThreadSafeQueue<std::function<void(V4L2FrameBufferRef)>> capturing_tasks_;
 
@@ -57,6 +60,7 @@ class JetsonEncoder : public IFrameProcessor {
     bool PrepareCaptureBuffer();
     void Start();
     void SendEOS();
+    void SetRoiParams(struct v4l2_buffer &v4l2_buf);
     static bool EncoderCapturePlaneDqCallback(struct v4l2_buffer *v4l2_buf, NvBuffer *buffer,
                                               NvBuffer *shared_buffer, void *arg);
     void ConvertI420ToYUV420M(NvBuffer *nv_buffer,
@@ -75,6 +75,14 @@ bool JetsonScaler::Configure(int src_width, int src_height, int dst_width, int d
     return true;
 }
 
+void JetsonScaler::SetCrop(int x, int y, int width, int height) {
+    // the transform runs in EmplaceBuffer, on the same thread as this.
+    transform_params_.src_left = x;
+    transform_params_.src_top = y;
+    transform_params_.src_width = width;
+    transform_params_.src_height = height;
+}
+
 void JetsonScaler::Start() {
     worker_ = std::make_unique<Worker>("NvTransform", [this]() {
         CaptureBuffer();
@@ -82,15 +90,15 @@ void JetsonScaler::Start() {
     worker_->Run();
 }
 
-void JetsonScaler::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
+bool JetsonScaler::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
                                  std::function<void(V4L2FrameBufferRef)> on_capture) {
     if (abort_) {
-        return;
+        return false;
     }
 
     auto item = free_buffers_.pop();
     if (!item) {
-        return;
+        return false;
     }
 
     int dst_dma_fd = item.value();
@@ -100,7 +108,7 @@ void JetsonScaler::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
         ERROR_PRINT("NvTransform failed to tranform from fd(%d) to fd(%d)",
                     frame_buffer->GetDmaFd(), dst_dma_fd);
         free_buffers_.push(dst_dma_fd);
-        return;
+        return false;
     }
 
     CaptureTask task;
@@ -114,6 +122,7 @@ void JetsonScaler::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
     };
 
     capturing_tasks_.push(std::move(task));
+    return true;
 }
 
 void JetsonScaler::CaptureBuffer() {
@@ -24,8 +24,10 @@ class JetsonScaler : public IFrameProcessor {
     JetsonScaler();
     ~JetsonScaler() override;
 
-    void EmplaceBuffer(V4L2FrameBufferRef buffer,
+    bool EmplaceBuffer(V4L2FrameBufferRef buffer,
                        std::function<void(V4L2FrameBufferRef)> on_capture) override;
+    // scale only this area of the source frames.
+    void SetCrop(int x, int y, int width, int height);
 
   protected:
     void CaptureBuffer();
@@ -3,6 +3,7 @@
 #include "common/v4l2_frame_buffer.h"
 
 #include <modules/video_coding/include/video_codec_interface.h>
+#include <rtc_base/time_utils.h>
 
 std::unique_ptr<webrtc::VideoEncoder> JetsonVideoEncoder::Create(Args args) {
     return std::make_unique<JetsonVideoEncoder>(args);
@@ -10,8 +11,12 @@ std::unique_ptr<webrtc::VideoEncoder> JetsonVideoEncoder::Create(Args args) {
 
 JetsonVideoEncoder::JetsonVideoEncoder(Args args)
     : fps_adjuster_(args.fps),
+      enable_roi_(args.enable_roi),
       bitrate_adjuster_(.85, 1),
-      callback_(nullptr) {}
+      callback_(nullptr),
+      keyframe_scheduler_("jetson",
+                          {.merge_window_ms = args.keyframe_merge_window,
+                           .min_interval_ms = args.keyframe_min_interval}) {}
 
 int32_t JetsonVideoEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
                                        const VideoEncoder::Settings &settings) {
@@ -23,6 +28,11 @@ int32_t JetsonVideoEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
     encoded_image_.timing_.flags = webrtc::VideoSendTiming::TimingFrameFlags::kInvalid;
     encoded_image_.content_type_ = webrtc::VideoContentType::UNSPECIFIED;
 
+    if (!stats_) {
+        stats_ = std::make_unique<EncoderStats>("jetson",
+                                                codec_.codecType == webrtc::kVideoCodecH264);
+    }
+
     return WEBRTC_VIDEO_CODEC_OK;
 }
 
@@ -53,19 +63,31 @@ int32_t JetsonVideoEncoder::Encode(const webrtc::VideoFrame &frame,
         if (codec_fmt == 0) {
             return WEBRTC_VIDEO_CODEC_ENCODER_FAILURE;
         }
-        encoder_ =
-            JetsonEncoder::Create(width_, height_, codec_fmt,
-                                  frame_buffer->type() == webrtc::VideoFrameBuffer::Type::kNative);
+        encoder_ = JetsonEncoder::Create({
+            .width = width_,
+            .height = height_,
+            .is_dma_src = frame_buffer->type() == webrtc::VideoFrameBuffer::Type::kNative,
+            .dst_pix_fmt = codec_fmt,
+            .enable_roi = enable_roi_ && codec_fmt == V4L2_PIX_FMT_H264,
+        });
     }
 
     if ((*frame_types)[0] == webrtc::VideoFrameType::kVideoFrameKey) {
+        keyframe_scheduler_.Request(KeyFrameReason::ReceiverRequest);
+    }
+    if (keyframe_scheduler_.ShouldForceKeyFrame()) {
         encoder_->ForceKeyFrame();
     }
 
-    encoder_->EmplaceBuffer(v4l2_frame_buffer, [this, frame](V4L2FrameBufferRef encoded_buffer) {
-        auto v4l2buffer = encoded_buffer->GetRawBuffer();
-        SendFrame(frame, v4l2buffer);
-    });
+    int64_t encode_start_us = rtc::TimeMicros();
+    bool is_queued = encoder_->EmplaceBuffer(
+        v4l2_frame_buffer, [this, frame, encode_start_us](V4L2FrameBufferRef encoded_buffer) {
+            auto v4l2buffer = encoded_buffer->GetRawBuffer();
+            SendFrame(frame, v4l2buffer, encode_start_us);
+        });
+    if (!is_queued) {
+        callback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
+    }
 
     return WEBRTC_VIDEO_CODEC_OK;
 }
@@ -82,6 +104,10 @@ void JetsonVideoEncoder::SetRates(const RateControlParameters &parameters) {
     }
     encoder_->SetFps(fps_adjuster_);
     encoder_->SetBitrate(bitrate_adjuster_.GetAdjustedBitrateBps());
+    if (stats_) {
+        stats_->OnRates(bitrate_adjuster_.GetTargetBitrateBps(),
+                        bitrate_adjuster_.GetAdjustedBitrateBps());
+    }
 }
 
 webrtc::VideoEncoder::EncoderInfo JetsonVideoEncoder::GetEncoderInfo() const {
@@ -92,7 +118,8 @@ webrtc::VideoEncoder::EncoderInfo JetsonVideoEncoder::GetEncoderInfo() const {
     return info;
 }
 
-void JetsonVideoEncoder::SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &encoded_buffer) {
+void JetsonVideoEncoder::SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &encoded_buffer,
+                                   int64_t encode_start_us) {
     auto encoded_image_buffer =
         webrtc::EncodedImageBuffer::Create((uint8_t *)encoded_buffer.start, encoded_buffer.length);
 
@@ -115,6 +142,14 @@ void JetsonVideoEncoder::SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &
     encoded_image_._frameType = encoded_buffer.flags & V4L2_BUF_FLAG_KEYFRAME
                                     ? webrtc::VideoFrameType::kVideoFrameKey
                                     : webrtc::VideoFrameType::kVideoFrameDelta;
+    if (encoded_image_._frameType == webrtc::VideoFrameType::kVideoFrameKey) {
+        keyframe_scheduler_.OnKeyFrame();
+    }
+    if (stats_) {
+        encoded_image_.qp_ = stats_->OnEncoded(
+            encoded_image_buffer->data(), encoded_image_buffer->size(),
+            encoded_image_._frameType == webrtc::VideoFrameType::kVideoFrameKey, encode_start_us);
+    }
 
     auto result = callback_->OnEncodedImage(encoded_image_, &codec_specific);
     if (result.error != webrtc::EncodedImageCallback::Result::OK) {
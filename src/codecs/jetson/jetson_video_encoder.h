@@ -7,6 +7,8 @@
 
 #include "args.h"
 #include "codecs/jetson/jetson_encoder.h"
+#include "common/encoder_stats.h"
+#include "common/keyframe_scheduler.h"
 
 class JetsonVideoEncoder : public webrtc::VideoEncoder {
   public:
@@ -26,6 +28,7 @@ class JetsonVideoEncoder : public webrtc::VideoEncoder {
     int width_;
     int height_;
     int fps_adjuster_;
+    bool enable_roi_;
     bool is_dma_;
     std::string name_;
     webrtc::VideoCodec codec_;
@@ -33,8 +36,12 @@ class JetsonVideoEncoder : public webrtc::VideoEncoder {
     webrtc::EncodedImageCallback *callback_;
     webrtc::BitrateAdjuster bitrate_adjuster_;
     std::unique_ptr<JetsonEncoder> encoder_;
+    KeyFrameScheduler keyframe_scheduler_;
+    // created with the codec, the QP is only parsed from H264.
+    std::unique_ptr<EncoderStats> stats_;
 
-    virtual void SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &encoded_buffer);
+    virtual void SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &encoded_buffer,
+                           int64_t encode_start_us);
 
   private:
     static uint32_t GetV4L2CodecFormat(webrtc::VideoCodecType codec);
@@ -1,15 +1,29 @@
 #include "codecs/v4l2/v4l2_codec.h"
 #include "common/logging.h"
+#include "common/metrics.h"
+#include <chrono>
 #include <cstring>
 #include <sys/ioctl.h>
 #include <thread>
 
+// report a codec that keeps running out of buffers once per this many dropped frames.
+const int STARVED_WARNING_FRAMES = 30;
+// the packetizer returns the leased buffers within a frame, the recorder within its disk queue.
+const std::chrono::milliseconds CAPTURE_LEASE_TIMEOUT(1000);
+
+static V4L2BufferCounts buffer_counts;
+
+void V4L2Codec::SetBufferCounts(V4L2BufferCounts counts) { buffer_counts = counts; }
+
+V4L2BufferCounts V4L2Codec::BufferCounts() { return buffer_counts; }
+
 V4L2Codec::V4L2Codec()
     : fd_(-1),
       width_(0),
       height_(0),
       dst_fmt_(0),
-      abort_(false) {}
+      abort_(false),
+      starved_frames_(0) {}
 
 V4L2Codec::~V4L2Codec() {
     abort_ = true;
@@ -18,13 +32,19 @@ V4L2Codec::~V4L2Codec() {
     V4L2Util::StreamOff(fd_, capture_.type);
 
     V4L2Util::DeallocateBuffer(fd_, &output_);
-    V4L2Util::DeallocateBuffer(fd_, &capture_);
+    if (WaitForCaptureLeases()) {
+        V4L2Util::DeallocateBuffer(fd_, &capture_);
+    } else {
+        // unmapping would pull the memory from under the holders, leave it to the process exit.
+        ERROR_PRINT("%s is closed with leased capture buffers.", file_name_);
+    }
 
     V4L2Util::CloseDevice(fd_);
 }
 
 bool V4L2Codec::Open(const char *file_name) {
     file_name_ = file_name;
+    starved_metric_ = "v4l2_codec_starved_frames_total{device=\"" + std::string(file_name) + "\"}";
     fd_ = V4L2Util::OpenDevice(file_name);
     if (fd_ < 0) {
         return false;
@@ -38,6 +58,8 @@ bool V4L2Codec::SetExtCtrl(uint32_t id, int32_t value) {
     return V4L2Util::SetExtCtrl(fd_, id, value);
 }
 
+bool V4L2Codec::SetOutputCrop(v4l2_rect rect) { return V4L2Util::SetCrop(fd_, output_.type, rect); }
+
 bool V4L2Codec::SetupOutputBuffer(int width, int height, uint32_t pix_fmt, v4l2_memory memory,
                                   int buffer_num) {
     v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
@@ -83,6 +105,39 @@ bool V4L2Codec::PrepareBuffer(V4L2BufferGroup *gbuffer, int width, int height, u
 
 bool V4L2Codec::SubscribeEvent(uint32_t ev_type) { return V4L2Util::SubscribeEvent(fd_, ev_type); }
 
+void V4L2Codec::EnableCaptureLease() { capture_lease_ = std::make_shared<CaptureLease>(); }
+
+void V4L2Codec::LeaseCaptureBuffer(V4L2FrameBufferRef frame_buffer, int index) {
+    auto lease = capture_lease_;
+    {
+        std::lock_guard<std::mutex> lock(lease->mtx);
+        lease->leased++;
+    }
+
+    frame_buffer->SetReleaseCallback([this, lease, index]() {
+        std::lock_guard<std::mutex> lock(lease->mtx);
+        // the codec is alive as long as the lease is open.
+        if (lease->is_open && !V4L2Util::QueueBuffer(fd_, &capture_.buffers[index].inner)) {
+            ERROR_PRINT("Failed to requeue the leased capture buffer %d of %s", index, file_name_);
+        }
+        lease->leased--;
+        lease->cv.notify_all();
+    });
+}
+
+bool V4L2Codec::WaitForCaptureLeases() {
+    if (!capture_lease_) {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(capture_lease_->mtx);
+    bool is_returned = capture_lease_->cv.wait_for(lock, CAPTURE_LEASE_TIMEOUT, [this]() {
+        return capture_lease_->leased == 0;
+    });
+    capture_lease_->is_open = false;
+    return is_returned;
+}
+
 void V4L2Codec::HandleEvent() {
     struct v4l2_event ev;
     while (!ioctl(fd_, VIDIOC_DQEVENT, &ev)) {
@@ -123,12 +178,21 @@ void V4L2Codec::Start() {
     worker_->Run();
 }
 
-void V4L2Codec::EmplaceBuffer(V4L2FrameBufferRef buffer,
+bool V4L2Codec::EmplaceBuffer(V4L2FrameBufferRef buffer,
                               std::function<void(V4L2FrameBufferRef)> on_capture) {
     auto item = output_buffer_index_.pop();
     if (!item) {
-        return;
+        // all the buffers are still in the device, the frame is dropped here.
+        Metrics::Instance().Increment(starved_metric_);
+        int starved_frames = ++starved_frames_;
+        if (starved_frames % STARVED_WARNING_FRAMES == 0) {
+            WARN_PRINT("%s dropped %d frames in a row without a free buffer, "
+                       "consider a deeper queue for it.",
+                       file_name_, starved_frames);
+        }
+        return false;
     }
+    starved_frames_ = 0;
     auto index = item.value();
 
     if (output_.memory == V4L2_MEMORY_DMABUF) {
@@ -144,10 +208,11 @@ void V4L2Codec::EmplaceBuffer(V4L2FrameBufferRef buffer,
         ERROR_PRINT("QueueBuffer V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE. fd(%d) at index %d", fd_,
                     index);
         output_buffer_index_.push(index);
-        return;
+        return false;
     }
 
     capturing_tasks_.push(on_capture);
+    return true;
 }
 
 bool V4L2Codec::CaptureBuffer() {
@@ -201,6 +266,11 @@ bool V4L2Codec::CaptureBuffer() {
             capture_.buffers[buf.index].start, buf.m.planes[0].bytesused,
             capture_.buffers[buf.index].dmafd, buf.flags, dst_fmt_);
         auto frame_buffer = V4L2FrameBuffer::Create(width_, height_, buffer);
+        frame_buffer->SetStride(capture_.bytesperline);
+        if (capture_lease_) {
+            // requeued by the last holder of the frame, possibly this thread right below.
+            LeaseCaptureBuffer(frame_buffer, buf.index);
+        }
 
         if (abort_) {
             return false;
@@ -212,7 +282,7 @@ bool V4L2Codec::CaptureBuffer() {
             task(frame_buffer);
         }
 
-        if (!V4L2Util::QueueBuffer(fd_, &capture_.buffers[buf.index].inner)) {
+        if (!capture_lease_ && !V4L2Util::QueueBuffer(fd_, &capture_.buffers[buf.index].inner)) {
             return false;
         }
     }
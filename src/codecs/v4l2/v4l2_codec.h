@@ -1,32 +1,61 @@
 #ifndef V4L2_CODEC_
 #define V4L2_CODEC_
 
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
 #include "common/interface/processor.h"
 #include "common/thread_safe_queue.h"
 #include "common/v4l2_utils.h"
 #include "common/worker.h"
 
+/**
+ * The number of buffers on each side of the memory-to-memory devices. A deeper
+ * queue absorbs the bursts of the upstream at the cost of latency and memory.
+ */
+struct V4L2BufferCounts {
+    int decoder = 2;
+    int encoder = 2;
+    int scaler = 2;
+};
+
 class V4L2Codec : public IFrameProcessor {
   public:
+    // applied to the codecs created afterwards.
+    static void SetBufferCounts(V4L2BufferCounts counts);
+    static V4L2BufferCounts BufferCounts();
+
     V4L2Codec();
     ~V4L2Codec() override;
 
-    void EmplaceBuffer(V4L2FrameBufferRef buffer,
+    bool EmplaceBuffer(V4L2FrameBufferRef buffer,
                        std::function<void(V4L2FrameBufferRef)> on_capture) override;
 
   protected:
     bool Open(const char *file_name);
     bool SetFps(uint32_t fps);
     bool SetExtCtrl(uint32_t id, int32_t value);
+    bool SetOutputCrop(v4l2_rect rect);
     bool SetupOutputBuffer(int width, int height, uint32_t pix_fmt, v4l2_memory memory,
                            int buffer_num);
     bool SetupCaptureBuffer(int width, int height, uint32_t pix_fmt, v4l2_memory memory,
                             int buffer_num, bool exp_dmafd = false);
     bool SubscribeEvent(uint32_t ev_type);
+    // hand the captured buffers out until their last reference is gone instead of
+    // requeuing them right after the callback, so the consumers don't need a copy.
+    void EnableCaptureLease();
     virtual void HandleEvent();
     void Start();
 
   private:
+    struct CaptureLease {
+        std::mutex mtx;
+        std::condition_variable cv;
+        int leased = 0;
+        bool is_open = true;
+    };
+
     int fd_;
     int width_;
     int height_;
@@ -38,11 +67,18 @@ class V4L2Codec : public IFrameProcessor {
     std::unique_ptr<Worker> worker_;
     ThreadSafeQueue<int> output_buffer_index_;
     ThreadSafeQueue<std::function<void(V4L2FrameBufferRef)>> capturing_tasks_;
+    // the frames in a row arriving without a free output buffer.
+    std::atomic<int> starved_frames_;
+    std::string starved_metric_;
+    std::shared_ptr<CaptureLease> capture_lease_;
 
     bool PrepareBuffer(V4L2BufferGroup *gbuffer, int width, int height, uint32_t pix_fmt,
                        v4l2_buf_type type, v4l2_memory memory, int buffer_num,
                        bool has_dmafd = false);
     bool CaptureBuffer();
+    void LeaseCaptureBuffer(V4L2FrameBufferRef frame_buffer, int index);
+    // false if some leases are still out after the timeout.
+    bool WaitForCaptureLeases();
 };
 
 #endif // V4L2_CODEC_
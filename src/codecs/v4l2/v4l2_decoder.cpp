@@ -2,7 +2,6 @@
 #include "common/logging.h"
 
 const char *DECODER_FILE = "/dev/video10";
-const int BUFFER_NUM = 2;
 
 std::unique_ptr<V4L2Decoder> V4L2Decoder::Create(int width, int height, uint32_t src_pix_fmt,
                                                  bool is_dma_dst) {
@@ -17,10 +16,11 @@ void V4L2Decoder::Configure(int width, int height, uint32_t src_pix_fmt, bool is
         ERROR_PRINT("Unable to turn on decoder: %s", DECODER_FILE);
     }
 
-    if (!SetupOutputBuffer(width, height, src_pix_fmt, V4L2_MEMORY_MMAP, BUFFER_NUM)) {
+    int buffer_num = BufferCounts().decoder;
+    if (!SetupOutputBuffer(width, height, src_pix_fmt, V4L2_MEMORY_MMAP, buffer_num)) {
         ERROR_PRINT("Could not setup output buffer");
     }
-    if (!SetupCaptureBuffer(width, height, V4L2_PIX_FMT_YUV420, V4L2_MEMORY_MMAP, BUFFER_NUM,
+    if (!SetupCaptureBuffer(width, height, V4L2_PIX_FMT_YUV420, V4L2_MEMORY_MMAP, buffer_num,
                             is_dma_dst)) {
         ERROR_PRINT("Could not setup capture buffer");
     }
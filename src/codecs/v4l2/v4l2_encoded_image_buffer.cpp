@@ -0,0 +1,20 @@
+#include "codecs/v4l2/v4l2_encoded_image_buffer.h"
+
+rtc::scoped_refptr<V4L2EncodedImageBuffer>
+V4L2EncodedImageBuffer::Create(V4L2FrameBufferRef frame_buffer) {
+    return rtc::make_ref_counted<V4L2EncodedImageBuffer>(std::move(frame_buffer));
+}
+
+V4L2EncodedImageBuffer::V4L2EncodedImageBuffer(V4L2FrameBufferRef frame_buffer)
+    : frame_buffer_(std::move(frame_buffer)) {}
+
+const uint8_t *V4L2EncodedImageBuffer::data() const {
+    return static_cast<const uint8_t *>(frame_buffer_->Data());
+}
+
+// the leased buffer is mapped writable and belongs to this image until it's released.
+uint8_t *V4L2EncodedImageBuffer::data() {
+    return static_cast<uint8_t *>(frame_buffer_->GetRawBuffer().start);
+}
+
+size_t V4L2EncodedImageBuffer::size() const { return frame_buffer_->size(); }
@@ -0,0 +1,28 @@
+#ifndef V4L2_ENCODED_IMAGE_BUFFER_H_
+#define V4L2_ENCODED_IMAGE_BUFFER_H_
+
+#include "common/v4l2_frame_buffer.h"
+
+#include <api/video/encoded_image.h>
+
+/**
+ * Expose an encoded frame to WebRTC without copying it out of the encoder. The
+ * frame buffer is held until WebRTC is done with the image, so a leased capture
+ * buffer goes back to the encoder only after the packetizer has read it.
+ */
+class V4L2EncodedImageBuffer : public webrtc::EncodedImageBufferInterface {
+  public:
+    static rtc::scoped_refptr<V4L2EncodedImageBuffer> Create(V4L2FrameBufferRef frame_buffer);
+
+    const uint8_t *data() const override;
+    uint8_t *data() override;
+    size_t size() const override;
+
+  protected:
+    explicit V4L2EncodedImageBuffer(V4L2FrameBufferRef frame_buffer);
+
+  private:
+    V4L2FrameBufferRef frame_buffer_;
+};
+
+#endif // V4L2_ENCODED_IMAGE_BUFFER_H_
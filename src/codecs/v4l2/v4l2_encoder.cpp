@@ -2,8 +2,9 @@
 #include "common/logging.h"
 
 const char *ENCODER_FILE = "/dev/video11";
-const int BUFFER_NUM = 2;
 const int KEY_FRAME_INTERVAL = 600;
+// the encoded frames out on lease to the WebRTC packetizer, on top of the device's own.
+const int LEASED_CAPTURE_BUFFERS = 2;
 
 std::unique_ptr<V4L2Encoder> V4L2Encoder::Create(int width, int height, uint32_t src_pix_fmt,
                                                  bool is_dma_src) {
@@ -16,12 +17,15 @@ std::unique_ptr<V4L2Encoder> V4L2Encoder::Create(int width, int height, uint32_t
 V4L2Encoder::V4L2Encoder()
     : V4L2Codec(),
       framerate_(30),
-      bitrate_bps_(2 * 1024 * 1024) {}
+      bitrate_bps_(2 * 1024 * 1024),
+      mb_count_(0),
+      refresh_mbs_(0) {}
 
 void V4L2Encoder::Configure(int width, int height, uint32_t src_pix_fmt, bool is_dma_src) {
     if (!Open(ENCODER_FILE)) {
         ERROR_PRINT("Unable to turn on encoder: %s", ENCODER_FILE);
     }
+    mb_count_ = ((width + 15) / 16) * ((height + 15) / 16);
 
     SetProfile(V4L2_MPEG_VIDEO_H264_PROFILE_BASELINE);
     SetLevel(V4L2_MPEG_VIDEO_H264_LEVEL_4_0);
@@ -36,12 +40,15 @@ void V4L2Encoder::Configure(int width, int height, uint32_t src_pix_fmt, bool is
     }
 
     auto src_memory = is_dma_src ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_MMAP;
-    if (!SetupOutputBuffer(width, height, src_pix_fmt, src_memory, BUFFER_NUM)) {
+    int buffer_num = BufferCounts().encoder;
+    if (!SetupOutputBuffer(width, height, src_pix_fmt, src_memory, buffer_num)) {
         ERROR_PRINT("Could not setup output buffer");
     }
-    if (!SetupCaptureBuffer(width, height, V4L2_PIX_FMT_H264, V4L2_MEMORY_MMAP, BUFFER_NUM)) {
+    if (!SetupCaptureBuffer(width, height, V4L2_PIX_FMT_H264, V4L2_MEMORY_MMAP,
+                            buffer_num + LEASED_CAPTURE_BUFFERS)) {
         ERROR_PRINT("Could not setup capture buffer");
     }
+    EnableCaptureLease();
 }
 
 void V4L2Encoder::ForceKeyFrame() {
@@ -81,6 +88,24 @@ void V4L2Encoder::SetIFrameInterval(uint32_t interval) {
     }
 }
 
+void V4L2Encoder::SetIntraRefresh(uint32_t period) {
+    refresh_mbs_ = period > 0 ? (mb_count_ + period - 1) / period : 0;
+    if (!SetExtCtrl(V4L2_CID_MPEG_VIDEO_CYCLIC_INTRA_REFRESH_MB, refresh_mbs_)) {
+        ERROR_PRINT("Could not set cyclic intra refresh: %d mbs per frame", refresh_mbs_);
+    }
+}
+
+void V4L2Encoder::RestartIntraRefresh() {
+    if (refresh_mbs_ <= 0) {
+        return;
+    }
+    // the driver starts a new cycle from the top of the picture whenever the refresh is set.
+    if (!SetExtCtrl(V4L2_CID_MPEG_VIDEO_CYCLIC_INTRA_REFRESH_MB, 0) ||
+        !SetExtCtrl(V4L2_CID_MPEG_VIDEO_CYCLIC_INTRA_REFRESH_MB, refresh_mbs_)) {
+        ERROR_PRINT("Could not restart cyclic intra refresh");
+    }
+}
+
 void V4L2Encoder::SetBitrate(uint32_t adjusted_bitrate_bps) {
     if (adjusted_bitrate_bps < 1000000) {
         adjusted_bitrate_bps = 1000000;
@@ -18,11 +18,17 @@ class V4L2Encoder : public V4L2Codec {
     void SetFps(uint32_t adjusted_fps);
     void SetRateControlMode(uint32_t mode);
     void SetIFrameInterval(uint32_t interval);
+    // refresh every macroblock once per `period` frames instead of in a single IDR.
+    void SetIntraRefresh(uint32_t period);
+    // start the refresh cycle over from the next frame, e.g. after a loss.
+    void RestartIntraRefresh();
     void SetBitrate(uint32_t adjusted_bitrate_bps);
 
   private:
     int framerate_;
     int bitrate_bps_;
+    int mb_count_;
+    int refresh_mbs_;
 
     void Configure(int width, int height, uint32_t src_pix_fmt, bool is_dma_src);
 };
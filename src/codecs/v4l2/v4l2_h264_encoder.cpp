@@ -1,7 +1,13 @@
 #include "codecs/v4l2/v4l2_h264_encoder.h"
+#include "codecs/v4l2/v4l2_encoded_image_buffer.h"
 #include "common/logging.h"
+#include "common/metrics.h"
 #include "common/v4l2_frame_buffer.h"
 
+#include <algorithm>
+
+#include <rtc_base/time_utils.h>
+
 std::unique_ptr<webrtc::VideoEncoder> V4L2H264Encoder::Create(Args args) {
     return std::make_unique<V4L2H264Encoder>(args);
 }
@@ -9,7 +15,14 @@ std::unique_ptr<webrtc::VideoEncoder> V4L2H264Encoder::Create(Args args) {
 V4L2H264Encoder::V4L2H264Encoder(Args args)
     : fps_adjuster_(args.fps),
       bitrate_adjuster_(.85, 1),
-      callback_(nullptr) {}
+      callback_(nullptr),
+      keyframe_scheduler_("v4l2_h264",
+                          {.merge_window_ms = args.keyframe_merge_window,
+                           .min_interval_ms = args.keyframe_min_interval}),
+      stats_("v4l2_h264"),
+      intra_refresh_period_(args.intra_refresh_period),
+      is_idr_requested_(false),
+      refresh_pli_ms_(-1) {}
 
 int32_t V4L2H264Encoder::InitEncode(const webrtc::VideoCodec *codec_settings,
                                     const VideoEncoder::Settings &settings) {
@@ -25,6 +38,10 @@ int32_t V4L2H264Encoder::InitEncode(const webrtc::VideoCodec *codec_settings,
         return WEBRTC_VIDEO_CODEC_ERROR;
     }
 
+    // the first request comes from the new receiver, it needs a real IDR.
+    is_idr_requested_ = false;
+    refresh_pli_ms_ = -1;
+
     return WEBRTC_VIDEO_CODEC_OK;
 }
 
@@ -59,16 +76,31 @@ int32_t V4L2H264Encoder::Encode(const webrtc::VideoFrame &frame,
         encoder_ =
             V4L2Encoder::Create(width_, height_, V4L2_PIX_FMT_YUV420,
                                 frame_buffer->type() == webrtc::VideoFrameBuffer::Type::kNative);
+        if (intra_refresh_period_ > 0) {
+            // only the initial IDR, the refresh cycle takes over the periodic ones.
+            encoder_->SetIFrameInterval(0);
+            encoder_->SetIntraRefresh(intra_refresh_period_);
+        }
     }
 
     if ((*frame_types)[0] == webrtc::VideoFrameType::kVideoFrameKey) {
+        if (auto reason = ClassifyKeyFrameRequest()) {
+            keyframe_scheduler_.Request(reason.value());
+        }
+    }
+    if (keyframe_scheduler_.ShouldForceKeyFrame()) {
         encoder_->ForceKeyFrame();
     }
 
-    encoder_->EmplaceBuffer(v4l2_frame_buffer, [this, frame](V4L2FrameBufferRef encoded_buffer) {
-        auto raw_buffer = encoded_buffer->GetRawBuffer();
-        SendFrame(frame, raw_buffer);
-    });
+    int64_t encode_start_us = rtc::TimeMicros();
+    bool is_queued = encoder_->EmplaceBuffer(
+        v4l2_frame_buffer, [this, frame, encode_start_us](V4L2FrameBufferRef encoded_buffer) {
+            SendFrame(frame, encoded_buffer, encode_start_us);
+        });
+    if (!is_queued) {
+        // let the rate controller know the encoder can't keep up.
+        callback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
+    }
 
     return WEBRTC_VIDEO_CODEC_OK;
 }
@@ -85,6 +117,35 @@ void V4L2H264Encoder::SetRates(const RateControlParameters &parameters) {
     }
     encoder_->SetFps(fps_adjuster_);
     encoder_->SetBitrate(bitrate_adjuster_.GetAdjustedBitrateBps());
+    stats_.OnRates(bitrate_adjuster_.GetTargetBitrateBps(),
+                   bitrate_adjuster_.GetAdjustedBitrateBps());
+}
+
+std::optional<KeyFrameReason> V4L2H264Encoder::ClassifyKeyFrameRequest() {
+    if (!is_idr_requested_) {
+        is_idr_requested_ = true;
+        return KeyFrameReason::NewReceiver;
+    }
+    if (intra_refresh_period_ <= 0) {
+        return KeyFrameReason::ReceiverRequest;
+    }
+
+    // a restarted cycle refreshes every macroblock within a period, so the loss heals by itself.
+    int64_t now_ms = rtc::TimeMillis();
+    int64_t period_ms = intra_refresh_period_ * 1000 / std::max(fps_adjuster_, 1);
+    if (refresh_pli_ms_ < 0 || now_ms - refresh_pli_ms_ >= 2 * period_ms) {
+        refresh_pli_ms_ = now_ms;
+        encoder_->RestartIntraRefresh();
+        Metrics::Instance().Increment("v4l2_intra_refresh_restarts_total");
+        return std::nullopt;
+    }
+    if (now_ms - refresh_pli_ms_ < period_ms) {
+        return std::nullopt;
+    }
+
+    // the receiver still reports the loss after a whole cycle, e.g. it can't use the refresh.
+    refresh_pli_ms_ = -1;
+    return KeyFrameReason::RefreshFallback;
 }
 
 webrtc::VideoEncoder::EncoderInfo V4L2H264Encoder::GetEncoderInfo() const {
@@ -95,9 +156,9 @@ webrtc::VideoEncoder::EncoderInfo V4L2H264Encoder::GetEncoderInfo() const {
     return info;
 }
 
-void V4L2H264Encoder::SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &encoded_buffer) {
-    auto encoded_image_buffer =
-        webrtc::EncodedImageBuffer::Create((uint8_t *)encoded_buffer.start, encoded_buffer.length);
+void V4L2H264Encoder::SendFrame(const webrtc::VideoFrame &frame,
+                                V4L2FrameBufferRef encoded_buffer, int64_t encode_start_us) {
+    auto encoded_image_buffer = V4L2EncodedImageBuffer::Create(encoded_buffer);
 
     webrtc::CodecSpecificInfo codec_specific;
     codec_specific.codecType = webrtc::kVideoCodecH264;
@@ -112,11 +173,19 @@ void V4L2H264Encoder::SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &enc
     encoded_image_.capture_time_ms_ = frame.render_time_ms();
     encoded_image_.ntp_time_ms_ = frame.ntp_time_ms();
     encoded_image_.rotation_ = frame.rotation();
-    encoded_image_._frameType = encoded_buffer.flags & V4L2_BUF_FLAG_KEYFRAME
+    encoded_image_._frameType = encoded_buffer->flags() & V4L2_BUF_FLAG_KEYFRAME
                                     ? webrtc::VideoFrameType::kVideoFrameKey
                                     : webrtc::VideoFrameType::kVideoFrameDelta;
+    if (encoded_image_._frameType == webrtc::VideoFrameType::kVideoFrameKey) {
+        keyframe_scheduler_.OnKeyFrame();
+    }
+    encoded_image_.qp_ = stats_.OnEncoded(
+        encoded_image_buffer->data(), encoded_image_buffer->size(),
+        encoded_image_._frameType == webrtc::VideoFrameType::kVideoFrameKey, encode_start_us);
 
     auto result = callback_->OnEncodedImage(encoded_image_, &codec_specific);
+    // give the buffer back to the encoder now rather than with the next frame.
+    encoded_image_.ClearEncodedData();
     if (result.error != webrtc::EncodedImageCallback::Result::OK) {
         ERROR_PRINT("Failed to send the frame => %d", result.error);
     }
@@ -1,6 +1,8 @@
 #ifndef V4L2_H264_ENCODER_H_
 #define V4L2_H264_ENCODER_H_
 
+#include <optional>
+
 // WebRTC
 #include <api/video_codecs/video_encoder.h>
 #include <common_video/include/bitrate_adjuster.h>
@@ -8,6 +10,8 @@
 
 #include "args.h"
 #include "codecs/v4l2/v4l2_encoder.h"
+#include "common/encoder_stats.h"
+#include "common/keyframe_scheduler.h"
 
 class V4L2H264Encoder : public webrtc::VideoEncoder {
   public:
@@ -34,8 +38,17 @@ class V4L2H264Encoder : public webrtc::VideoEncoder {
     webrtc::EncodedImageCallback *callback_;
     webrtc::BitrateAdjuster bitrate_adjuster_;
     std::unique_ptr<V4L2Encoder> encoder_;
+    KeyFrameScheduler keyframe_scheduler_;
+    EncoderStats stats_;
+    int intra_refresh_period_;
+    bool is_idr_requested_;
+    // the time the refresh cycle was restarted for a loss, -1 if none is ongoing.
+    int64_t refresh_pli_ms_;
 
-    virtual void SendFrame(const webrtc::VideoFrame &frame, V4L2Buffer &encoded_buffer);
+    // nullopt if the restarted intra refresh takes care of the request.
+    std::optional<KeyFrameReason> ClassifyKeyFrameRequest();
+    virtual void SendFrame(const webrtc::VideoFrame &frame, V4L2FrameBufferRef encoded_buffer,
+                           int64_t encode_start_us);
 };
 
 #endif
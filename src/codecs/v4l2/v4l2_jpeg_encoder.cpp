@@ -0,0 +1,36 @@
+#include "codecs/v4l2/v4l2_jpeg_encoder.h"
+#include "common/logging.h"
+
+const char *JPEG_ENCODER_FILE = "/dev/video31";
+const int BUFFER_NUM = 1;
+
+std::unique_ptr<V4L2JpegEncoder> V4L2JpegEncoder::Create(int width, int height, int quality) {
+    auto encoder = std::make_unique<V4L2JpegEncoder>();
+    if (!encoder->Configure(width, height, quality)) {
+        return nullptr;
+    }
+    encoder->Start();
+    return encoder;
+}
+
+bool V4L2JpegEncoder::Configure(int width, int height, int quality) {
+    if (!Open(JPEG_ENCODER_FILE)) {
+        ERROR_PRINT("Unable to turn on jpeg encoder: %s", JPEG_ENCODER_FILE);
+        return false;
+    }
+
+    if (!SetupOutputBuffer(width, height, V4L2_PIX_FMT_YUV420, V4L2_MEMORY_MMAP, BUFFER_NUM)) {
+        ERROR_PRINT("Could not setup output buffer");
+        return false;
+    }
+    if (!SetupCaptureBuffer(width, height, V4L2_PIX_FMT_JPEG, V4L2_MEMORY_MMAP, BUFFER_NUM)) {
+        ERROR_PRINT("Could not setup capture buffer");
+        return false;
+    }
+
+    if (!SetExtCtrl(V4L2_CID_JPEG_COMPRESSION_QUALITY, quality)) {
+        ERROR_PRINT("Could not set jpeg quality");
+    }
+
+    return true;
+}
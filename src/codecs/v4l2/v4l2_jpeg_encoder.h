@@ -0,0 +1,15 @@
+#ifndef V4L2_JPEG_ENCODER_H_
+#define V4L2_JPEG_ENCODER_H_
+
+#include "codecs/v4l2/v4l2_codec.h"
+
+class V4L2JpegEncoder : public V4L2Codec {
+  public:
+    // Return nullptr if the device is not available, the caller falls back to libjpeg.
+    static std::unique_ptr<V4L2JpegEncoder> Create(int width, int height, int quality);
+
+  private:
+    bool Configure(int width, int height, int quality);
+};
+
+#endif // V4L2_JPEG_ENCODER_H_
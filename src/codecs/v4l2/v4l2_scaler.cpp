@@ -2,7 +2,6 @@
 #include "common/logging.h"
 
 const char *SCALER_FILE = "/dev/video12";
-const int BUFFER_NUM = 2;
 
 std::unique_ptr<V4L2Scaler> V4L2Scaler::Create(int src_width, int src_height, uint32_t src_pix_fmt,
                                                int dst_width, int dst_height, bool is_dma_src,
@@ -14,18 +13,36 @@ std::unique_ptr<V4L2Scaler> V4L2Scaler::Create(int src_width, int src_height, ui
     return scaler;
 }
 
+V4L2Scaler::V4L2Scaler()
+    : V4L2Codec(),
+      crop_({}) {}
+
+void V4L2Scaler::SetCrop(int x, int y, int width, int height) {
+    if (crop_.left == x && crop_.top == y && crop_.width == (uint32_t)width &&
+        crop_.height == (uint32_t)height) {
+        return;
+    }
+    v4l2_rect rect = {.left = x, .top = y, .width = (uint32_t)width, .height = (uint32_t)height};
+    if (SetOutputCrop(rect)) {
+        crop_ = rect;
+    }
+}
+
 void V4L2Scaler::Configure(int src_width, int src_height, uint32_t src_pix_fmt, int dst_width,
                            int dst_height, bool is_dma_src, bool is_dma_dst) {
     if (!Open(SCALER_FILE)) {
         ERROR_PRINT("Unable to turn on scaler: %s", SCALER_FILE);
     }
 
+    crop_ = {.left = 0, .top = 0, .width = (uint32_t)src_width, .height = (uint32_t)src_height};
+
     auto src_memory = is_dma_src ? V4L2_MEMORY_DMABUF : V4L2_MEMORY_MMAP;
-    if (!SetupOutputBuffer(src_width, src_height, src_pix_fmt, src_memory, BUFFER_NUM)) {
+    int buffer_num = BufferCounts().scaler;
+    if (!SetupOutputBuffer(src_width, src_height, src_pix_fmt, src_memory, buffer_num)) {
         ERROR_PRINT("Could not setup output buffer");
     }
     if (!SetupCaptureBuffer(dst_width, dst_height, V4L2_PIX_FMT_YUV420, V4L2_MEMORY_MMAP,
-                            BUFFER_NUM, is_dma_dst)) {
+                            buffer_num, is_dma_dst)) {
         ERROR_PRINT("Could not setup capture buffer");
     }
 }
@@ -8,8 +8,14 @@ class V4L2Scaler : public V4L2Codec {
     static std::unique_ptr<V4L2Scaler> Create(int src_width, int src_height, uint32_t src_pix_fmt,
                                               int dst_width, int dst_height, bool is_dma_src,
                                               bool is_dma_dst);
+    V4L2Scaler();
+
+    // scale only this area of the source frames, applied to the next queued frame.
+    void SetCrop(int x, int y, int width, int height);
 
   private:
+    v4l2_rect crop_;
+
     void Configure(int src_width, int src_height, uint32_t src_pix_fmt, int dst_width,
                    int dst_height, bool is_drm_src, bool is_drm_dst);
 };
@@ -0,0 +1,246 @@
+#include "codecs/v4l2/v4l2_simulcast_encoder.h"
+#include "codecs/v4l2/v4l2_encoded_image_buffer.h"
+#include "common/logging.h"
+#include "common/v4l2_frame_buffer.h"
+
+#include <algorithm>
+
+#include <rtc_base/time_utils.h>
+
+std::unique_ptr<webrtc::VideoEncoder> V4L2SimulcastEncoder::Create(Args args) {
+    return std::make_unique<V4L2SimulcastEncoder>(args);
+}
+
+V4L2SimulcastEncoder::Layer::Layer(int stream_idx, int width, int height, bool active,
+                                   KeyFrameSchedulerConfig keyframe_config)
+    : width(width),
+      height(height),
+      active(active),
+      bitrate_adjuster(.85, 1),
+      keyframe_scheduler("v4l2_simulcast", keyframe_config, stream_idx),
+      stats("v4l2_simulcast", true, stream_idx),
+      scaler_src_width(0),
+      scaler_src_height(0),
+      scaler_src_format(0) {
+    encoded_image.timing_.flags = webrtc::VideoSendTiming::TimingFrameFlags::kInvalid;
+    encoded_image.content_type_ = webrtc::VideoContentType::UNSPECIFIED;
+}
+
+V4L2SimulcastEncoder::V4L2SimulcastEncoder(Args args)
+    : fps_adjuster_(args.fps),
+      keyframe_config_({.merge_window_ms = args.keyframe_merge_window,
+                        .min_interval_ms = args.keyframe_min_interval}),
+      callback_(nullptr) {}
+
+int32_t V4L2SimulcastEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
+                                         const VideoEncoder::Settings &settings) {
+    codec_ = *codec_settings;
+    if (codec_.codecType != webrtc::kVideoCodecH264) {
+        return WEBRTC_VIDEO_CODEC_ERROR;
+    }
+
+    // a new resolution comes without Release(), stop the running layers before replacing them.
+    Release();
+    layers_.clear();
+    int num_streams = codec_settings->numberOfSimulcastStreams;
+    if (num_streams <= 1) {
+        auto layer =
+            std::make_unique<Layer>(0, codec_.width, codec_.height, true, keyframe_config_);
+        layer->bitrate_adjuster.SetTargetBitrateBps(codec_.startBitrate * 1000);
+        layers_.push_back(std::move(layer));
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    // the streams are ordered from the lowest resolution to the full one.
+    for (int i = 0; i < num_streams; i++) {
+        const auto &stream = codec_settings->simulcastStream[i];
+        auto layer = std::make_unique<Layer>(i, stream.width, stream.height, stream.active,
+                                             keyframe_config_);
+        layer->bitrate_adjuster.SetTargetBitrateBps(stream.targetBitrate * 1000);
+        layer->encoded_image.SetSpatialIndex(i);
+        layers_.push_back(std::move(layer));
+        DEBUG_PRINT("Simulcast layer %d: %dx%d, %u kbps", i, stream.width, stream.height,
+                    stream.targetBitrate);
+    }
+
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t
+V4L2SimulcastEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) {
+    callback_ = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t V4L2SimulcastEncoder::Release() {
+    for (auto &layer : layers_) {
+        // the scaler feeds the encoder, so it stops first.
+        layer->scaler.reset();
+        layer->encoder.reset();
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t V4L2SimulcastEncoder::Encode(const webrtc::VideoFrame &frame,
+                                     const std::vector<webrtc::VideoFrameType> *frame_types) {
+    if (!frame_types || frame_types->empty()) {
+        return WEBRTC_VIDEO_CODEC_NO_OUTPUT;
+    }
+
+    rtc::scoped_refptr<webrtc::VideoFrameBuffer> frame_buffer = frame.video_frame_buffer();
+    if (frame_buffer->type() != webrtc::VideoFrameBuffer::Type::kNative) {
+        return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+    }
+    auto v4l2_frame_buffer = V4L2FrameBufferRef(static_cast<V4L2FrameBuffer *>(frame_buffer.get()));
+
+    for (size_t i = 0; i < layers_.size(); i++) {
+        auto frame_type = (*frame_types)[std::min(i, frame_types->size() - 1)];
+        if (!layers_[i]->active || frame_type == webrtc::VideoFrameType::kEmptyFrame) {
+            continue;
+        }
+        if (frame_type == webrtc::VideoFrameType::kVideoFrameKey) {
+            layers_[i]->keyframe_scheduler.Request(KeyFrameReason::ReceiverRequest);
+        }
+        EncodeLayer(i, frame, v4l2_frame_buffer);
+    }
+
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+void V4L2SimulcastEncoder::EncodeLayer(size_t idx, const webrtc::VideoFrame &frame,
+                                       V4L2FrameBufferRef frame_buffer) {
+    auto layer = layers_[idx].get();
+    if (!layer->encoder) {
+        layer->encoder =
+            V4L2Encoder::Create(layer->width, layer->height, V4L2_PIX_FMT_YUV420, true);
+        layer->encoder->SetFps(fps_adjuster_);
+        layer->encoder->SetBitrate(layer->bitrate_adjuster.GetAdjustedBitrateBps());
+        layer->stats.OnRates(layer->bitrate_adjuster.GetTargetBitrateBps(),
+                             layer->bitrate_adjuster.GetAdjustedBitrateBps());
+    }
+
+    if (layer->keyframe_scheduler.ShouldForceKeyFrame()) {
+        layer->encoder->ForceKeyFrame();
+    }
+
+    // the downscaling counts into the latency of the lower layers.
+    int64_t encode_start_us = rtc::TimeMicros();
+    auto on_encoded = [this, idx, frame, encode_start_us](V4L2FrameBufferRef encoded_buffer) {
+        SendFrame(idx, frame, encoded_buffer, encode_start_us);
+    };
+
+    if (frame_buffer->width() == layer->width && frame_buffer->height() == layer->height) {
+        if (!layer->encoder->EmplaceBuffer(frame_buffer, on_encoded)) {
+            OnLayerDropped();
+        }
+        return;
+    }
+
+    if (!layer->scaler || layer->scaler_src_width != frame_buffer->width() ||
+        layer->scaler_src_height != frame_buffer->height() ||
+        layer->scaler_src_format != frame_buffer->format()) {
+        layer->scaler.reset();
+        layer->scaler = V4L2Scaler::Create(frame_buffer->width(), frame_buffer->height(),
+                                           frame_buffer->format(), layer->width, layer->height,
+                                           true, true);
+        layer->scaler_src_width = frame_buffer->width();
+        layer->scaler_src_height = frame_buffer->height();
+        layer->scaler_src_format = frame_buffer->format();
+        DEBUG_PRINT("Simulcast scaler is set: %dx%d -> %dx%d", frame_buffer->width(),
+                    frame_buffer->height(), layer->width, layer->height);
+    }
+
+    bool is_queued = layer->scaler->EmplaceBuffer(
+        frame_buffer,
+        [this, encoder = layer->encoder.get(), on_encoded](V4L2FrameBufferRef scaled_buffer) {
+            if (!encoder->EmplaceBuffer(scaled_buffer, on_encoded)) {
+                OnLayerDropped();
+            }
+        });
+    if (!is_queued) {
+        OnLayerDropped();
+    }
+}
+
+void V4L2SimulcastEncoder::OnLayerDropped() {
+    std::lock_guard<std::mutex> lock(send_mtx_);
+    callback_->OnDroppedFrame(webrtc::EncodedImageCallback::DropReason::kDroppedByEncoder);
+}
+
+void V4L2SimulcastEncoder::SetRates(const RateControlParameters &parameters) {
+    if (parameters.framerate_fps <= 0) {
+        return;
+    }
+    fps_adjuster_ = parameters.framerate_fps;
+
+    for (size_t i = 0; i < layers_.size(); i++) {
+        auto layer = layers_[i].get();
+        uint32_t bitrate_bps = layers_.size() > 1 ? parameters.bitrate.GetSpatialLayerSum(i)
+                                                  : parameters.bitrate.get_sum_bps();
+
+        // a layer without allocation is paused until the bandwidth recovers.
+        bool was_active = layer->active;
+        layer->active = bitrate_bps > 0;
+        if (!layer->active) {
+            continue;
+        }
+        layer->bitrate_adjuster.SetTargetBitrateBps(bitrate_bps);
+
+        if (!layer->encoder) {
+            continue;
+        }
+        if (!was_active) {
+            // the subscribers switching to the resumed layer need a fresh keyframe.
+            layer->keyframe_scheduler.Request(KeyFrameReason::LayerResume);
+        }
+        layer->encoder->SetFps(fps_adjuster_);
+        layer->encoder->SetBitrate(layer->bitrate_adjuster.GetAdjustedBitrateBps());
+    }
+}
+
+webrtc::VideoEncoder::EncoderInfo V4L2SimulcastEncoder::GetEncoderInfo() const {
+    EncoderInfo info;
+    info.supports_native_handle = true;
+    info.is_hardware_accelerated = true;
+    info.supports_simulcast = true;
+    info.implementation_name = "Raspberry Pi V4L2 H264 Simulcast Encoder";
+    return info;
+}
+
+void V4L2SimulcastEncoder::SendFrame(size_t idx, const webrtc::VideoFrame &frame,
+                                     V4L2FrameBufferRef encoded_buffer,
+                                     int64_t encode_start_us) {
+    auto encoded_image_buffer = V4L2EncodedImageBuffer::Create(encoded_buffer);
+
+    webrtc::CodecSpecificInfo codec_specific;
+    codec_specific.codecType = webrtc::kVideoCodecH264;
+    codec_specific.codecSpecific.H264.packetization_mode =
+        webrtc::H264PacketizationMode::NonInterleaved;
+
+    std::lock_guard<std::mutex> lock(send_mtx_);
+    auto layer = layers_[idx].get();
+    auto &encoded_image = layer->encoded_image;
+    encoded_image.SetEncodedData(encoded_image_buffer);
+    encoded_image.SetTimestamp(frame.timestamp());
+    encoded_image.SetColorSpace(frame.color_space());
+    encoded_image._encodedWidth = layer->width;
+    encoded_image._encodedHeight = layer->height;
+    encoded_image.capture_time_ms_ = frame.render_time_ms();
+    encoded_image.ntp_time_ms_ = frame.ntp_time_ms();
+    encoded_image.rotation_ = frame.rotation();
+    encoded_image._frameType = encoded_buffer->flags() & V4L2_BUF_FLAG_KEYFRAME
+                                   ? webrtc::VideoFrameType::kVideoFrameKey
+                                   : webrtc::VideoFrameType::kVideoFrameDelta;
+    if (encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey) {
+        layer->keyframe_scheduler.OnKeyFrame();
+    }
+    encoded_image.qp_ = layer->stats.OnEncoded(
+        encoded_image_buffer->data(), encoded_image_buffer->size(),
+        encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey, encode_start_us);
+
+    auto result = callback_->OnEncodedImage(encoded_image, &codec_specific);
+    encoded_image.ClearEncodedData();
+    if (result.error != webrtc::EncodedImageCallback::Result::OK) {
+        ERROR_PRINT("Failed to send the frame => %d", result.error);
+    }
+}
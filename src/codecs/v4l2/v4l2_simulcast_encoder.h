@@ -0,0 +1,73 @@
+#ifndef V4L2_SIMULCAST_ENCODER_H_
+#define V4L2_SIMULCAST_ENCODER_H_
+
+#include <mutex>
+
+// WebRTC
+#include <api/video_codecs/video_encoder.h>
+#include <common_video/include/bitrate_adjuster.h>
+#include <modules/video_coding/codecs/h264/include/h264.h>
+
+#include "args.h"
+#include "codecs/v4l2/v4l2_encoder.h"
+#include "codecs/v4l2/v4l2_scaler.h"
+#include "common/encoder_stats.h"
+#include "common/keyframe_scheduler.h"
+
+/**
+ * Encode every simulcast stream of the codec settings with its own hardware
+ * encoder. The lower layers are downscaled from the incoming DMA frame by the
+ * ISP, and each encoded image is tagged with its stream index so the SFU can
+ * forward a layer per subscriber.
+ */
+class V4L2SimulcastEncoder : public webrtc::VideoEncoder {
+  public:
+    static std::unique_ptr<webrtc::VideoEncoder> Create(Args args);
+    V4L2SimulcastEncoder(Args args);
+
+    int32_t InitEncode(const webrtc::VideoCodec *codec_settings,
+                       const VideoEncoder::Settings &settings) override;
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) override;
+    int32_t Release() override;
+    int32_t Encode(const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types) override;
+    void SetRates(const RateControlParameters &parameters) override;
+    webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const override;
+
+  private:
+    struct Layer {
+        Layer(int stream_idx, int width, int height, bool active,
+              KeyFrameSchedulerConfig keyframe_config);
+
+        int width;
+        int height;
+        bool active;
+        webrtc::EncodedImage encoded_image;
+        webrtc::BitrateAdjuster bitrate_adjuster;
+        KeyFrameScheduler keyframe_scheduler;
+        EncoderStats stats;
+        // the scaler feeds the encoder, so it is declared after it and destroyed first.
+        std::unique_ptr<V4L2Encoder> encoder;
+        std::unique_ptr<V4L2Scaler> scaler;
+        // the input the scaler is configured for.
+        int scaler_src_width;
+        int scaler_src_height;
+        uint32_t scaler_src_format;
+    };
+
+    int fps_adjuster_;
+    KeyFrameSchedulerConfig keyframe_config_;
+    webrtc::VideoCodec codec_;
+    webrtc::EncodedImageCallback *callback_;
+    std::vector<std::unique_ptr<Layer>> layers_;
+    // the layers are encoded on their own codec threads.
+    std::mutex send_mtx_;
+
+    void EncodeLayer(size_t idx, const webrtc::VideoFrame &frame,
+                     V4L2FrameBufferRef frame_buffer);
+    void SendFrame(size_t idx, const webrtc::VideoFrame &frame, V4L2FrameBufferRef encoded_buffer,
+                   int64_t encode_start_us);
+    void OnLayerDropped();
+};
+
+#endif // V4L2_SIMULCAST_ENCODER_H_
@@ -0,0 +1,244 @@
+#include "common/car_control.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+#include <rtc_base/time_utils.h>
+
+#include "common/logging.h"
+#include "common/metrics.h"
+
+const int REPORT_WINDOW_MS = 1000;
+// the delay baseline follows the clock drift over this many windows.
+const size_t BASELINE_WINDOWS = 10;
+static const std::vector<double> LATENCY_BUCKETS_MS = {1, 2, 5, 10, 20, 50, 100, 200, 500};
+static const std::vector<double> UART_BUCKETS_MS = {0.1, 0.2, 0.5, 1, 2, 5, 10};
+
+static uint16_t ReadLe16(const uint8_t *data) { return data[0] | data[1] << 8; }
+
+static uint32_t ReadLe32(const uint8_t *data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+static uint64_t ReadLe64(const uint8_t *data) {
+    return ReadLe32(data) | (uint64_t)ReadLe32(data + 4) << 32;
+}
+
+static void WriteLe(uint8_t *data, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static nlohmann::json Quantiles(std::vector<double> samples) {
+    if (samples.empty()) {
+        return nullptr;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double q) {
+        return samples[static_cast<size_t>(q * (samples.size() - 1))];
+    };
+    return {{"p50", at(0.5)}, {"p95", at(0.95)}, {"max", samples.back()}};
+}
+
+std::shared_ptr<CarControl> CarControl::Create(std::shared_ptr<UartController> uart,
+                                               int deadman_ms) {
+    return std::make_shared<CarControl>(std::move(uart), deadman_ms);
+}
+
+CarControl::CarControl(std::shared_ptr<UartController> uart, int deadman_ms)
+    : uart_(std::move(uart)),
+      deadman_ms_(deadman_ms),
+      last_command_ms_(0),
+      is_neutral_(true),
+      deadman_trips_(0) {
+    if (deadman_ms_ > 0) {
+        auto interval = std::chrono::milliseconds(std::clamp(deadman_ms_ / 4, 5, 50));
+        deadman_worker_ = std::make_unique<Worker>("CarDeadman", [this, interval]() {
+            std::this_thread::sleep_for(interval);
+            CheckDeadman();
+        });
+        deadman_worker_->Run();
+    }
+}
+
+CarControl::~CarControl() { deadman_worker_.reset(); }
+
+std::shared_ptr<CarControl::Session> CarControl::CreateSession() {
+    auto session = std::make_shared<Session>();
+    std::lock_guard<std::mutex> lock(mtx_);
+    session->deadman_trips = deadman_trips_;
+    return session;
+}
+
+bool CarControl::OnMessage(Session &session, const std::string &message, Reply reply) {
+    int64_t receive_us = rtc::TimeMicros();
+    auto *data = reinterpret_cast<const uint8_t *>(message.data());
+    if (message.size() < MESSAGE_SIZE || data[0] != MAGIC) {
+        return false;
+    }
+    bool is_timed = data[1] == TIMED_VERSION && message.size() == TIMED_MESSAGE_SIZE;
+    if (!is_timed && (data[1] != VERSION || message.size() != MESSAGE_SIZE)) {
+        ERROR_PRINT("Unsupported car control version %d (%zu bytes)", data[1], message.size());
+        return true;
+    }
+
+    uint32_t sequence = ReadLe32(data + 4);
+    int throttle = static_cast<int16_t>(ReadLe16(data + 8));
+    int steer = static_cast<int16_t>(ReadLe16(data + 10));
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    int64_t now_ms = receive_us / 1000;
+    auto &window = session.window;
+    if (window.start_ms < 0) {
+        window.start_ms = now_ms;
+    }
+    // the client may have restarted during the stop, take whatever sequence comes next.
+    if (session.deadman_trips != deadman_trips_) {
+        session.deadman_trips = deadman_trips_;
+        session.has_sequence = false;
+    }
+
+    // the wrap-around of the sequence counts as newer.
+    if (session.has_sequence && static_cast<int32_t>(sequence - session.last_sequence) <= 0) {
+        Metrics::Instance().Increment("car_control_stale_total");
+        window.stale++;
+    } else {
+        session.has_sequence = true;
+        session.last_sequence = sequence;
+        Metrics::Instance().Increment("car_control_commands_total");
+        window.commands++;
+        int64_t uart_us = Apply(throttle, steer);
+        if (is_timed) {
+            OnTimedCommand(session, sequence, ReadLe64(data + 12), receive_us, uart_us, reply);
+        }
+    }
+
+    if (now_ms - window.start_ms >= REPORT_WINDOW_MS) {
+        Flush(session, now_ms, reply);
+    }
+
+    return true;
+}
+
+void CarControl::Drive(int throttle, int steer) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Metrics::Instance().Increment("car_control_commands_total");
+    Apply(throttle, steer);
+}
+
+int64_t CarControl::Apply(int throttle, int steer) {
+    throttle = std::clamp(throttle, -500, 500);
+    steer = std::clamp(steer, -1000, 1000);
+
+    last_command_ms_ = rtc::TimeMillis();
+    is_neutral_ = throttle == 0 && steer == 0;
+
+    if (uart_ && uart_->IsConnected()) {
+        return uart_->SendCommand(throttle, steer);
+    }
+    return -1;
+}
+
+void CarControl::CheckDeadman() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (is_neutral_ || rtc::TimeMillis() - last_command_ms_ < deadman_ms_) {
+        return;
+    }
+
+    WARN_PRINT("No car control command in %d ms, back to neutral.", deadman_ms_);
+    Metrics::Instance().Increment("car_control_deadman_total");
+    // the sessions drop their sequences on their next message.
+    deadman_trips_++;
+    Apply(0, 0);
+}
+
+void CarControl::OnTimedCommand(Session &session, uint32_t sequence, uint64_t client_us,
+                                int64_t receive_us, int64_t uart_us, const Reply &reply) {
+    if (reply) {
+        uint8_t echo[ECHO_SIZE] = {MAGIC, TIMED_VERSION};
+        WriteLe(echo + 2, ECHO_FLAG, 2);
+        WriteLe(echo + 4, sequence, 4);
+        WriteLe(echo + 8, client_us, 8);
+        WriteLe(echo + 16, receive_us, 8);
+        WriteLe(echo + 24, uart_us, 8);
+        reply(std::string(reinterpret_cast<char *>(echo), ECHO_SIZE));
+    }
+
+    auto &metrics = Metrics::Instance();
+    auto &window = session.window;
+    if (uart_us >= 0) {
+        double uart_ms = (uart_us - receive_us) / 1000.0;
+        window.uart_ms.push_back(uart_ms);
+        metrics.ObserveHistogram("car_control_uart_ms", uart_ms, UART_BUCKETS_MS);
+    }
+
+    // the clocks of the client and the server differ by an unknown offset, only the changes of
+    // the transit time are meaningful.
+    int64_t transit_us = receive_us - static_cast<int64_t>(client_us);
+    window.min_transit_us = std::min(window.min_transit_us, transit_us);
+    int64_t baseline_us = window.min_transit_us;
+    for (int64_t min_transit_us : session.min_transits_us) {
+        baseline_us = std::min(baseline_us, min_transit_us);
+    }
+    double delay_ms = (transit_us - baseline_us) / 1000.0;
+    window.delay_ms.push_back(delay_ms);
+    metrics.ObserveHistogram("car_control_delay_ms", delay_ms, LATENCY_BUCKETS_MS);
+
+    if (session.has_transit) {
+        double jitter_ms = std::abs(transit_us - session.last_transit_us) / 1000.0;
+        // the interarrival jitter of RFC 3550.
+        session.smoothed_jitter_ms += (jitter_ms - session.smoothed_jitter_ms) / 16;
+        window.jitter_ms.push_back(jitter_ms);
+        metrics.ObserveHistogram("car_control_jitter_ms", jitter_ms, LATENCY_BUCKETS_MS);
+    }
+    session.has_transit = true;
+    session.last_transit_us = transit_us;
+}
+
+void CarControl::Flush(Session &session, int64_t now_ms, const Reply &reply) {
+    const auto &w = session.window;
+    double seconds = (now_ms - w.start_ms) / 1000.0;
+    auto delay = Quantiles(w.delay_ms);
+    auto jitter = Quantiles(w.jitter_ms);
+    auto uart = Quantiles(w.uart_ms);
+
+    auto &metrics = Metrics::Instance();
+    metrics.Set("car_control_rate", w.commands / seconds);
+    metrics.Set("car_control_smoothed_jitter_ms", session.smoothed_jitter_ms);
+    auto set_quantiles = [&metrics](const std::string &name, const nlohmann::json &quantiles) {
+        if (!quantiles.is_null()) {
+            metrics.Set(name + "{quantile=\"0.5\"}", quantiles["p50"].get<double>());
+            metrics.Set(name + "{quantile=\"0.95\"}", quantiles["p95"].get<double>());
+        }
+    };
+    set_quantiles("car_control_window_delay_ms", delay);
+    set_quantiles("car_control_window_jitter_ms", jitter);
+    set_quantiles("car_control_window_uart_ms", uart);
+
+    if (reply) {
+        nlohmann::json json = {
+            {"type", "control_latency"},
+            {"window_ms", now_ms - w.start_ms},
+            {"server_time_us", rtc::TimeMicros()},
+            {"commands", w.commands},
+            {"stale", w.stale},
+            {"delay_ms", delay},
+            {"jitter_ms", jitter},
+            {"smoothed_jitter_ms", session.smoothed_jitter_ms},
+            {"uart_ms", uart},
+        };
+        reply(json.dump());
+    }
+
+    if (w.min_transit_us != INT64_MAX) {
+        session.min_transits_us.push_back(w.min_transit_us);
+        if (session.min_transits_us.size() > BASELINE_WINDOWS) {
+            session.min_transits_us.pop_front();
+        }
+    }
+    session.window = {};
+    session.window.start_ms = now_ms;
+}
@@ -0,0 +1,115 @@
+#ifndef CAR_CONTROL_H_
+#define CAR_CONTROL_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/uart_controller.h"
+#include "common/worker.h"
+
+/**
+ * Drive the car from the control messages of any channel. The binary message
+ * is little-endian:
+ *
+ *   0: uint8  magic 0xC7
+ *   1: uint8  version, 1 or 2
+ *   2: uint16 flags, reserved 0
+ *   4: uint32 sequence
+ *   8: int16  throttle, -500 to 500
+ *  10: int16  steer, -1000 to 1000
+ *  12: uint64 client time in microseconds, version 2 only
+ *
+ * The messages may arrive out of order, those older than the last applied one
+ * of the same channel are dropped. The car goes back to neutral once no command
+ * arrives within the deadman timeout.
+ *
+ * A version 2 command is echoed back with the server times it was received and
+ * written to the UART, both from rtc::TimeMicros():
+ *
+ *   0: uint8  magic 0xC7
+ *   1: uint8  version 2
+ *   2: uint16 flags 0x0001
+ *   4: uint32 sequence
+ *   8: uint64 client time
+ *  16: int64  receive time
+ *  24: int64  uart write time, -1 if not written
+ *
+ * and its delay, jitter and UART latency go into the metric histograms and a
+ * `{"type":"control_latency",...}` report sent back every second.
+ */
+class CarControl {
+  public:
+    using Reply = std::function<void(const std::string &)>;
+
+    static const uint8_t MAGIC = 0xC7;
+    static const uint8_t VERSION = 1;
+    static const uint8_t TIMED_VERSION = 2;
+    static const uint16_t ECHO_FLAG = 0x0001;
+    static const size_t MESSAGE_SIZE = 12;
+    static const size_t TIMED_MESSAGE_SIZE = 20;
+    static const size_t ECHO_SIZE = 32;
+
+    /**
+     * The sequence and latency state of one control channel, so the clients
+     * neither drop each other's commands nor reset each other's statistics.
+     */
+    class Session {
+      private:
+        friend class CarControl;
+        struct Window {
+            int64_t start_ms = -1;
+            int commands = 0;
+            int stale = 0;
+            int64_t min_transit_us = INT64_MAX;
+            std::vector<double> delay_ms;
+            std::vector<double> jitter_ms;
+            std::vector<double> uart_ms;
+        };
+
+        bool has_sequence = false;
+        uint32_t last_sequence = 0;
+        // the deadman trips seen, a newer one drops the sequence.
+        uint64_t deadman_trips = 0;
+        Window window;
+        // the lowest transit of the recent windows, the delay is measured above it.
+        std::deque<int64_t> min_transits_us;
+        bool has_transit = false;
+        int64_t last_transit_us = 0;
+        double smoothed_jitter_ms = 0;
+    };
+
+    static std::shared_ptr<CarControl> Create(std::shared_ptr<UartController> uart,
+                                              int deadman_ms);
+
+    CarControl(std::shared_ptr<UartController> uart, int deadman_ms);
+    ~CarControl();
+
+    // one per control channel, created as it opens.
+    std::shared_ptr<Session> CreateSession();
+    // false if the message is not a binary control message. `reply` gets the echoes and reports.
+    bool OnMessage(Session &session, const std::string &message, Reply reply = nullptr);
+    // the commands without a sequence, e.g. the protobuf and json ones.
+    void Drive(int throttle, int steer);
+
+  private:
+    std::shared_ptr<UartController> uart_;
+    int deadman_ms_;
+    std::mutex mtx_;
+    int64_t last_command_ms_;
+    bool is_neutral_;
+    uint64_t deadman_trips_;
+    std::unique_ptr<Worker> deadman_worker_;
+
+    int64_t Apply(int throttle, int steer);
+    void CheckDeadman();
+    void OnTimedCommand(Session &session, uint32_t sequence, uint64_t client_us,
+                        int64_t receive_us, int64_t uart_us, const Reply &reply);
+    void Flush(Session &session, int64_t now_ms, const Reply &reply);
+};
+
+#endif // CAR_CONTROL_H_
@@ -0,0 +1,146 @@
+#include "common/encoder_stats.h"
+
+#include <algorithm>
+
+#include <nlohmann/json.hpp>
+#include <rtc_base/time_utils.h>
+
+#include "common/metrics.h"
+
+const int STATS_WINDOW_MS = 1000;
+
+static std::mutex publisher_mtx;
+static EncoderStats::Publisher stats_publisher;
+
+void EncoderStats::SetPublisher(Publisher publisher) {
+    std::lock_guard<std::mutex> lock(publisher_mtx);
+    stats_publisher = std::move(publisher);
+}
+
+EncoderStats::EncoderStats(const std::string &name, bool is_h264, int stream_idx)
+    : name_(name),
+      stream_idx_(stream_idx),
+      labels_("encoder=\"" + name + "\",stream=\"" + std::to_string(stream_idx) + "\""),
+      is_h264_(is_h264),
+      target_bps_(0),
+      adjusted_bps_(0),
+      is_rate_changed_(false) {}
+
+void EncoderStats::OnRates(uint32_t target_bps, uint32_t adjusted_bps) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (adjusted_bps != adjusted_bps_) {
+        is_rate_changed_ = true;
+    }
+    target_bps_ = target_bps;
+    adjusted_bps_ = adjusted_bps;
+}
+
+int EncoderStats::OnEncoded(const uint8_t *data, size_t size, bool is_keyframe,
+                            int64_t encode_start_us) {
+    int64_t encode_us = rtc::TimeMicros() - encode_start_us;
+    int qp = ParseQp(data, size);
+
+    auto &metrics = Metrics::Instance();
+    std::string type = is_keyframe ? "key" : "delta";
+    metrics.Increment("encoder_frames_total{" + labels_ + ",type=\"" + type + "\"}");
+    metrics.Observe("encoder_frame_bytes{" + labels_ + ",type=\"" + type + "\"}", size);
+    metrics.Observe("encoder_encode_ms{" + labels_ + "}", encode_us / 1000.0);
+    if (qp >= 0) {
+        metrics.Observe("encoder_qp{" + labels_ + "}", qp);
+    }
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    int64_t now_ms = rtc::TimeMillis();
+    if (window_.start_ms < 0) {
+        window_.start_ms = now_ms;
+    }
+
+    window_.frames++;
+    window_.keyframes += is_keyframe ? 1 : 0;
+    window_.bytes += size;
+    window_.max_bytes = std::max(window_.max_bytes, size);
+    window_.encode_us += encode_us;
+    window_.max_encode_us = std::max(window_.max_encode_us, encode_us);
+    if (qp >= 0) {
+        window_.min_qp = window_.qp_frames == 0 ? qp : std::min(window_.min_qp, qp);
+        window_.max_qp = window_.qp_frames == 0 ? qp : std::max(window_.max_qp, qp);
+        window_.qp_frames++;
+        window_.qp_sum += qp;
+    }
+    if (is_rate_changed_) {
+        // the frame is the first one encoded at the new rate.
+        window_.rate_adjustments++;
+        metrics.Increment("encoder_rate_adjustments_total{" + labels_ + "}");
+        is_rate_changed_ = false;
+    }
+
+    if (now_ms - window_.start_ms >= STATS_WINDOW_MS) {
+        std::string stats = Flush(now_ms);
+        lock.unlock();
+        Publish(stats);
+    }
+
+    return qp;
+}
+
+int EncoderStats::ParseQp(const uint8_t *data, size_t size) {
+    if (!is_h264_ || !data || size == 0) {
+        return -1;
+    }
+    // the sps and pps are kept from the keyframes, the deltas only need their slice headers.
+    h264_parser_.ParseBitstream(rtc::ArrayView<const uint8_t>(data, size));
+    return h264_parser_.GetLastSliceQp().value_or(-1);
+}
+
+std::string EncoderStats::Flush(int64_t now_ms) {
+    const Window &w = window_;
+    double seconds = (now_ms - w.start_ms) / 1000.0;
+    double fps = w.frames / seconds;
+    double bitrate_bps = w.bytes * 8 / seconds;
+    double keyframe_ratio = static_cast<double>(w.keyframes) / w.frames;
+    double avg_bytes = static_cast<double>(w.bytes) / w.frames;
+    double avg_encode_ms = w.encode_us / 1000.0 / w.frames;
+    double max_encode_ms = w.max_encode_us / 1000.0;
+
+    // the instances of a kind share their series, a gauge would only hold the last one flushed.
+    auto &metrics = Metrics::Instance();
+    metrics.Observe("encoder_target_bitrate_bps{" + labels_ + "}", target_bps_);
+    metrics.Observe("encoder_adjusted_bitrate_bps{" + labels_ + "}", adjusted_bps_);
+
+    nlohmann::json json = {
+        {"type", "encoder_stats"},
+        {"encoder", name_},
+        {"stream", stream_idx_},
+        {"window_ms", now_ms - w.start_ms},
+        {"frames", w.frames},
+        {"fps", fps},
+        {"bitrate_bps", bitrate_bps},
+        {"target_bitrate_bps", target_bps_},
+        {"adjusted_bitrate_bps", adjusted_bps_},
+        {"rate_adjustments", w.rate_adjustments},
+        {"keyframes", w.keyframes},
+        {"keyframe_ratio", keyframe_ratio},
+        {"bytes", {{"avg", avg_bytes}, {"max", w.max_bytes}}},
+        {"encode_ms", {{"avg", avg_encode_ms}, {"max", max_encode_ms}}},
+    };
+    if (w.qp_frames > 0) {
+        double avg_qp = static_cast<double>(w.qp_sum) / w.qp_frames;
+        json["qp"] = {{"avg", avg_qp}, {"min", w.min_qp}, {"max", w.max_qp}};
+    }
+
+    window_ = {};
+    window_.start_ms = now_ms;
+
+    return json.dump();
+}
+
+void EncoderStats::Publish(const std::string &stats) {
+    Publisher publisher;
+    {
+        std::lock_guard<std::mutex> lock(publisher_mtx);
+        publisher = stats_publisher;
+    }
+    if (publisher) {
+        publisher(stats);
+    }
+}
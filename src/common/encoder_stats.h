@@ -0,0 +1,66 @@
+#ifndef ENCODER_STATS_H_
+#define ENCODER_STATS_H_
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <common_video/h264/h264_bitstream_parser.h>
+
+/**
+ * Per-frame statistics of an encoder: size, type, encode latency, QP and the
+ * rate changes. Every frame feeds the metric counters and summaries, which the
+ * instances of the same kind and stream share. The aggregates of each instance
+ * over the last second are published, e.g. over IPC as
+ * `{"type":"encoder_stats","encoder":"v4l2_h264","stream":0,"fps":30,...}`.
+ */
+class EncoderStats {
+  public:
+    using Publisher = std::function<void(const std::string &)>;
+
+    // where the aggregates of all the encoders go besides the metrics.
+    static void SetPublisher(Publisher publisher);
+
+    EncoderStats(const std::string &name, bool is_h264 = true, int stream_idx = 0);
+
+    // the target of the rate controller and the rate actually set to the encoder.
+    void OnRates(uint32_t target_bps, uint32_t adjusted_bps);
+    // `encode_start_us` from rtc::TimeMicros() as the frame went in, returns the QP or -1.
+    int OnEncoded(const uint8_t *data, size_t size, bool is_keyframe, int64_t encode_start_us);
+
+  private:
+    struct Window {
+        int64_t start_ms = -1;
+        int frames = 0;
+        int keyframes = 0;
+        uint64_t bytes = 0;
+        size_t max_bytes = 0;
+        int64_t encode_us = 0;
+        int64_t max_encode_us = 0;
+        int qp_frames = 0;
+        int64_t qp_sum = 0;
+        int min_qp = 0;
+        int max_qp = 0;
+        int rate_adjustments = 0;
+    };
+
+    std::string name_;
+    int stream_idx_;
+    std::string labels_;
+    bool is_h264_;
+    webrtc::H264BitstreamParser h264_parser_;
+
+    std::mutex mtx_;
+    Window window_;
+    uint32_t target_bps_;
+    uint32_t adjusted_bps_;
+    bool is_rate_changed_;
+
+    int ParseQp(const uint8_t *data, size_t size);
+    // returns the aggregates to publish once the lock is released.
+    std::string Flush(int64_t now_ms);
+    static void Publish(const std::string &stats);
+};
+
+#endif // ENCODER_STATS_H_
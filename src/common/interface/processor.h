@@ -17,8 +17,10 @@ class IFrameProcessor {
      *
      * @param frame_buffer Frame buffer to be processed by the device.
      * @param on_capture Callback invoked with the resulting frame buffer.
+     * @return false if the frame is not queued, e.g. the device has no free buffer, so the caller
+     * can drop it deliberately or slow down.
      */
-    virtual void EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
+    virtual bool EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
                                std::function<void(V4L2FrameBufferRef)> on_capture) = 0;
 };
 
@@ -0,0 +1,72 @@
+#include "common/keyframe_scheduler.h"
+
+#include <rtc_base/time_utils.h>
+
+#include "common/logging.h"
+#include "common/metrics.h"
+
+KeyFrameScheduler::KeyFrameScheduler(const std::string &name, KeyFrameSchedulerConfig config,
+                                     int stream_idx)
+    : name_(name),
+      labels_("encoder=\"" + name + "\",stream=\"" + std::to_string(stream_idx) + "\""),
+      config_(config),
+      is_pending_(false),
+      last_keyframe_ms_(-1),
+      last_forced_ms_(-1) {}
+
+void KeyFrameScheduler::Request(KeyFrameReason reason, const std::string &peer) {
+    // the peers come and go, their own counts are kept by whoever tracks them.
+    Metrics::Instance().Increment("keyframe_requests_total{" + labels_ + ",reason=\"" +
+                                  ReasonToString(reason) + "\"}");
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    // the loss reports sent before the last keyframe arrived don't need another one.
+    bool is_answered = reason != KeyFrameReason::NewReceiver && last_keyframe_ms_ >= 0 &&
+                       rtc::TimeMillis() - last_keyframe_ms_ < config_.merge_window_ms;
+    if (is_pending_ || is_answered) {
+        Metrics::Instance().Increment("keyframe_requests_merged_total{" + labels_ + "}");
+        return;
+    }
+
+    DEBUG_PRINT("[%s] keyframe requested by %s: %s", name_.c_str(),
+                peer.empty() ? "receiver" : peer.c_str(), ReasonToString(reason));
+    is_pending_ = true;
+}
+
+bool KeyFrameScheduler::ShouldForceKeyFrame() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!is_pending_) {
+        return false;
+    }
+
+    int64_t now_ms = rtc::TimeMillis();
+    if (last_forced_ms_ >= 0 && now_ms - last_forced_ms_ < config_.min_interval_ms) {
+        return false;
+    }
+
+    is_pending_ = false;
+    last_forced_ms_ = now_ms;
+    last_keyframe_ms_ = now_ms;
+    Metrics::Instance().Increment("keyframes_forced_total{" + labels_ + "}");
+    return true;
+}
+
+void KeyFrameScheduler::OnKeyFrame() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    last_keyframe_ms_ = rtc::TimeMillis();
+}
+
+const char *KeyFrameScheduler::ReasonToString(KeyFrameReason reason) {
+    switch (reason) {
+        case KeyFrameReason::NewReceiver:
+            return "new_receiver";
+        case KeyFrameReason::ReceiverRequest:
+            return "receiver_request";
+        case KeyFrameReason::LayerResume:
+            return "layer_resume";
+        case KeyFrameReason::RefreshFallback:
+            return "refresh_fallback";
+        default:
+            return "unknown";
+    }
+}
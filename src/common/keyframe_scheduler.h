@@ -0,0 +1,51 @@
+#ifndef KEYFRAME_SCHEDULER_H_
+#define KEYFRAME_SCHEDULER_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+enum class KeyFrameReason {
+    NewReceiver,
+    ReceiverRequest,
+    LayerResume,
+    RefreshFallback
+};
+
+struct KeyFrameSchedulerConfig {
+    // the requests within this time after a keyframe are answered by it.
+    int merge_window_ms = 250;
+    // the forced IDRs are at least this far apart.
+    int min_interval_ms = 500;
+};
+
+/**
+ * Decide when an encoder forces an IDR. The keyframe requests of the receivers
+ * are merged into the one already on the way, and the rest wait for the
+ * minimum interval, so joining or lossy viewers can't flood the uplink with
+ * keyframes. The requests are counted per encoder kind, stream and reason.
+ */
+class KeyFrameScheduler {
+  public:
+    // `name` is the kind of the encoder and `stream_idx` its simulcast layer, the metric labels.
+    KeyFrameScheduler(const std::string &name, KeyFrameSchedulerConfig config, int stream_idx = 0);
+
+    void Request(KeyFrameReason reason, const std::string &peer = "");
+    // called for every frame, true if the encoder should force it to an IDR.
+    bool ShouldForceKeyFrame();
+    // any keyframe the encoder produced, including the periodic ones.
+    void OnKeyFrame();
+
+    static const char *ReasonToString(KeyFrameReason reason);
+
+  private:
+    std::mutex mtx_;
+    std::string name_;
+    std::string labels_;
+    KeyFrameSchedulerConfig config_;
+    bool is_pending_;
+    int64_t last_keyframe_ms_;
+    int64_t last_forced_ms_;
+};
+
+#endif // KEYFRAME_SCHEDULER_H_
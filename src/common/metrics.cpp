@@ -0,0 +1,137 @@
+#include "common/metrics.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "common/logging.h"
+
+namespace {
+
+// Append a suffix to the metric name while keeping the label set at the end.
+std::string WithSuffix(const std::string &name, const std::string &suffix) {
+    auto pos = name.find('{');
+    if (pos == std::string::npos) {
+        return name + suffix;
+    }
+    return name.substr(0, pos) + suffix + name.substr(pos);
+}
+
+// Add the `le` label of a histogram bucket to the other labels.
+std::string WithBucket(const std::string &name, const std::string &le) {
+    auto pos = name.find('{');
+    if (pos == std::string::npos) {
+        return name + "_bucket{le=\"" + le + "\"}";
+    }
+    return name.substr(0, pos) + "_bucket" + name.substr(pos, name.size() - pos - 1) + ",le=\"" +
+           le + "\"}";
+}
+
+} // namespace
+
+Metrics &Metrics::Instance() {
+    static Metrics instance;
+    return instance;
+}
+
+void Metrics::Set(const std::string &name, double value) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    gauges_[name] = value;
+}
+
+void Metrics::Increment(const std::string &name, double value) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    counters_[name] += value;
+}
+
+void Metrics::Observe(const std::string &name, double value) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto &summary = summaries_[name];
+    if (summary.count == 0 || value < summary.min) {
+        summary.min = value;
+    }
+    if (summary.count == 0 || value > summary.max) {
+        summary.max = value;
+    }
+    summary.count++;
+    summary.sum += value;
+    summary.last = value;
+}
+
+void Metrics::ObserveHistogram(const std::string &name, double value,
+                               const std::vector<double> &bounds) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto &histogram = histograms_[name];
+    if (histogram.counts.empty()) {
+        histogram.bounds = bounds;
+        histogram.counts.resize(bounds.size() + 1, 0);
+    }
+    size_t i = 0;
+    while (i < histogram.bounds.size() && value > histogram.bounds[i]) {
+        i++;
+    }
+    histogram.counts[i]++;
+    histogram.count++;
+    histogram.sum += value;
+}
+
+void Metrics::Remove(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    gauges_.erase(name);
+    counters_.erase(name);
+    summaries_.erase(name);
+    histograms_.erase(name);
+}
+
+std::string Metrics::ToString() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::ostringstream oss;
+
+    for (const auto &[name, value] : counters_) {
+        oss << name << " " << value << "\n";
+    }
+    for (const auto &[name, value] : gauges_) {
+        oss << name << " " << value << "\n";
+    }
+    for (const auto &[name, summary] : summaries_) {
+        oss << WithSuffix(name, "_count") << " " << summary.count << "\n";
+        oss << WithSuffix(name, "_sum") << " " << summary.sum << "\n";
+        oss << WithSuffix(name, "_min") << " " << summary.min << "\n";
+        oss << WithSuffix(name, "_max") << " " << summary.max << "\n";
+        oss << WithSuffix(name, "_last") << " " << summary.last << "\n";
+    }
+    for (const auto &[name, histogram] : histograms_) {
+        // the buckets are cumulative.
+        uint64_t count = 0;
+        for (size_t i = 0; i < histogram.bounds.size(); ++i) {
+            count += histogram.counts[i];
+            std::ostringstream le;
+            le << histogram.bounds[i];
+            oss << WithBucket(name, le.str()) << " " << count << "\n";
+        }
+        oss << WithBucket(name, "+Inf") << " " << histogram.count << "\n";
+        oss << WithSuffix(name, "_count") << " " << histogram.count << "\n";
+        oss << WithSuffix(name, "_sum") << " " << histogram.sum << "\n";
+    }
+
+    return oss.str();
+}
+
+bool Metrics::WriteToFile(const std::string &path) const {
+    // write into a temporary file and rename it, so readers never see a partial file.
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file.is_open()) {
+            ERROR_PRINT("Failed to open metrics file: %s", tmp_path.c_str());
+            return false;
+        }
+        file << ToString();
+    }
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        ERROR_PRINT("Failed to rename metrics file: %s", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Process-wide registry of runtime counters, gauges, summaries and histograms.
+ * Metric names follow the Prometheus convention and may carry labels,
+ * e.g. `keyframe_requests_total{reason="pli"}`.
+ */
+class Metrics {
+  public:
+    static Metrics &Instance();
+
+    void Set(const std::string &name, double value);
+    void Increment(const std::string &name, double value = 1.0);
+    void Observe(const std::string &name, double value);
+    // `bounds` are the ascending upper bounds of the buckets, fixed by the first observation.
+    void ObserveHistogram(const std::string &name, double value, const std::vector<double> &bounds);
+    // drop the series of a source that went away, e.g. a disconnected peer.
+    void Remove(const std::string &name);
+
+    // Prometheus text exposition format.
+    std::string ToString() const;
+    bool WriteToFile(const std::string &path) const;
+
+  private:
+    struct Summary {
+        uint64_t count = 0;
+        double sum = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        double last = 0.0;
+    };
+
+    struct Histogram {
+        std::vector<double> bounds;
+        // one more than the bounds, the last one is +Inf.
+        std::vector<uint64_t> counts;
+        uint64_t count = 0;
+        double sum = 0.0;
+    };
+
+    Metrics() = default;
+
+    mutable std::mutex mtx_;
+    std::map<std::string, double> gauges_;
+    std::map<std::string, double> counters_;
+    std::map<std::string, Summary> summaries_;
+    std::map<std::string, Histogram> histograms_;
+};
+
+#endif // METRICS_H_
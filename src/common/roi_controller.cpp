@@ -0,0 +1,67 @@
+#include "common/roi_controller.h"
+
+#include <algorithm>
+
+#include <nlohmann/json.hpp>
+#include <rtc_base/time_utils.h>
+
+#include "common/logging.h"
+#include "common/metrics.h"
+
+const int DEFAULT_ROI_TTL_MS = 1000;
+
+RoiController &RoiController::Instance() {
+    static RoiController instance;
+    return instance;
+}
+
+bool RoiController::OnMessage(const std::string &message) {
+    if (message.empty() || message.front() != '{') {
+        return false;
+    }
+
+    auto json = nlohmann::json::parse(message, nullptr, false);
+    if (json.is_discarded() || !json.is_object() || !json.contains("type") ||
+        json["type"] != "roi") {
+        return false;
+    }
+
+    std::vector<RoiRegion> regions;
+    int ttl_ms = DEFAULT_ROI_TTL_MS;
+    try {
+        for (const auto &item : json.value("regions", nlohmann::json::array())) {
+            if (static_cast<int>(regions.size()) >= MAX_REGIONS) {
+                break;
+            }
+            RoiRegion region;
+            region.x = std::clamp(item.value("x", 0.0f), 0.0f, 1.0f);
+            region.y = std::clamp(item.value("y", 0.0f), 0.0f, 1.0f);
+            region.width = std::clamp(item.value("w", 0.0f), 0.0f, 1.0f - region.x);
+            region.height = std::clamp(item.value("h", 0.0f), 0.0f, 1.0f - region.y);
+            region.qp_delta = std::clamp(item.value("qp", 0), -51, 51);
+            if (region.width > 0 && region.height > 0 && region.qp_delta != 0) {
+                regions.push_back(region);
+            }
+        }
+        ttl_ms = std::max(json.value("ttl", DEFAULT_ROI_TTL_MS), 0);
+    } catch (const std::exception &e) {
+        ERROR_PRINT("Invalid roi message: %s", e.what());
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    regions_ = std::move(regions);
+    expire_ms_ = rtc::TimeMillis() + ttl_ms;
+    Metrics::Instance().Increment("roi_updates_total");
+    Metrics::Instance().Set("roi_regions", regions_.size());
+
+    return true;
+}
+
+std::vector<RoiRegion> RoiController::Regions() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (rtc::TimeMillis() >= expire_ms_) {
+        return {};
+    }
+    return regions_;
+}
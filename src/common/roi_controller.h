@@ -0,0 +1,43 @@
+#ifndef ROI_CONTROLLER_H_
+#define ROI_CONTROLLER_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// the coordinates are fractions (0.0 to 1.0) of the frame, so any resolution can use them.
+struct RoiRegion {
+    float x;
+    float y;
+    float width;
+    float height;
+    // negative for more bits, positive for fewer.
+    int qp_delta;
+};
+
+/**
+ * Process-wide store of the regions of interest reported by an external
+ * detector, e.g. `{"type":"roi","ttl":1000,"regions":[{"x":0.1,"y":0.4,
+ * "w":0.2,"h":0.2,"qp":-8}]}`. The regions expire after `ttl` milliseconds
+ * without an update, so a stalled detector doesn't pin the bits to old boxes.
+ */
+class RoiController {
+  public:
+    static const int MAX_REGIONS = 8;
+
+    static RoiController &Instance();
+
+    // false if the message is not a roi message.
+    bool OnMessage(const std::string &message);
+    std::vector<RoiRegion> Regions() const;
+
+  private:
+    RoiController() = default;
+
+    mutable std::mutex mtx_;
+    std::vector<RoiRegion> regions_;
+    int64_t expire_ms_ = 0;
+};
+
+#endif // ROI_CONTROLLER_H_
@@ -7,6 +7,8 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include <rtc_base/time_utils.h>
+
 std::shared_ptr<UartController> UartController::Create(const std::string &device, int baud_rate) {
     auto controller = std::make_shared<UartController>(device, baud_rate);
     if (!controller->Init()) {
@@ -114,9 +116,9 @@ bool UartController::ConfigurePort() {
     return true;
 }
 
-void UartController::SendCommand(int throttle, int steer) {
+int64_t UartController::SendCommand(int throttle, int steer) {
     if (!connected_ || fd_ < 0) {
-        return;
+        return -1;
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
@@ -130,12 +132,16 @@ void UartController::SendCommand(int throttle, int steer) {
     ssize_t written = write(fd_, cmd, len);
     if (written < 0) {
         ERROR_PRINT("UART write failed: %s", strerror(errno));
+        return -1;
     }
+    int64_t write_us = rtc::TimeMicros();
 
     // Log non-zero commands occasionally
     if ((throttle != 0 || steer != 0) && (seq_ % 100 == 0)) {
         DEBUG_PRINT("UART TX: throttle=%d, steer=%d, seq=%u", throttle, steer, seq_);
     }
+
+    return write_us;
 }
 
 void UartController::Stop() {
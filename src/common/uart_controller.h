@@ -14,7 +14,8 @@ class UartController {
     ~UartController();
 
     bool Init();
-    void SendCommand(int throttle, int steer);
+    // the rtc::TimeMicros() when the command was written, -1 if it was not.
+    int64_t SendCommand(int throttle, int steer);
     void Stop();
     bool IsConnected() const { return connected_.load(); }
 
@@ -1,11 +1,11 @@
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <regex>
 #include <sstream>
-#include <sys/statvfs.h>
 #include <uuid/uuid.h>
 
 extern "C" {
@@ -34,91 +34,6 @@ bool Utils::CreateFolder(const std::string &folder_path) {
     }
 }
 
-void Utils::RotateFiles(const std::string &folder_path) {
-    std::vector<fs::path> date_folders;
-
-    for (const auto &entry : fs::directory_iterator(folder_path)) {
-        if (entry.is_directory()) {
-            date_folders.push_back(entry.path());
-        }
-    }
-
-    if (date_folders.empty()) {
-        return;
-    }
-
-    std::sort(date_folders.begin(), date_folders.end());
-    fs::path oldest_date_folder = date_folders.front();
-    std::vector<fs::path> hour_folders;
-
-    for (const auto &hour_entry : fs::directory_iterator(oldest_date_folder)) {
-        if (hour_entry.is_directory()) {
-            hour_folders.push_back(hour_entry.path());
-        }
-    }
-
-    if (hour_folders.empty()) {
-        return;
-    }
-
-    std::sort(hour_folders.begin(), hour_folders.end());
-    fs::path oldest_hour_folder = hour_folders.front();
-
-    try {
-        std::vector<fs::directory_entry> media_files;
-        for (const auto &file : fs::directory_iterator(oldest_hour_folder)) {
-            if (file.is_regular_file()) {
-                std::string ext = file.path().extension().string();
-                if (ext == ".mp4" || ext == ".jpg") {
-                    media_files.push_back(file);
-                }
-            }
-        }
-
-        if (media_files.empty()) {
-            fs::remove_all(oldest_hour_folder);
-            INFO_PRINT("Deleted empty hour folder: %s", oldest_hour_folder.string().c_str());
-            return;
-        }
-
-        // sort by filename
-        std::sort(media_files.begin(), media_files.end(),
-                  [](const fs::directory_entry &a, const fs::directory_entry &b) {
-                      return a.path().filename() < b.path().filename();
-                  });
-
-        fs::path oldest_file = media_files.front().path();
-        fs::remove(oldest_file);
-        INFO_PRINT("Deleted file: %s", oldest_file.string().c_str());
-
-        // delete same name with different extension
-        fs::path counterpart = oldest_file;
-        if (oldest_file.extension() == ".mp4") {
-            counterpart.replace_extension(".jpg");
-        } else {
-            counterpart.replace_extension(".mp4");
-        }
-
-        if (fs::exists(counterpart)) {
-            fs::remove(counterpart);
-            INFO_PRINT("Deleted counterpart file: %s", counterpart.string().c_str());
-        }
-
-        // clean up folder if empty
-        if (fs::is_empty(oldest_hour_folder)) {
-            fs::remove(oldest_hour_folder);
-            INFO_PRINT("Deleted empty hour folder: %s", oldest_hour_folder.string().c_str());
-
-            if (fs::is_empty(oldest_date_folder)) {
-                fs::remove(oldest_date_folder);
-                INFO_PRINT("Deleted empty date folder: %s", oldest_date_folder.string().c_str());
-            }
-        }
-    } catch (const fs::filesystem_error &e) {
-        std::cerr << "Error while deleting: " << e.what() << std::endl;
-    }
-}
-
 std::string Utils::ToBase64(const std::string &binary_file) {
     std::string out;
     int val = 0, valb = -6;
@@ -261,7 +176,8 @@ std::chrono::system_clock::time_point Utils::ParseDatetime(const std::string &da
     return std::chrono::system_clock::from_time_t(std::mktime(&tm));
 }
 
-std::string Utils::FindFilesFromDatetime(const std::string &root, const std::string &basename) {
+std::string Utils::FindFilesFromDatetime(const std::string &root, const std::string &basename,
+                                         const std::string &extension) {
     if (basename.length() < 15) {
         return "";
     }
@@ -278,13 +194,13 @@ std::string Utils::FindFilesFromDatetime(const std::string &root, const std::str
 
     auto time_limit = ParseDatetime(basename);
 
-    auto files = GetFiles(hour_path.string(), ".mp4");
+    auto files = GetFiles(hour_path.string(), extension);
     std::sort(files.begin(), files.end(), std::greater<>());
 
     int max_searching_folder = 10;
     for (int count = 0; count < max_searching_folder; count++) {
         // find in the same hour
-        auto files = GetFiles(hour_path.string(), ".mp4");
+        auto files = GetFiles(hour_path.string(), extension);
         std::sort(files.begin(), files.end(), std::greater<>());
 
         for (auto &p : files) {
@@ -377,14 +293,6 @@ std::vector<std::string> Utils::FindOlderFiles(const std::string &file_path, int
     return result;
 }
 
-bool Utils::CheckDriveSpace(const std::string &file_path, unsigned long min_free_byte) {
-    struct statvfs stat;
-    if (statvfs(file_path.c_str(), &stat) != 0) {
-        return false;
-    }
-    return (stat.f_bsize * stat.f_bavail) >= min_free_byte;
-}
-
 std::string Utils::PrefixZero(int src, int digits) {
     std::string str = std::to_string(src);
     std::string n_zero(digits - str.length(), '0');
@@ -392,6 +300,16 @@ std::string Utils::PrefixZero(int src, int digits) {
 }
 
 Buffer Utils::ConvertYuvToJpeg(const uint8_t *yuv_data, int width, int height, int quality) {
+    int chroma_width = (width + 1) / 2;
+    const uint8_t *u_data = yuv_data + width * height;
+    const uint8_t *v_data = u_data + chroma_width * ((height + 1) / 2);
+    return ConvertI420ToJpeg(yuv_data, width, u_data, chroma_width, v_data, chroma_width, width,
+                             height, quality);
+}
+
+Buffer Utils::ConvertI420ToJpeg(const uint8_t *y_data, int y_stride, const uint8_t *u_data,
+                                int u_stride, const uint8_t *v_data, int v_stride, int width,
+                                int height, int quality) {
     struct jpeg_compress_struct cinfo;
     struct jpeg_error_mgr jerr;
 
@@ -406,28 +324,69 @@ Buffer Utils::ConvertYuvToJpeg(const uint8_t *yuv_data, int width, int height, i
     cinfo.image_width = width;
     cinfo.image_height = height;
     cinfo.input_components = 3;
-    cinfo.in_color_space = JCS_EXT_BGR;
+    cinfo.in_color_space = JCS_YCbCr;
 
     jpeg_set_defaults(&cinfo);
     jpeg_set_quality(&cinfo, quality, TRUE);
 
-    JSAMPROW row_pointer[1];
-    int row_stride = width * 3;
-    uint8_t *rgb_data = (uint8_t *)malloc(width * height * 3);
-    libyuv::I420ToRGB24(yuv_data, width, yuv_data + width * height, width / 2,
-                        yuv_data + width * height + (width * height / 4), width / 2, rgb_data,
-                        width * 3, width, height);
+    // feed the 4:2:0 planes as they are, without the conversion to rgb and back.
+    cinfo.raw_data_in = TRUE;
+#if JPEG_LIB_VERSION >= 70
+    cinfo.do_fancy_downsampling = FALSE;
+#endif
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 2;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
 
     jpeg_start_compress(&cinfo, TRUE);
 
+    // libjpeg reads whole MCUs, so the rows past the right edge come from a padded copy.
+    const int mcu_rows = 2 * DCTSIZE;
+    int padded_width = (width + mcu_rows - 1) / mcu_rows * mcu_rows;
+    bool need_padding = padded_width != width;
+    std::vector<uint8_t> padded_y(need_padding ? padded_width * mcu_rows : 0);
+    std::vector<uint8_t> padded_u(need_padding ? padded_width / 2 * DCTSIZE : 0);
+    std::vector<uint8_t> padded_v(need_padding ? padded_width / 2 * DCTSIZE : 0);
+
+    auto fill_row = [need_padding](JSAMPROW *rows, int i, const uint8_t *src, int src_width,
+                                   std::vector<uint8_t> &padded, int padded_width) {
+        if (!need_padding) {
+            rows[i] = const_cast<JSAMPROW>(src);
+            return;
+        }
+        uint8_t *dst = padded.data() + i * padded_width;
+        memcpy(dst, src, src_width);
+        memset(dst + src_width, src[src_width - 1], padded_width - src_width);
+        rows[i] = dst;
+    };
+
+    JSAMPROW y_rows[mcu_rows];
+    JSAMPROW u_rows[DCTSIZE];
+    JSAMPROW v_rows[DCTSIZE];
+    JSAMPARRAY planes[3] = {y_rows, u_rows, v_rows};
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+
     while (cinfo.next_scanline < cinfo.image_height) {
-        row_pointer[0] = &rgb_data[cinfo.next_scanline * row_stride];
-        jpeg_write_scanlines(&cinfo, row_pointer, 1);
+        int top = cinfo.next_scanline;
+        // the rows past the bottom edge repeat the last one.
+        for (int i = 0; i < mcu_rows; i++) {
+            int row = std::min(top + i, height - 1);
+            fill_row(y_rows, i, y_data + row * y_stride, width, padded_y, padded_width);
+        }
+        for (int i = 0; i < DCTSIZE; i++) {
+            int row = std::min(top / 2 + i, chroma_height - 1);
+            fill_row(u_rows, i, u_data + row * u_stride, chroma_width, padded_u, padded_width / 2);
+            fill_row(v_rows, i, v_data + row * v_stride, chroma_width, padded_v, padded_width / 2);
+        }
+        jpeg_write_raw_data(&cinfo, planes, mcu_rows);
     }
 
     jpeg_finish_compress(&cinfo);
     jpeg_destroy_compress(&cinfo);
-    free(rgb_data);
 
     jpegBuffer.start = std::unique_ptr<uint8_t, FreeDeleter>(data);
     jpegBuffer.length = size;
@@ -482,6 +441,47 @@ uint32_t Utils::GetVideoDuration(const std::string &filePath) {
     return durationInSeconds;
 }
 
+std::vector<Mp4Box> Utils::GetMp4Boxes(const std::string &file_path) {
+    std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return {};
+    }
+    uint64_t file_size = file.tellg();
+
+    std::vector<Mp4Box> boxes;
+    uint64_t offset = 0;
+    while (offset + 8 <= file_size) {
+        uint8_t header[16];
+        file.seekg(offset, std::ios::beg);
+        if (!file.read(reinterpret_cast<char *>(header), 8)) {
+            return {};
+        }
+
+        uint64_t size = (uint64_t)header[0] << 24 | header[1] << 16 | header[2] << 8 | header[3];
+        if (size == 1) {
+            // the 64-bit largesize follows the type.
+            if (!file.read(reinterpret_cast<char *>(header + 8), 8)) {
+                return {};
+            }
+            size = 0;
+            for (int i = 8; i < 16; ++i) {
+                size = size << 8 | header[i];
+            }
+        } else if (size == 0) {
+            // the last box runs to the end of the file.
+            size = file_size - offset;
+        }
+        if (size < 8 || size > file_size - offset) {
+            return {};
+        }
+
+        boxes.push_back({std::string(reinterpret_cast<char *>(header + 4), 4), offset, size});
+        offset += size;
+    }
+
+    return boxes;
+}
+
 timeval Utils::ToTimeval(uint64_t timestamp_ns) {
     timeval tv{};
     tv.tv_sec = timestamp_ns / 1000000000ULL;
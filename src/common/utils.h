@@ -20,6 +20,13 @@ struct Buffer {
     unsigned long length;
 };
 
+// a top-level box of an mp4 file, `size` includes its header.
+struct Mp4Box {
+    std::string type;
+    uint64_t offset;
+    uint64_t size;
+};
+
 class Utils {
   public:
     static std::string PrefixZero(int src, int digits);
@@ -31,18 +38,22 @@ class Utils {
     static std::string GetPreviousDate(const std::string &dateStr);
     static std::string FindSecondNewestFile(const std::string &path, const std::string &extension);
     static std::chrono::system_clock::time_point ParseDatetime(const std::string &datetime_str);
-    static std::string FindFilesFromDatetime(const std::string &root, const std::string &basename);
+    static std::string FindFilesFromDatetime(const std::string &root, const std::string &basename,
+                                             const std::string &extension = ".mp4");
     static std::vector<std::string> FindOlderFiles(const std::string &file_path, int request_num);
 
     static bool CreateFolder(const std::string &folder_path);
-    static void RotateFiles(const std::string &folder_path);
-    static bool CheckDriveSpace(const std::string &file_path, unsigned long min_free_byte);
     static Buffer ConvertYuvToJpeg(const uint8_t *yuv_data, int width, int height,
                                    int quality = 100);
+    static Buffer ConvertI420ToJpeg(const uint8_t *y_data, int y_stride, const uint8_t *u_data,
+                                    int u_stride, const uint8_t *v_data, int v_stride, int width,
+                                    int height, int quality = 100);
     static void CreateJpegImage(const uint8_t *yuv_data, int width, int height,
                                 const std::string &url, int quality);
     static void WriteJpegImage(Buffer buffer, const std::string &url);
     static uint32_t GetVideoDuration(const std::string &filePath);
+    // empty if the file is not a well-formed mp4.
+    static std::vector<Mp4Box> GetMp4Boxes(const std::string &file_path);
     static timeval ToTimeval(uint64_t timestamp_ns);
     static std::string GenerateUuid();
 };
@@ -55,7 +66,8 @@ class FileInfo {
     std::string extension;
 
   public:
-    FileInfo(const std::string &root, const std::string &extension = "mp4")
+    FileInfo(const std::string &root, const std::string &extension = "mp4",
+             const std::string &suffix = "")
         : root(root),
           extension(extension) {
         time_t now = time(0);
@@ -71,6 +83,7 @@ class FileInfo {
         std::stringstream filenameStream;
         filenameStream << year << month << day << "_" << hour << min << sec;
         filenameStream >> filename;
+        filename += suffix;
 
         date = year + month + day;
         this->hour = hour;
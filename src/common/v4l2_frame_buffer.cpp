@@ -26,6 +26,7 @@ V4L2FrameBuffer::V4L2FrameBuffer(int width, int height, uint32_t format, int siz
     : width_(width),
       height_(height),
       format_(format),
+      stride_(0),
       size_(size),
       flags_(flags),
       timestamp_(timestamp),
@@ -43,7 +44,11 @@ V4L2FrameBuffer::V4L2FrameBuffer(int width, int height, int size, uint32_t forma
     data_.reset(static_cast<uint8_t *>(webrtc::AlignedMalloc(size_, kBufferAlignment)));
 }
 
-V4L2FrameBuffer::~V4L2FrameBuffer() {}
+V4L2FrameBuffer::~V4L2FrameBuffer() {
+    if (on_release_) {
+        on_release_();
+    }
+}
 
 webrtc::VideoFrameBuffer::Type V4L2FrameBuffer::type() const { return Type::kNative; }
 
@@ -54,31 +59,40 @@ uint32_t V4L2FrameBuffer::size() const { return size_; }
 uint32_t V4L2FrameBuffer::flags() const { return flags_; }
 timeval V4L2FrameBuffer::timestamp() const { return timestamp_; }
 
+int V4L2FrameBuffer::stride() const {
+    if (stride_ > 0) {
+        return stride_;
+    }
+    return format_ == V4L2_PIX_FMT_YUYV ? width_ * 2 : width_;
+}
+
 rtc::scoped_refptr<webrtc::I420BufferInterface> V4L2FrameBuffer::ToI420() {
     rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer(webrtc::I420Buffer::Create(width_, height_));
     i420_buffer->InitializeData();
+    ToI420(i420_buffer.get());
+    return i420_buffer;
+}
 
+void V4L2FrameBuffer::ToI420(webrtc::I420Buffer *dst) {
     const uint8_t *src = static_cast<const uint8_t *>(Data());
 
     if (format_ == V4L2_PIX_FMT_YUV420) {
-        memcpy(i420_buffer->MutableDataY(), src, size_);
+        memcpy(dst->MutableDataY(), src, size_);
     } else {
 #if defined(USE_LIBARGUS_CAPTURE)
-        if (NvUtils::ConvertToI420(buffer_.dmafd, i420_buffer->MutableDataY(), size_, width_,
-                                   height_) < 0) {
+        if (NvUtils::ConvertToI420(buffer_.dmafd, dst->MutableDataY(), size_, width_, height_) <
+            0) {
             ERROR_PRINT("NvUtils ConvertToI420 Failed");
         }
 #else
-        if (libyuv::ConvertToI420(src, size_, i420_buffer->MutableDataY(), i420_buffer->StrideY(),
-                                  i420_buffer->MutableDataU(), i420_buffer->StrideU(),
-                                  i420_buffer->MutableDataV(), i420_buffer->StrideV(), 0, 0, width_,
-                                  height_, width_, height_, libyuv::kRotate0, format_) < 0) {
+        if (libyuv::ConvertToI420(src, size_, dst->MutableDataY(), dst->StrideY(),
+                                  dst->MutableDataU(), dst->StrideU(), dst->MutableDataV(),
+                                  dst->StrideV(), 0, 0, width_, height_, width_, height_,
+                                  libyuv::kRotate0, format_) < 0) {
             ERROR_PRINT("libyuv ConvertToI420 Failed");
         }
 #endif
     }
-
-    return i420_buffer;
 }
 
 V4L2Buffer V4L2FrameBuffer::GetRawBuffer() { return buffer_; }
@@ -104,14 +118,23 @@ void V4L2FrameBuffer::SetDmaFd(int fd) {
 
 void V4L2FrameBuffer::SetTimestamp(timeval timestamp) { timestamp_ = timestamp; }
 
+void V4L2FrameBuffer::SetStride(int stride) { stride_ = stride; }
+
+void V4L2FrameBuffer::SetReleaseCallback(std::function<void()> on_release) {
+    on_release_ = std::move(on_release);
+}
+
 rtc::scoped_refptr<V4L2FrameBuffer> V4L2FrameBuffer::Clone() const {
     auto clone = rtc::make_ref_counted<V4L2FrameBuffer>(width_, height_, size_, format_);
 
     memcpy(clone->MutableData(), Data(), size_);
 
     clone->SetDmaFd(buffer_.dmafd);
+    clone->stride_ = stride_;
     clone->flags_ = flags_;
     clone->timestamp_ = timestamp_;
+    // the capture sequence reveals the dropped frames downstream.
+    clone->buffer_.inner.sequence = buffer_.inner.sequence;
 
     return clone;
 }
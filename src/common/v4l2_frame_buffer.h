@@ -3,6 +3,7 @@
 
 #include "common/v4l2_utils.h"
 
+#include <functional>
 #include <linux/videodev2.h>
 #include <vector>
 
@@ -21,8 +22,12 @@ class V4L2FrameBuffer : public webrtc::VideoFrameBuffer {
     int width() const override;
     int height() const override;
     rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+    // convert into a buffer of the same size, e.g. one reused for every frame.
+    void ToI420(webrtc::I420Buffer *dst);
 
     uint32_t format() const;
+    // bytes per row of the first plane.
+    int stride() const;
     uint32_t size() const;
     uint32_t flags() const;
     timeval timestamp() const;
@@ -33,6 +38,10 @@ class V4L2FrameBuffer : public webrtc::VideoFrameBuffer {
     int GetDmaFd() const;
     void SetDmaFd(int fd);
     void SetTimestamp(timeval timestamp);
+    // 0 for rows packed without padding.
+    void SetStride(int stride);
+    // run once the last reference is gone, e.g. to return the buffer to its device.
+    void SetReleaseCallback(std::function<void()> on_release);
     rtc::scoped_refptr<V4L2FrameBuffer> Clone() const;
 
   protected:
@@ -44,11 +53,13 @@ class V4L2FrameBuffer : public webrtc::VideoFrameBuffer {
     const int width_;
     const int height_;
     const uint32_t format_;
+    int stride_;
     uint32_t size_;
     uint32_t flags_;
     timeval timestamp_;
     V4L2Buffer buffer_;
     std::unique_ptr<uint8_t, webrtc::AlignedFreeDeleter> data_;
+    std::function<void()> on_release_;
 
     V4L2FrameBuffer(int width, int height, uint32_t format, int size, uint32_t flags,
                     timeval timestamp);
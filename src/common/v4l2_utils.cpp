@@ -139,6 +139,21 @@ bool V4L2Util::SetFps(int fd, v4l2_buf_type type, uint32_t fps) {
     return true;
 }
 
+bool V4L2Util::SetCrop(int fd, v4l2_buf_type type, v4l2_rect rect) {
+    struct v4l2_selection selection = {};
+    // the selection api takes the single-planar type for the multi-planar queues as well.
+    selection.type = type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE ? V4L2_BUF_TYPE_VIDEO_OUTPUT
+                                                               : type;
+    selection.target = V4L2_SEL_TGT_CROP;
+    selection.r = rect;
+    if (ioctl(fd, VIDIOC_S_SELECTION, &selection) < 0) {
+        ERROR_PRINT("fd(%d) set crop(%d,%d %ux%u): %s", fd, rect.left, rect.top, rect.width,
+                    rect.height, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
 bool V4L2Util::SetFormat(int fd, V4L2BufferGroup *gbuffer, uint32_t width, uint32_t height,
                          uint32_t &pixel_format) {
     v4l2_format fmt = {};
@@ -167,6 +182,11 @@ bool V4L2Util::SetFormat(int fd, V4L2BufferGroup *gbuffer, uint32_t width, uint3
     // use the  return format
     pixel_format = fmt.fmt.pix_mp.pixelformat;
     gbuffer->num_planes = fmt.fmt.pix_mp.num_planes;
+    if (V4L2_TYPE_IS_MULTIPLANAR(fmt.type)) {
+        gbuffer->bytesperline = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+    } else {
+        gbuffer->bytesperline = fmt.fmt.pix.bytesperline;
+    }
 
     if (fmt.fmt.pix_mp.width != width || fmt.fmt.pix_mp.height != height) {
         ERROR_PRINT("fd(%d) input size (%dx%d) doesn't match driver's output size (%dx%d): %s", fd,
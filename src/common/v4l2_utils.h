@@ -49,6 +49,8 @@ struct V4L2BufferGroup {
     int fd = -1;
     uint32_t num_planes = 0;
     uint32_t num_buffers = 0;
+    // of the first plane, as the driver pads it.
+    uint32_t bytesperline = 0;
     bool has_dmafd = false;
     std::vector<V4L2Buffer> buffers;
     enum v4l2_buf_type type;
@@ -74,6 +76,7 @@ class V4L2Util {
     static bool SetFps(int fd, v4l2_buf_type type, uint32_t fps);
     static bool SetFormat(int fd, V4L2BufferGroup *gbuffer, uint32_t width, uint32_t height,
                           uint32_t &pixel_format);
+    static bool SetCrop(int fd, v4l2_buf_type type, v4l2_rect rect);
     static bool SetCtrl(int fd, uint32_t id, int32_t value);
     static bool SetExtCtrl(int fd, uint32_t id, int32_t value);
     static bool StreamOn(int fd, v4l2_buf_type type);
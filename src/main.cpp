@@ -1,6 +1,12 @@
+#include <chrono>
+#include <thread>
+
 #include "args.h"
+#include "codecs/v4l2/v4l2_codec.h"
 #include "common/logging.h"
+#include "common/metrics.h"
 #include "common/utils.h"
+#include "common/worker.h"
 #include "parser.h"
 #include "recorder/recorder_manager.h"
 #include "rtc/conductor.h"
@@ -13,6 +19,12 @@ int main(int argc, char *argv[]) {
     Args args;
     Parser::ParseArgs(argc, argv, args);
 
+    V4L2Codec::SetBufferCounts({
+        .decoder = args.decoder_buffers,
+        .encoder = args.encoder_buffers,
+        .scaler = args.scaler_buffers,
+    });
+
     std::shared_ptr<Conductor> conductor = Conductor::Create(args);
     std::unique_ptr<RecorderManager> recorder_mgr;
 
@@ -24,6 +36,15 @@ int main(int argc, char *argv[]) {
         DEBUG_PRINT("Recorder is not started!");
     }
 
+    std::unique_ptr<Worker> metrics_worker;
+    if (!args.metrics_path.empty()) {
+        metrics_worker = std::make_unique<Worker>("MetricsWriter", [args]() {
+            Metrics::Instance().WriteToFile(args.metrics_path);
+            std::this_thread::sleep_for(std::chrono::seconds(args.metrics_interval));
+        });
+        metrics_worker->Run();
+    }
+
     boost::asio::io_context ioc;
     auto work_guard = boost::asio::make_work_guard(ioc);
 
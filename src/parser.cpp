@@ -1,6 +1,7 @@
 #include "parser.h"
 #include "recorder/recorder_manager.h"
 #include "rtc/rtc_peer.h"
+#include "rtc/shared_video_encoder.h"
 
 #include <algorithm>
 #include <boost/program_options.hpp>
@@ -24,6 +25,18 @@ static const std::unordered_map<std::string, int> record_mode_table = {
     {"both", -1},
     {"video", RecordMode::Video},
     {"snapshot", RecordMode::Snapshot},
+    {"timelapse", RecordMode::Timelapse},
+};
+
+static const std::unordered_map<std::string, int> rate_policy_table = {
+    {"min", RatePolicy::MinRate},
+    {"max", RatePolicy::MaxRate},
+    {"median", RatePolicy::MedianRate},
+};
+
+static const std::unordered_map<std::string, int> vpx_content_table = {
+    {"camera", 0},
+    {"screen", 1},
 };
 
 static const std::unordered_map<std::string, int> ipc_mode_table = {
@@ -159,14 +172,48 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
 #endif
         ("record-mode", bpo::value<std::string>(&args.record)->default_value(args.record),
             "Recording mode: 'video' to record MP4 files, 'snapshot' to save periodic JPEG images, "
-            "or 'both' to do both simultaneously.")
+            "'both' to do both simultaneously, or 'timelapse' to record only the sampled frames.")
         ("record-path", bpo::value<std::string>(&args.record_path)->default_value(args.record_path),
             "Set the path where recording video files will be saved. "
             "If the value is empty or unavailable, the recorder will not start.")
         ("file-duration", bpo::value<int>(&args.file_duration)->default_value(args.file_duration),
             "The duration (in seconds) of each video file, or the interval between snapshots.")
+        ("record-bitrate", bpo::value<int>(&args.record_bitrate)->default_value(args.record_bitrate),
+            "The bitrate (in kbps) of the recorded video. 0 derives it from the resolution and fps.")
+        ("record-mjpeg", bpo::bool_switch(&args.record_mjpeg)->default_value(args.record_mjpeg),
+            "Record the frames of a `v4l2` camera in `mjpeg` format into Matroska (.mkv) as they are, "
+            "instead of re-encoding them to H264.")
+        ("record-mjpeg-decimation", bpo::value<int>(&args.record_mjpeg_decimation)->default_value(args.record_mjpeg_decimation),
+            "Keep one frame in every N when recording with `--record-mjpeg`.")
+        ("proxy-width", bpo::value<int>(&args.proxy_width)->default_value(args.proxy_width),
+            "Also record a low-resolution proxy of this width for quick remote review. "
+            "It uses the sub stream if the resolution matches, otherwise the recorded stream is "
+            "scaled down. 0 disables the proxy.")
+        ("proxy-height", bpo::value<int>(&args.proxy_height)->default_value(args.proxy_height),
+            "The frame height of the proxy recording.")
+        ("proxy-bitrate", bpo::value<int>(&args.proxy_bitrate)->default_value(args.proxy_bitrate),
+            "The bitrate (in kbps) of the proxy recording. 0 derives it from the resolution and fps.")
+        ("proxy-file-duration", bpo::value<int>(&args.proxy_file_duration)->default_value(args.proxy_file_duration),
+            "The duration (in seconds) of each proxy file. 0 uses the same as `file-duration`.")
+        ("timelapse-interval", bpo::value<int>(&args.timelapse_interval)->default_value(args.timelapse_interval),
+            "The minimum interval (in milliseconds) between the frames of a timelapse recording.")
+        ("timelapse-fps", bpo::value<int>(&args.timelapse_fps)->default_value(args.timelapse_fps),
+            "The playback frames per second of a timelapse recording.")
+        ("timelapse-motion", bpo::value<float>(&args.timelapse_motion)->default_value(args.timelapse_motion),
+            "Record a timelapse frame only if this fraction (0.0 to 1.0) of the scene changed. "
+            "0 disables the motion detection. Works with i420, nv12 and yuyv frames.")
+        ("max-record-size", bpo::value<int>(&args.max_record_size)->default_value(args.max_record_size),
+            "The maximum total size (in MiB) of the recordings, the oldest files are deleted "
+            "beyond it. 0 means unlimited.")
+        ("max-record-age", bpo::value<int>(&args.max_record_age)->default_value(args.max_record_age),
+            "Delete the recordings older than this age (in hours). 0 means unlimited.")
+        ("min-free-space", bpo::value<int>(&args.min_free_space)->default_value(args.min_free_space),
+            "The minimum free space (in MiB) to keep on the recording drive.")
         ("jpeg-quality", bpo::value<int>(&args.jpeg_quality)->default_value(args.jpeg_quality),
             "Set the quality of the snapshot and thumbnail images in range 0 to 100.")
+        ("thumbnail-width", bpo::value<int>(&args.thumbnail_width)->default_value(args.thumbnail_width),
+            "The width of the snapshot and thumbnail images, the height keeps the aspect ratio. "
+            "0 uses the width of the recorded stream.")
         ("peer-timeout", bpo::value<int>(&args.peer_timeout)->default_value(args.peer_timeout),
             "The connection timeout (in seconds) after receiving a remote offer")
         ("hw-accel", bpo::bool_switch(&args.hw_accel)->default_value(args.hw_accel),
@@ -175,10 +222,62 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
         ("no-adaptive", bpo::bool_switch(&args.no_adaptive)->default_value(args.no_adaptive),
             "Disable WebRTC's adaptive resolution scaling. When enabled, "
             "the output resolution will remain fixed regardless of network or device conditions.")
+        ("shared-encoder", bpo::bool_switch(&args.shared_encoder)->default_value(args.shared_encoder),
+            "Encode the live stream once for all viewers with the same codec and resolution, "
+            "instead of one encoder per peer connection.")
+        ("shared-rate", bpo::value<std::string>(&args.shared_rate)->default_value(args.shared_rate),
+            "How a shared encoder picks its bitrate among the viewers' estimates: "
+            "'min' for the weakest link, 'max' for the best, or 'median'.")
+        ("simulcast-layers", bpo::value<int>(&args.simulcast_layers)->default_value(args.simulcast_layers),
+            "The number of simulcast layers (1 to 3) published to the SFU, each at half the "
+            "resolution of the one above. With `--hw-accel`, every layer has its own hardware encoder.")
+        ("h264-passthrough", bpo::bool_switch(&args.h264_passthrough)->default_value(args.h264_passthrough),
+            "Send the H264 stream of a `v4l2` camera in `h264` format without decoding and "
+            "re-encoding it. The bitrate and keyframe requests are forwarded to the camera, "
+            "so use it with `--shared-encoder` when there are several viewers.")
+        ("keyframe-merge-window", bpo::value<int>(&args.keyframe_merge_window)->default_value(args.keyframe_merge_window),
+            "The keyframe requests arriving within this time (in milliseconds) after a keyframe "
+            "are answered by it instead of forcing another one.")
+        ("keyframe-min-interval", bpo::value<int>(&args.keyframe_min_interval)->default_value(args.keyframe_min_interval),
+            "The minimum interval (in milliseconds) between two forced keyframes of an encoder, "
+            "the requests in between are served together once it passes.")
+        ("intra-refresh-period", bpo::value<int>(&args.intra_refresh_period)->default_value(args.intra_refresh_period),
+            "Refresh the picture of the hardware H264 encoder gradually over this many frames "
+            "instead of sending periodic keyframes, and heal the packet losses reported by the "
+            "viewers by restarting the refresh, with a keyframe if they still report it a period "
+            "later. Keyframes are otherwise only sent to the new viewers. Not supported with "
+            "simulcast or `--h264-passthrough`. 0 disables it.")
+        ("decoder-buffers", bpo::value<int>(&args.decoder_buffers)->default_value(args.decoder_buffers),
+            "The number of buffers (2 to 16) queued in the V4L2 hardware decoder. Raise it if the "
+            "`v4l2_codec_starved_frames_total` metric of the device keeps growing.")
+        ("encoder-buffers", bpo::value<int>(&args.encoder_buffers)->default_value(args.encoder_buffers),
+            "The number of buffers (2 to 16) queued in each V4L2 hardware encoder.")
+        ("scaler-buffers", bpo::value<int>(&args.scaler_buffers)->default_value(args.scaler_buffers),
+            "The number of buffers (2 to 16) queued in each V4L2 hardware scaler.")
+        ("vp8-cpu-speed", bpo::value<int>(&args.vp8_cpu_speed)->default_value(args.vp8_cpu_speed),
+            "The speed (4 to 16) of the software VP8 encoder on arm, higher is faster at a lower "
+            "quality. 0 keeps WebRTC's default.")
+        ("vp9-speed", bpo::value<int>(&args.vp9_speed)->default_value(args.vp9_speed),
+            "The speed (5 to 9) of the software VP9 encoder, higher is faster at a lower quality. "
+            "0 keeps WebRTC's default.")
+        ("vpx-threads", bpo::value<int>(&args.vpx_threads)->default_value(args.vpx_threads),
+            "The cores the software VP8/VP9 encoders may use, 0 for all of them.")
+        ("vpx-no-denoise", bpo::bool_switch(&args.vpx_no_denoise)->default_value(args.vpx_no_denoise),
+            "Disable the denoiser of the software VP8/VP9 encoders, it costs a lot of CPU.")
+        ("vpx-content", bpo::value<std::string>(&args.vpx_content)->default_value(args.vpx_content),
+            "The content the software VP8/VP9 encoders are tuned for: camera or screen.")
         ("enable-ipc", bpo::bool_switch(&args.enable_ipc)->default_value(args.enable_ipc),
             "Enable IPC relay using a WebRTC DataChannel, lossy (UDP-like) or reliable (TCP-like) based on client preference.")
         ("ipc-channel",  bpo::value<std::string>(&args.ipc_channel)->default_value(args.ipc_channel),
             "IPC channel mode: both, lossy, reliable")
+        ("enable-roi", bpo::bool_switch(&args.enable_roi)->default_value(args.enable_roi),
+            "Accept region-of-interest messages, e.g. from an object detector, through the IPC "
+            "socket or the lossy DataChannel, and give those regions more bits in the hardware "
+            "encoder. Requires `--enable-ipc` and the Jetson hardware encoder.")
+        ("publish-encoder-stats", bpo::bool_switch(&args.publish_encoder_stats)->default_value(args.publish_encoder_stats),
+            "Write the per-second statistics of every encoder (fps, bitrate, frame sizes, "
+            "keyframe ratio, encode time and QP) to the IPC socket as `encoder_stats` messages. "
+            "They are in the metrics either way. Requires `--enable-ipc`.")
         ("socket-path", bpo::value<std::string>(&args.socket_path)->default_value(args.socket_path),
             "Specifies the Unix domain socket path used to bridge messages between "
             "the WebRTC DataChannel and local IPC applications.")
@@ -225,12 +324,20 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
             "Car ID from ArcadeRally backend.")
         ("car-api-key", bpo::value<std::string>(&args.car_api_key)->default_value(args.car_api_key),
             "Car API key (car_xxx...).")
+        ("metrics-path", bpo::value<std::string>(&args.metrics_path)->default_value(args.metrics_path),
+            "Periodically write runtime metrics in Prometheus text format into this file. "
+            "Disabled if the value is empty.")
+        ("metrics-interval", bpo::value<int>(&args.metrics_interval)->default_value(args.metrics_interval),
+            "The interval (in seconds) between writes of the metrics file.")
         ("enable-uart-control", bpo::bool_switch(&args.enable_uart_control)->default_value(args.enable_uart_control),
             "Enable UART control communication for RC car.")
         ("uart-device", bpo::value<std::string>(&args.uart_device)->default_value(args.uart_device),
             "UART device path (e.g., /dev/ttyS0).")
         ("uart-baud", bpo::value<int>(&args.uart_baud)->default_value(args.uart_baud),
-            "UART baud rate.");
+            "UART baud rate.")
+        ("control-deadman-ms", bpo::value<int>(&args.control_deadman_ms)->default_value(args.control_deadman_ms),
+            "Put the car back to neutral if no control command arrives within this time (ms). "
+            "Disabled if the value is 0.");
     // clang-format on
 
     bpo::variables_map vm;
@@ -325,11 +432,81 @@ void Parser::ParseArgs(int argc, char *argv[], Args &args) {
 #endif
 
     args.jpeg_quality = std::clamp(args.jpeg_quality, 0, 100);
+    args.metrics_interval = std::max(args.metrics_interval, 1);
+    args.max_record_size = std::max(args.max_record_size, 0);
+    args.max_record_age = std::max(args.max_record_age, 0);
+    args.min_free_space = std::max(args.min_free_space, 0);
+    args.timelapse_interval = std::max(args.timelapse_interval, 0);
+    args.timelapse_fps = std::clamp(args.timelapse_fps, 1, 60);
+    args.timelapse_motion = std::clamp(args.timelapse_motion, 0.0f, 1.0f);
+    args.record_bitrate = std::max(args.record_bitrate, 0);
+    args.record_mjpeg_decimation = std::max(args.record_mjpeg_decimation, 1);
+    args.thumbnail_width = std::max(args.thumbnail_width, 0);
+    args.simulcast_layers = std::clamp(args.simulcast_layers, 1, 3);
+    args.keyframe_merge_window = std::max(args.keyframe_merge_window, 0);
+    args.keyframe_min_interval = std::max(args.keyframe_min_interval, 0);
+    args.intra_refresh_period = std::max(args.intra_refresh_period, 0);
+    if (args.intra_refresh_period > 0) {
+#if defined(USE_RPI_HW_ENCODER)
+        bool has_intra_refresh =
+            args.hw_accel && args.simulcast_layers == 1 && !args.h264_passthrough;
+#else
+        bool has_intra_refresh = false;
+#endif
+        if (!has_intra_refresh) {
+            std::cout << "Intra refresh is only supported by the single-stream hardware H264 "
+                         "encoder, `--intra-refresh-period` is ignored."
+                      << std::endl;
+            args.intra_refresh_period = 0;
+        }
+    }
+    if (args.enable_roi) {
+#if defined(USE_JETSON_HW_ENCODER)
+        bool has_roi = args.hw_accel && !args.h264_passthrough;
+#else
+        bool has_roi = false;
+#endif
+        if (!has_roi) {
+            std::cout << "Regions of interest are only supported by the Jetson hardware encoder, "
+                         "`--enable-roi` is ignored."
+                      << std::endl;
+            args.enable_roi = false;
+        }
+    }
+    args.decoder_buffers = std::clamp(args.decoder_buffers, 2, 16);
+    args.encoder_buffers = std::clamp(args.encoder_buffers, 2, 16);
+    args.scaler_buffers = std::clamp(args.scaler_buffers, 2, 16);
+    args.vp8_cpu_speed = args.vp8_cpu_speed > 0 ? std::clamp(args.vp8_cpu_speed, 4, 16) : 0;
+    args.vp9_speed = args.vp9_speed > 0 ? std::clamp(args.vp9_speed, 5, 9) : 0;
+    args.vpx_threads = std::max(args.vpx_threads, 0);
+    args.proxy_bitrate = std::max(args.proxy_bitrate, 0);
+    args.proxy_file_duration = std::max(args.proxy_file_duration, 0);
+    if (args.proxy_width > 0 && args.proxy_height > 0) {
+        // the encoders need even dimensions.
+        args.proxy_width = std::min(args.proxy_width, args.width) & ~1;
+        args.proxy_height = std::min(args.proxy_height, args.height) & ~1;
+    } else {
+        args.proxy_width = 0;
+        args.proxy_height = 0;
+    }
 
     args.record_mode = ParseEnum(record_mode_table, args.record);
     args.ipc_channel_mode = ParseEnum(ipc_mode_table, args.ipc_channel);
+    args.shared_rate_policy = ParseEnum(rate_policy_table, args.shared_rate);
+    args.vpx_screen_content = ParseEnum(vpx_content_table, args.vpx_content) == 1;
 
     ParseDevice(args);
+
+    if (args.h264_passthrough) {
+        if (args.format != V4L2_PIX_FMT_H264) {
+            throw std::runtime_error("H264 passthrough requires a v4l2 camera in h264 format.");
+        }
+        // the compressed frames can't be rescaled.
+        args.no_adaptive = true;
+    }
+    if (args.record_mjpeg && args.format != V4L2_PIX_FMT_MJPEG) {
+        throw std::runtime_error("MJPEG recording requires a v4l2 camera in mjpeg format.");
+    }
 }
 
 void Parser::ParseDevice(Args &args) {
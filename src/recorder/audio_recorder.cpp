@@ -1,5 +1,156 @@
 #include "recorder/audio_recorder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 #include "common/logging.h"
+#include "common/metrics.h"
+
+// Correct at once when the capture clock and the written samples are apart this far.
+const int MAX_DRIFT_MS = 40;
+// Otherwise insert or remove a single sample per buffer beyond this tolerance.
+const int DRIFT_TOLERANCE_MS = 2;
+
+static void DeinterleaveStereo(const float *src, float *left, float *right, int nb_samples) {
+    int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 4 <= nb_samples; i += 4) {
+        float32x4x2_t lr = vld2q_f32(src + 2 * i);
+        vst1q_f32(left + i, lr.val[0]);
+        vst1q_f32(right + i, lr.val[1]);
+    }
+#elif defined(__SSE__)
+    for (; i + 4 <= nb_samples; i += 4) {
+        __m128 a = _mm_loadu_ps(src + 2 * i);     // L0 R0 L1 R1
+        __m128 b = _mm_loadu_ps(src + 2 * i + 4); // L2 R2 L3 R3
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+    for (; i < nb_samples; ++i) {
+        left[i] = src[2 * i];
+        right[i] = src[2 * i + 1];
+    }
+}
+
+void ThreadSafeAudioFifo::alloc(int channels, int capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    planes_.assign(channels, std::vector<float>(capacity));
+    capacity_ = capacity;
+    read_pos_ = 0;
+    size_ = 0;
+}
+
+int ThreadSafeAudioFifo::write(const float *interleaved, int nb_samples, int src_channels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0 || nb_samples <= 0) {
+        return 0;
+    }
+
+    if (nb_samples > capacity_) {
+        interleaved += (nb_samples - capacity_) * src_channels;
+        nb_samples = capacity_;
+    }
+
+    // drop the oldest samples if the encoder falls behind.
+    int overflow = size_ + nb_samples - capacity_;
+    if (overflow > 0) {
+        read_pos_ = (read_pos_ + overflow) % capacity_;
+        size_ -= overflow;
+    }
+
+    int write_pos = (read_pos_ + size_) % capacity_;
+    int first = std::min(nb_samples, capacity_ - write_pos);
+    deinterleave(interleaved, src_channels, write_pos, first);
+    deinterleave(interleaved + first * src_channels, src_channels, 0, nb_samples - first);
+    size_ += nb_samples;
+
+    return nb_samples;
+}
+
+int ThreadSafeAudioFifo::write_silence(int nb_samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (capacity_ == 0 || nb_samples <= 0) {
+        return 0;
+    }
+
+    nb_samples = std::min(nb_samples, capacity_);
+    int overflow = size_ + nb_samples - capacity_;
+    if (overflow > 0) {
+        read_pos_ = (read_pos_ + overflow) % capacity_;
+        size_ -= overflow;
+    }
+
+    int write_pos = (read_pos_ + size_) % capacity_;
+    int first = std::min(nb_samples, capacity_ - write_pos);
+    for (auto &plane : planes_) {
+        std::fill_n(plane.begin() + write_pos, first, 0.0f);
+        std::fill_n(plane.begin(), nb_samples - first, 0.0f);
+    }
+    size_ += nb_samples;
+
+    return nb_samples;
+}
+
+int ThreadSafeAudioFifo::read(uint8_t **data, int nb_samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_ < nb_samples) {
+        return 0;
+    }
+
+    int first = std::min(nb_samples, capacity_ - read_pos_);
+    for (size_t ch = 0; ch < planes_.size(); ++ch) {
+        auto dst = reinterpret_cast<float *>(data[ch]);
+        memcpy(dst, planes_[ch].data() + read_pos_, first * sizeof(float));
+        memcpy(dst + first, planes_[ch].data(), (nb_samples - first) * sizeof(float));
+    }
+    read_pos_ = (read_pos_ + nb_samples) % capacity_;
+    size_ -= nb_samples;
+
+    return nb_samples;
+}
+
+int ThreadSafeAudioFifo::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+void ThreadSafeAudioFifo::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    read_pos_ = 0;
+    size_ = 0;
+}
+
+void ThreadSafeAudioFifo::deinterleave(const float *src, int src_channels, int offset,
+                                       int nb_samples) {
+    if (nb_samples <= 0) {
+        return;
+    }
+
+    int channels = planes_.size();
+    if (channels == 2 && src_channels == 2) {
+        DeinterleaveStereo(src, planes_[0].data() + offset, planes_[1].data() + offset,
+                           nb_samples);
+        return;
+    }
+
+    for (int ch = 0; ch < channels; ++ch) {
+        // duplicate the last source channel if the source has fewer channels, e.g. mono.
+        const float *in = src + std::min(ch, src_channels - 1);
+        float *out = planes_[ch].data() + offset;
+        for (int i = 0; i < nb_samples; ++i) {
+            out[i] = *in;
+            in += src_channels;
+        }
+    }
+}
 
 std::unique_ptr<AudioRecorder> AudioRecorder::Create(int sample_rate) {
     auto ptr = std::make_unique<AudioRecorder>(sample_rate);
@@ -12,9 +163,19 @@ AudioRecorder::AudioRecorder(int sample_rate)
       sample_rate(sample_rate),
       channels(2),
       sample_fmt(AV_SAMPLE_FMT_FLTP),
-      encoder_name("aac") {}
+      encoder_name("aac"),
+      frame(nullptr),
+      pkt(av_packet_alloc()),
+      timeline_started_(false),
+      written_samples_(0),
+      clock_offset_(0),
+      smoothed_drift_(0.0) {}
 
-AudioRecorder::~AudioRecorder() {}
+AudioRecorder::~AudioRecorder() {
+    Stop();
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+}
 
 void AudioRecorder::InitializeEncoderCtx(AVCodecContext *&encoder) {
     const AVCodec *codec = avcodec_find_encoder_by_name(encoder_name.c_str());
@@ -38,6 +199,7 @@ void AudioRecorder::InitializeEncoderCtx(AVCodecContext *&encoder) {
 }
 
 void AudioRecorder::InitializeFrame() {
+    av_frame_free(&frame);
     frame = av_frame_alloc();
     frame_size = encoder->frame_size;
     if (frame != nullptr) {
@@ -56,10 +218,15 @@ void AudioRecorder::InitializeFrame() {
     av_frame_make_writable(frame);
 }
 
-void AudioRecorder::InitializeFifoBuffer() { fifo_buffer.alloc(sample_fmt, channels, 1); }
+void AudioRecorder::InitializeFifoBuffer() {
+    // one second of samples is far more than the encoder ever lags behind.
+    fifo_buffer.alloc(channels, sample_rate);
+}
 
 void AudioRecorder::Encode() {
-    if (fifo_buffer.read((void **)&frame->data, frame_size) < 0) {
+    // the encoder may still hold a reference to the previous frame.
+    if (av_frame_make_writable(frame) < 0 ||
+        fifo_buffer.read(frame->data, frame_size) < frame_size) {
         DEBUG_PRINT("Failed to read audio data in fifo.");
         return;
     }
@@ -73,7 +240,6 @@ void AudioRecorder::Encode() {
         return;
     }
 
-    AVPacket *pkt = av_packet_alloc();
     while (ret >= 0) {
         ret = avcodec_receive_packet(encoder, pkt);
         if (ret == AVERROR(EAGAIN)) {
@@ -84,45 +250,93 @@ void AudioRecorder::Encode() {
         }
 
         pkt->stream_index = st->index;
-        pkt->pts = av_rescale_q(pkt->pts, encoder->time_base, st->time_base);
-        pkt->dts = av_rescale_q(pkt->dts, encoder->time_base, st->time_base);
-        pkt->duration = av_rescale_q(pkt->duration, encoder->time_base, st->time_base);
-
-        OnPacketed(pkt);
+        OnPacketed(pkt, encoder->time_base);
+        av_packet_unref(pkt);
     }
-    av_packet_unref(pkt);
-    av_packet_free(&pkt);
 }
 
 void AudioRecorder::OnBuffer(PaBuffer buffer) {
-    uint8_t **converted_input_samples = nullptr;
     int samples_per_channel = buffer.length / buffer.channels;
+    auto data = reinterpret_cast<const float *>(buffer.start);
 
-    if (av_samples_alloc_array_and_samples(&converted_input_samples, nullptr, channels,
-                                           samples_per_channel, sample_fmt, 0) < 0) {
-        // Handle allocation error
+    std::lock_guard<std::mutex> lock(timeline_mtx_);
+    AlignToTimeline(data, samples_per_channel, buffer.channels, buffer.timestamp);
+    if (samples_per_channel <= 0) {
         return;
     }
 
-    auto data = reinterpret_cast<float *>(buffer.start);
-    for (int i = 0; i < buffer.length; ++i) {
-        int channel_index = i % buffer.channels;
-        if (channel_index < channels) {
-            reinterpret_cast<float *>(converted_input_samples[channel_index])[i / buffer.channels] =
-                data[i];
-        }
+    if (fifo_buffer.write(data, samples_per_channel, buffer.channels) < samples_per_channel) {
+        DEBUG_PRINT("Failed to write audio data into fifo buffer.");
     }
+    written_samples_ += samples_per_channel;
+}
 
-    if (fifo_buffer.write(reinterpret_cast<void **>(converted_input_samples), samples_per_channel) <
-        samples_per_channel) {
-        DEBUG_PRINT("Failed to write audio data into fifo buffer.");
+/**
+ * Compare where the buffer should start on the segment timeline, according to
+ * its capture time, with the number of samples written so far. Silence fills
+ * the gaps and early samples are dropped, so the audio pts derived from the
+ * sample count stays on the same clock as the video pts.
+ */
+void AudioRecorder::AlignToTimeline(const float *&data, int &nb_samples, int src_channels,
+                                    timeval timestamp) {
+    int64_t expected = (ToMicroseconds(timestamp) - base_time_us) * sample_rate / 1000000;
+
+    if (!timeline_started_) {
+        clock_offset_ = 0;
+        if (std::abs(expected) > sample_rate) {
+            WARN_PRINT("Audio and video capture clocks differ, fall back to sample counting.");
+            clock_offset_ = expected;
+        }
+        expected -= clock_offset_;
+
+        if (expected + nb_samples <= 0) {
+            // captured before the segment started.
+            nb_samples = 0;
+            return;
+        }
+        if (expected < 0) {
+            data += -expected * src_channels;
+            nb_samples += expected;
+        } else {
+            fifo_buffer.write_silence(expected);
+        }
+        written_samples_ = std::max<int64_t>(expected, 0);
+        smoothed_drift_ = 0.0;
+        timeline_started_ = true;
+        return;
     }
 
-    if (converted_input_samples) {
-        av_freep(&converted_input_samples[0]);
-        av_freep(&converted_input_samples);
-        converted_input_samples = nullptr;
+    int64_t drift = expected - clock_offset_ - written_samples_;
+    int64_t max_drift = sample_rate * MAX_DRIFT_MS / 1000;
+    int64_t tolerance = sample_rate * DRIFT_TOLERANCE_MS / 1000;
+
+    if (drift > max_drift) {
+        // samples are lost, e.g. an overrun in the capturer.
+        written_samples_ += fifo_buffer.write_silence(drift);
+        smoothed_drift_ = 0.0;
+        Metrics::Instance().Increment("recorder_audio_drift_corrections_total");
+        DEBUG_PRINT("Insert %ld silent samples to catch up the capture clock.", (long)drift);
+    } else if (drift < -max_drift) {
+        int drop = std::min<int64_t>(-drift, nb_samples);
+        data += drop * src_channels;
+        nb_samples -= drop;
+        smoothed_drift_ = 0.0;
+        Metrics::Instance().Increment("recorder_audio_drift_corrections_total");
+        DEBUG_PRINT("Drop %d samples ahead of the capture clock.", drop);
+    } else {
+        // the timestamps jitter, so only follow the slow clock drift.
+        smoothed_drift_ = 0.95 * smoothed_drift_ + 0.05 * drift;
+        if (smoothed_drift_ > tolerance) {
+            written_samples_ += fifo_buffer.write(data, 1, src_channels);
+            smoothed_drift_ -= 1.0;
+        } else if (smoothed_drift_ < -tolerance && nb_samples > 1) {
+            data += src_channels;
+            nb_samples -= 1;
+            smoothed_drift_ += 1.0;
+        }
     }
+
+    Metrics::Instance().Set("recorder_audio_drift_ms", smoothed_drift_ * 1000.0 / sample_rate);
 }
 
 bool AudioRecorder::ConsumeBuffer() {
@@ -135,6 +349,9 @@ bool AudioRecorder::ConsumeBuffer() {
 }
 
 void AudioRecorder::OnStart() {
+    std::lock_guard<std::mutex> lock(timeline_mtx_);
     frame_count = 0;
+    timeline_started_ = false;
+    written_samples_ = 0;
     fifo_buffer.reset();
 }
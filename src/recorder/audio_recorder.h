@@ -3,52 +3,40 @@
 
 #include <condition_variable>
 #include <mutex>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
-#include <libavutil/audio_fifo.h>
 }
 
 #include "capturer/pa_capturer.h"
 #include "common/logging.h"
 #include "recorder/recorder.h"
 
+/**
+ * A planar float ring buffer. The interleaved capture samples are deinterleaved
+ * straight into the preallocated planes, so no allocation happens per buffer.
+ */
 class ThreadSafeAudioFifo {
   public:
-    void alloc(enum AVSampleFormat sample_fmt, int channels, int nb_samples) {
-        fifo_ = av_audio_fifo_alloc(sample_fmt, channels, nb_samples);
-        if (fifo_ == nullptr) {
-            DEBUG_PRINT("Failed to initialize audio fifo buffer.");
-        }
-    }
-
-    int write(void **data, int nb_samples) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return av_audio_fifo_write(fifo_, data, nb_samples);
-    }
-
-    int read(void **data, int nb_samples) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (av_audio_fifo_size(fifo_) < nb_samples) {
-            return 0;
-        }
-        return av_audio_fifo_read(fifo_, data, nb_samples);
-    }
-
-    int size() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return av_audio_fifo_size(fifo_);
-    }
-
-    void reset() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        av_audio_fifo_reset(fifo_);
-    }
+    void alloc(int channels, int capacity);
+    // Return the number of samples per channel written.
+    int write(const float *interleaved, int nb_samples, int src_channels);
+    int write_silence(int nb_samples);
+    // Return the number of samples per channel read, 0 if not enough samples.
+    int read(uint8_t **data, int nb_samples);
+    int size();
+    void reset();
 
   private:
-    AVAudioFifo *fifo_;
+    int capacity_ = 0;
+    int read_pos_ = 0;
+    int size_ = 0;
+    std::vector<std::vector<float>> planes_;
     std::mutex mutex_;
+
+    void deinterleave(const float *src, int src_channels, int offset, int nb_samples);
 };
 
 class AudioRecorder : public Recorder<PaBuffer> {
@@ -64,12 +52,21 @@ class AudioRecorder : public Recorder<PaBuffer> {
     int channels = 2;
     int frame_size;
     uint64_t frame_count;
+    std::mutex timeline_mtx_;
+    bool timeline_started_;
+    // samples per channel written into the fifo since the base time.
+    int64_t written_samples_;
+    // non-zero if the audio and video clocks are unrelated.
+    int64_t clock_offset_;
+    double smoothed_drift_;
     std::string encoder_name;
     ThreadSafeAudioFifo fifo_buffer;
     AVSampleFormat sample_fmt;
     AVFrame *frame;
+    AVPacket *pkt;
 
     void Encode();
+    void AlignToTimeline(const float *&data, int &nb_samples, int src_channels, timeval timestamp);
     void InitializeFrame();
     void InitializeFifoBuffer();
     void InitializeEncoderCtx(AVCodecContext *&encoder) override;
@@ -0,0 +1,159 @@
+#include "recorder/disk_writer.h"
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+#include "common/logging.h"
+#include "common/metrics.h"
+
+// About 8 seconds of 30fps video and 48kHz AAC packets.
+const size_t MAX_QUEUE_SIZE = 600;
+
+std::unique_ptr<DiskWriter> DiskWriter::Create(CloseFunc close_func) {
+    auto ptr = std::make_unique<DiskWriter>(close_func, MAX_QUEUE_SIZE);
+    ptr->worker_ = std::make_unique<Worker>("DiskWriter", [ptr = ptr.get()]() {
+        ptr->ProcessTask();
+    });
+    ptr->worker_->Run();
+    return ptr;
+}
+
+DiskWriter::DiskWriter(CloseFunc close_func, size_t max_queue_size)
+    : close_func_(close_func),
+      max_queue_size_(max_queue_size) {}
+
+DiskWriter::~DiskWriter() {
+    worker_.reset();
+
+    // flush the remaining packets and trailers before leaving.
+    std::lock_guard<std::mutex> lock(queue_mtx_);
+    while (!queue_.empty()) {
+        Execute(queue_.front());
+        queue_.pop_front();
+    }
+}
+
+bool DiskWriter::Write(AVFormatContext *fmt_ctx, AVPacket *pkt, AVRational time_base) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx_);
+        auto stream = std::make_pair(fmt_ctx, pkt->stream_index);
+        bool is_dropping = dropping_streams_.count(stream) > 0;
+        if (queue_.size() >= max_queue_size_ || (is_dropping && !(pkt->flags & AV_PKT_FLAG_KEY))) {
+            if (!is_dropping) {
+                DEBUG_PRINT("Disk writer drops stream %d until the next keyframe.",
+                            pkt->stream_index);
+                dropping_streams_.insert(stream);
+            }
+            Metrics::Instance().Increment("recorder_disk_dropped_packets_total");
+            return false;
+        }
+        dropping_streams_.erase(stream);
+    }
+
+    // The packet data may point to an encoder buffer, so keep a reference-counted copy.
+    AVPacket *ref = av_packet_alloc();
+    if (av_packet_ref(ref, pkt) < 0) {
+        av_packet_free(&ref);
+        return false;
+    }
+
+    Push({fmt_ctx, ref, time_base});
+    return true;
+}
+
+void DiskWriter::Close(AVFormatContext *fmt_ctx) {
+    if (!fmt_ctx) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx_);
+        auto it = dropping_streams_.lower_bound({fmt_ctx, INT_MIN});
+        while (it != dropping_streams_.end() && it->first == fmt_ctx) {
+            it = dropping_streams_.erase(it);
+        }
+    }
+    Push({fmt_ctx, nullptr, {}});
+}
+
+void DiskWriter::Push(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mtx_);
+        queue_.push_back(task);
+        Metrics::Instance().Set("recorder_disk_queue_depth", queue_.size());
+    }
+    queue_cv_.notify_one();
+}
+
+void DiskWriter::ProcessTask() {
+    Task task;
+    {
+        std::unique_lock<std::mutex> lock(queue_mtx_);
+        if (!queue_cv_.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+                return !queue_.empty();
+            })) {
+            return;
+        }
+        task = queue_.front();
+        queue_.pop_front();
+        Metrics::Instance().Set("recorder_disk_queue_depth", queue_.size());
+    }
+
+    Execute(task);
+}
+
+void DiskWriter::Execute(Task &task) {
+    auto fmt_ctx = task.fmt_ctx;
+
+    if (task.pkt == nullptr) {
+        if (header_written_.erase(fmt_ctx) > 0) {
+            av_write_trailer(fmt_ctx);
+        }
+        close_func_(fmt_ctx);
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if ((header_written_.count(fmt_ctx) || WriteHeader(fmt_ctx, task.pkt)) &&
+        fmt_ctx->nb_streams > task.pkt->stream_index) {
+        // the header may have changed the stream's time base, it is final only now.
+        av_packet_rescale_ts(task.pkt, task.time_base,
+                             fmt_ctx->streams[task.pkt->stream_index]->time_base);
+        int ret = av_interleaved_write_frame(fmt_ctx, task.pkt);
+        if (ret < 0) {
+            char err_buf[AV_ERROR_MAX_STRING_SIZE];
+            av_strerror(ret, err_buf, sizeof(err_buf));
+            ERROR_PRINT("Failed to write frame: %s", err_buf);
+        }
+    }
+    av_packet_free(&task.pkt);
+
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                             start);
+    Metrics::Instance().Observe("recorder_disk_write_latency_ms", elapsed.count());
+}
+
+bool DiskWriter::WriteHeader(AVFormatContext *fmt_ctx, AVPacket *pkt) {
+    if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+        return false;
+    }
+
+    AVCodecParameters *codecpar = fmt_ctx->streams[pkt->stream_index]->codecpar;
+
+    if (codecpar->codec_id == AV_CODEC_ID_AV1) {
+        av_free(codecpar->extradata);
+        codecpar->extradata = (uint8_t *)av_malloc(pkt->size + AV_INPUT_BUFFER_PADDING_SIZE);
+        memcpy(codecpar->extradata, pkt->data, pkt->size);
+        memset(codecpar->extradata + pkt->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        codecpar->extradata_size = pkt->size;
+    }
+
+    if (avformat_write_header(fmt_ctx, nullptr) < 0) {
+        ERROR_PRINT("Error writing header");
+        return false;
+    }
+
+    header_written_.insert(fmt_ctx);
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef DISK_WRITER_H_
+#define DISK_WRITER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <unordered_set>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include "common/worker.h"
+
+/**
+ * Mux and write packets on a dedicated thread, so a slow storage never
+ * blocks the encoder threads which deliver the packets.
+ */
+class DiskWriter {
+  public:
+    using CloseFunc = std::function<void(AVFormatContext *fmt_ctx)>;
+
+    static std::unique_ptr<DiskWriter> Create(CloseFunc close_func);
+
+    DiskWriter(CloseFunc close_func, size_t max_queue_size);
+    ~DiskWriter();
+
+    // Return false if the packet is dropped. Once the queue overflows, the packets of the stream
+    // are dropped until its next keyframe, so the file never has a GOP with a hole.
+    // The timestamps of `pkt` are in `time_base` and rescaled after the header is written.
+    bool Write(AVFormatContext *fmt_ctx, AVPacket *pkt, AVRational time_base);
+    // Write the trailer after all queued packets of the context, then release it by `close_func`.
+    void Close(AVFormatContext *fmt_ctx);
+
+  private:
+    struct Task {
+        AVFormatContext *fmt_ctx;
+        // nullptr means closing the context.
+        AVPacket *pkt;
+        AVRational time_base;
+    };
+
+    CloseFunc close_func_;
+    const size_t max_queue_size_;
+    std::mutex queue_mtx_;
+    std::condition_variable queue_cv_;
+    std::deque<Task> queue_;
+    // the streams waiting for a keyframe after an overflow.
+    std::set<std::pair<AVFormatContext *, int>> dropping_streams_;
+    std::unordered_set<AVFormatContext *> header_written_;
+    std::unique_ptr<Worker> worker_;
+
+    void Push(Task task);
+    void ProcessTask();
+    void Execute(Task &task);
+    bool WriteHeader(AVFormatContext *fmt_ctx, AVPacket *pkt);
+};
+
+#endif // DISK_WRITER_H_
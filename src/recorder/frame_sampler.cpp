@@ -0,0 +1,91 @@
+#include "recorder/frame_sampler.h"
+
+#include <cstdlib>
+
+const int GRID_COLS = 32;
+const int GRID_ROWS = 18;
+// A cell is changed if its mean luma moves more than this.
+const int LUMA_DIFF_THRESHOLD = 20;
+
+FrameSampler::FrameSampler(int interval_ms, float motion_threshold)
+    : interval_us_((int64_t)interval_ms * 1000),
+      motion_threshold_(motion_threshold),
+      last_pick_us_(-1) {}
+
+void FrameSampler::Reset() {
+    last_pick_us_ = -1;
+    last_grid_.clear();
+}
+
+bool FrameSampler::Pick(const V4L2FrameBufferRef &frame_buffer) {
+    auto timestamp = frame_buffer->timestamp();
+    int64_t now_us = (int64_t)timestamp.tv_sec * 1000000 + timestamp.tv_usec;
+
+    if (last_pick_us_ >= 0 && now_us - last_pick_us_ < interval_us_) {
+        return false;
+    }
+
+    if (motion_threshold_ > 0.0f && SampleLumaGrid(frame_buffer, grid_)) {
+        // the first frame of a segment is always picked.
+        if (!last_grid_.empty() && MotionScore() < motion_threshold_) {
+            return false;
+        }
+        last_grid_.swap(grid_);
+    }
+
+    last_pick_us_ = now_us;
+    return true;
+}
+
+bool FrameSampler::SampleLumaGrid(const V4L2FrameBufferRef &frame_buffer,
+                                  std::vector<uint8_t> &grid) {
+    // the luma is the first plane of the planar formats, or every other byte of YUYV.
+    int step;
+    switch (frame_buffer->format()) {
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_NV12:
+            step = 1;
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            step = 2;
+            break;
+        default:
+            return false;
+    }
+
+    auto data = static_cast<const uint8_t *>(frame_buffer->Data());
+    int width = frame_buffer->width();
+    int height = frame_buffer->height();
+    // the rows may be padded beyond the visible width.
+    int stride = frame_buffer->stride();
+    if (data == nullptr || width < GRID_COLS * 2 || height < GRID_ROWS * 2 ||
+        stride < width * step || frame_buffer->size() < (uint32_t)(stride * height)) {
+        return false;
+    }
+
+    int cell_width = width / GRID_COLS;
+    int cell_height = height / GRID_ROWS;
+    grid.resize(GRID_COLS * GRID_ROWS);
+
+    // average 2x2 pixels around each cell center to suppress the sensor noise.
+    for (int row = 0; row < GRID_ROWS; ++row) {
+        int y = row * cell_height + cell_height / 2;
+        for (int col = 0; col < GRID_COLS; ++col) {
+            int x = col * cell_width + cell_width / 2;
+            const uint8_t *p = data + y * stride + x * step;
+            grid[row * GRID_COLS + col] = (p[0] + p[step] + p[stride] + p[stride + step] + 2) / 4;
+        }
+    }
+
+    return true;
+}
+
+float FrameSampler::MotionScore() const {
+    int changed = 0;
+    for (size_t i = 0; i < grid_.size(); ++i) {
+        if (std::abs(grid_[i] - last_grid_[i]) > LUMA_DIFF_THRESHOLD) {
+            changed++;
+        }
+    }
+    return (float)changed / grid_.size();
+}
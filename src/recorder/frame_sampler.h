@@ -0,0 +1,32 @@
+#ifndef FRAME_SAMPLER_H_
+#define FRAME_SAMPLER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "common/v4l2_frame_buffer.h"
+
+/**
+ * Pick the frames for a reduced-rate recording, either one per interval or
+ * only when the scene changed. It reads a coarse luma grid straight from the
+ * captured buffer, so the skipped frames are never copied or converted.
+ */
+class FrameSampler {
+  public:
+    FrameSampler(int interval_ms, float motion_threshold);
+
+    void Reset();
+    bool Pick(const V4L2FrameBufferRef &frame_buffer);
+
+  private:
+    int64_t interval_us_;
+    float motion_threshold_;
+    int64_t last_pick_us_;
+    std::vector<uint8_t> grid_;
+    std::vector<uint8_t> last_grid_;
+
+    bool SampleLumaGrid(const V4L2FrameBufferRef &frame_buffer, std::vector<uint8_t> &grid);
+    float MotionScore() const;
+};
+
+#endif // FRAME_SAMPLER_H_
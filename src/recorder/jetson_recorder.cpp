@@ -3,12 +3,14 @@
 
 const float bpp_factor = 0.06f;
 
-std::unique_ptr<JetsonRecorder> JetsonRecorder::Create(int width, int height, int fps) {
-    return std::make_unique<JetsonRecorder>(width, height, fps);
+std::unique_ptr<JetsonRecorder> JetsonRecorder::Create(int width, int height, int fps,
+                                                       int bitrate) {
+    return std::make_unique<JetsonRecorder>(width, height, fps, bitrate);
 }
 
-JetsonRecorder::JetsonRecorder(int width, int height, int fps)
-    : VideoRecorder(width, height, fps, AV_CODEC_ID_AV1) {}
+JetsonRecorder::JetsonRecorder(int width, int height, int fps, int bitrate)
+    : VideoRecorder(width, height, fps, AV_CODEC_ID_AV1),
+      bitrate_(bitrate > 0 ? bitrate : static_cast<int>(width * height * fps * bpp_factor)) {}
 
 void JetsonRecorder::Encode(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) {
     if (!encoder_) {
@@ -18,7 +20,7 @@ void JetsonRecorder::Encode(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) {
             .is_dma_src = true,
             .dst_pix_fmt = V4L2_PIX_FMT_AV1,
             .fps = fps,
-            .bitrate = static_cast<int>(width * height * fps * bpp_factor),
+            .bitrate = bitrate_,
             .i_interval = 0,
             .idr_interval = fps,
             .rc_mode = V4L2_MPEG_VIDEO_BITRATE_MODE_VBR,
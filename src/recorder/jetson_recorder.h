@@ -6,14 +6,15 @@
 
 class JetsonRecorder : public VideoRecorder {
   public:
-    static std::unique_ptr<JetsonRecorder> Create(int width, int height, int fps);
-    JetsonRecorder(int width, int height, int fps);
+    static std::unique_ptr<JetsonRecorder> Create(int width, int height, int fps, int bitrate = 0);
+    JetsonRecorder(int width, int height, int fps, int bitrate);
 
   protected:
     void ReleaseEncoder() override;
     void Encode(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) override;
 
   private:
+    int bitrate_;
     std::unique_ptr<JetsonEncoder> encoder_;
 };
 
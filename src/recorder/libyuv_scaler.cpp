@@ -0,0 +1,101 @@
+#include "recorder/libyuv_scaler.h"
+
+#include <cstring>
+
+#include <third_party/libyuv/include/libyuv.h>
+
+#include "common/logging.h"
+#include "common/metrics.h"
+
+std::unique_ptr<LibyuvScaler> LibyuvScaler::Create(int dst_width, int dst_height) {
+    auto scaler = std::make_unique<LibyuvScaler>(dst_width, dst_height);
+    scaler->Start();
+    return scaler;
+}
+
+LibyuvScaler::LibyuvScaler(int dst_width, int dst_height)
+    : dst_width_(dst_width),
+      dst_height_(dst_height),
+      num_buffer_(2),
+      abort_(false),
+      src_buffers_(num_buffer_),
+      dst_buffer_(V4L2FrameBuffer::Create(dst_width, dst_height, dst_width * dst_height * 3 / 2,
+                                          V4L2_PIX_FMT_YUV420)),
+      free_buffers_(num_buffer_),
+      scaling_tasks_(num_buffer_) {
+    for (int i = 0; i < num_buffer_; ++i) {
+        free_buffers_.push(i);
+    }
+}
+
+LibyuvScaler::~LibyuvScaler() {
+    abort_ = true;
+    worker_.reset();
+    DEBUG_PRINT("~LibyuvScaler");
+}
+
+void LibyuvScaler::Start() {
+    worker_ = std::make_unique<Worker>("LibyuvScaler", [this]() {
+        ScaleBuffer();
+    });
+    worker_->Run();
+}
+
+bool LibyuvScaler::EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
+                                 std::function<void(V4L2FrameBufferRef)> on_capture) {
+    if (abort_) {
+        return false;
+    }
+
+    auto item = free_buffers_.pop();
+    if (!item) {
+        Metrics::Instance().Increment("recorder_scaler_dropped_total");
+        return false;
+    }
+
+    int index = item.value();
+    auto &src = src_buffers_[index];
+    if (!src || src->size() != frame_buffer->size() || src->format() != frame_buffer->format() ||
+        src->width() != frame_buffer->width() || src->height() != frame_buffer->height()) {
+        src = V4L2FrameBuffer::Create(frame_buffer->width(), frame_buffer->height(),
+                                      frame_buffer->size(), frame_buffer->format());
+    }
+    memcpy(src->MutableData(), frame_buffer->Data(), frame_buffer->size());
+    src->SetStride(frame_buffer->stride());
+    src->SetDmaFd(frame_buffer->GetDmaFd());
+    src->SetTimestamp(frame_buffer->timestamp());
+
+    scaling_tasks_.push({index, std::move(on_capture)});
+    return true;
+}
+
+void LibyuvScaler::ScaleBuffer() {
+    auto task = scaling_tasks_.pop(1);
+    if (!task) {
+        return;
+    }
+
+    auto src = src_buffers_[task->index];
+    if (!i420_buffer_ || i420_buffer_->width() != src->width() ||
+        i420_buffer_->height() != src->height()) {
+        i420_buffer_ = webrtc::I420Buffer::Create(src->width(), src->height());
+        i420_buffer_->InitializeData();
+    }
+    src->ToI420(i420_buffer_.get());
+    timeval timestamp = src->timestamp();
+    free_buffers_.push(task->index);
+
+    int y_size = dst_width_ * dst_height_;
+    int chroma_stride = dst_width_ / 2;
+    uint8_t *dst_y = dst_buffer_->MutableData();
+    uint8_t *dst_u = dst_y + y_size;
+    uint8_t *dst_v = dst_u + y_size / 4;
+    libyuv::I420Scale(i420_buffer_->DataY(), i420_buffer_->StrideY(), i420_buffer_->DataU(),
+                      i420_buffer_->StrideU(), i420_buffer_->DataV(), i420_buffer_->StrideV(),
+                      i420_buffer_->width(), i420_buffer_->height(), dst_y, dst_width_, dst_u,
+                      chroma_stride, dst_v, chroma_stride, dst_width_, dst_height_,
+                      libyuv::kFilterBox);
+    dst_buffer_->SetTimestamp(timestamp);
+
+    task->on_capture(dst_buffer_);
+}
@@ -0,0 +1,54 @@
+#ifndef LIBYUV_SCALER_H_
+#define LIBYUV_SCALER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <api/video/i420_buffer.h>
+
+#include "common/interface/processor.h"
+#include "common/thread_safe_queue.h"
+#include "common/v4l2_frame_buffer.h"
+#include "common/worker.h"
+
+/**
+ * Scale the captured frames down to I420 in software, on its own thread. The
+ * captured frame is only copied into one of a few reused buffers before the
+ * capturer requeues it, the conversion and scaling run later. The scaled frame
+ * is reused too, so it is valid only during the callback.
+ */
+class LibyuvScaler : public IFrameProcessor {
+  public:
+    static std::unique_ptr<LibyuvScaler> Create(int dst_width, int dst_height);
+
+    LibyuvScaler(int dst_width, int dst_height);
+    ~LibyuvScaler() override;
+
+    bool EmplaceBuffer(V4L2FrameBufferRef frame_buffer,
+                       std::function<void(V4L2FrameBufferRef)> on_capture) override;
+
+  private:
+    struct ScaleTask {
+        int index;
+        std::function<void(V4L2FrameBufferRef)> on_capture;
+    };
+
+    int dst_width_;
+    int dst_height_;
+    int num_buffer_;
+    std::atomic<bool> abort_;
+    std::unique_ptr<Worker> worker_;
+    // owned by whoever holds the index, either a free slot or a queued task.
+    std::vector<V4L2FrameBufferRef> src_buffers_;
+    rtc::scoped_refptr<webrtc::I420Buffer> i420_buffer_;
+    V4L2FrameBufferRef dst_buffer_;
+    ThreadSafeQueue<int> free_buffers_;
+    ThreadSafeQueue<ScaleTask> scaling_tasks_;
+
+    void Start();
+    void ScaleBuffer();
+};
+
+#endif // LIBYUV_SCALER_H_
@@ -1,20 +1,24 @@
 #include "recorder/openh264_recorder.h"
 
-std::unique_ptr<Openh264Recorder> Openh264Recorder::Create(int width, int height, int fps) {
-    return std::make_unique<Openh264Recorder>(width, height, fps);
+std::unique_ptr<Openh264Recorder> Openh264Recorder::Create(int width, int height, int fps,
+                                                           int bitrate) {
+    return std::make_unique<Openh264Recorder>(width, height, fps, bitrate);
 }
 
-Openh264Recorder::Openh264Recorder(int width, int height, int fps)
-    : VideoRecorder(width, height, fps, AV_CODEC_ID_H264) {}
+Openh264Recorder::Openh264Recorder(int width, int height, int fps, int bitrate)
+    : VideoRecorder(width, height, fps, AV_CODEC_ID_H264),
+      bitrate_(bitrate) {}
 
 void Openh264Recorder::Encode(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) {
     if (!encoder_) {
-        encoder_ = Openh264Encoder::Create(width, height, fps);
+        encoder_ = Openh264Encoder::Create(width, height, fps, bitrate_);
     }
 
     auto i420_buffer = frame_buffer->ToI420();
-    encoder_->Encode(i420_buffer, [this, frame_buffer](uint8_t *encoded_buffer, int size) {
-        OnEncoded(encoded_buffer, size, frame_buffer->timestamp());
+    encoder_->Encode(i420_buffer, [this, frame_buffer](uint8_t *encoded_buffer, int size,
+                                                       bool is_keyframe) {
+        OnEncoded(encoded_buffer, size, frame_buffer->timestamp(),
+                  is_keyframe ? V4L2_BUF_FLAG_KEYFRAME : 0);
     });
 }
 
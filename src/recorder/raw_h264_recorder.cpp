@@ -18,6 +18,7 @@ RawH264Recorder::RawH264Recorder(int width, int height, int fps)
 RawH264Recorder::~RawH264Recorder() {}
 
 void RawH264Recorder::OnStart() {
+    VideoRecorder::OnStart();
     has_sps_ = false;
     has_pps_ = false;
     has_first_keyframe_ = false;
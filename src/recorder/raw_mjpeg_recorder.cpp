@@ -0,0 +1,40 @@
+#include "recorder/raw_mjpeg_recorder.h"
+#include "common/logging.h"
+
+#include <algorithm>
+
+std::unique_ptr<RawMjpegRecorder> RawMjpegRecorder::Create(int width, int height, int fps,
+                                                           int decimation) {
+    return std::make_unique<RawMjpegRecorder>(width, height, fps, decimation);
+}
+
+RawMjpegRecorder::RawMjpegRecorder(int width, int height, int fps, int decimation)
+    : VideoRecorder(width, height, std::max(fps / std::max(decimation, 1), 1), AV_CODEC_ID_MJPEG),
+      decimation_(std::max(decimation, 1)),
+      frame_count_(0) {}
+
+RawMjpegRecorder::~RawMjpegRecorder() {}
+
+void RawMjpegRecorder::OnBuffer(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) {
+    // drop before the base class copies the frame.
+    if (frame_count_++ % decimation_ != 0) {
+        return;
+    }
+    VideoRecorder::OnBuffer(frame_buffer);
+}
+
+void RawMjpegRecorder::OnStart() {
+    VideoRecorder::OnStart();
+    frame_count_ = 0;
+}
+
+void RawMjpegRecorder::ReleaseEncoder() {}
+
+void RawMjpegRecorder::Encode(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) {
+    if (frame_buffer->format() != V4L2_PIX_FMT_MJPEG) {
+        ERROR_PRINT("Expected an mjpeg frame, got the format %u", frame_buffer->format());
+        return;
+    }
+    OnEncoded((uint8_t *)frame_buffer->Data(), frame_buffer->size(), frame_buffer->timestamp(),
+              V4L2_BUF_FLAG_KEYFRAME);
+}
@@ -0,0 +1,28 @@
+#ifndef RAW_MJPEG_RECORDER_H_
+#define RAW_MJPEG_RECORDER_H_
+
+#include "recorder/video_recorder.h"
+
+/**
+ * Mux the MJPEG frames of the camera as they are. Every frame is a keyframe,
+ * so keeping one frame in `decimation` still leaves a seekable recording.
+ */
+class RawMjpegRecorder : public VideoRecorder {
+  public:
+    static std::unique_ptr<RawMjpegRecorder> Create(int width, int height, int fps,
+                                                    int decimation = 1);
+    RawMjpegRecorder(int width, int height, int fps, int decimation);
+    ~RawMjpegRecorder();
+    void OnBuffer(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) override;
+    void OnStart() override;
+
+  protected:
+    void ReleaseEncoder() override;
+    void Encode(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) override;
+
+  private:
+    int decimation_;
+    int64_t frame_count_;
+};
+
+#endif // RAW_MJPEG_RECORDER_H_
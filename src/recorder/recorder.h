@@ -1,8 +1,10 @@
 #ifndef RECORDER_H_
 #define RECORDER_H_
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <sys/time.h>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -14,7 +16,8 @@ extern "C" {
 
 template <typename T> class Recorder {
   public:
-    using OnPacketedFunc = std::function<void(AVPacket *pkt)>;
+    // the timestamps are in `time_base`, the muxer rescales them once the header fixed its own.
+    using OnPacketedFunc = std::function<void(AVPacket *pkt, AVRational time_base)>;
 
     Recorder() = default;
     ~Recorder() { Stop(); };
@@ -37,6 +40,9 @@ template <typename T> class Recorder {
 
     void OnPacketed(OnPacketedFunc fn) { on_packeted = fn; }
 
+    // All recorders of a segment share the same zero on the capture clock.
+    void SetBaseTime(timeval base_time) { base_time_us = ToMicroseconds(base_time); }
+
     void Stop() {
         worker.reset();
         avcodec_free_context(&encoder);
@@ -56,12 +62,17 @@ template <typename T> class Recorder {
     std::unique_ptr<Worker> worker;
     AVCodecContext *encoder;
     AVStream *st;
+    std::atomic<int64_t> base_time_us{0};
+
+    static int64_t ToMicroseconds(timeval tv) {
+        return (int64_t)tv.tv_sec * 1000000LL + (int64_t)tv.tv_usec;
+    }
 
     virtual void InitializeEncoderCtx(AVCodecContext *&encoder) = 0;
     virtual bool ConsumeBuffer() = 0;
-    void OnPacketed(AVPacket *pkt) {
+    void OnPacketed(AVPacket *pkt, AVRational time_base) {
         if (on_packeted) {
-            on_packeted(pkt);
+            on_packeted(pkt, time_base);
         }
     }
 };
@@ -1,56 +1,148 @@
 #include "recorder/recorder_manager.h"
 
 #include <chrono>
+#include <cerrno>
 #include <condition_variable>
 #include <csignal>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
-#include <future>
 #include <mutex>
-#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "common/logging.h"
+#include "common/metrics.h"
 #include "common/utils.h"
 #include "common/v4l2_frame_buffer.h"
 #include "recorder/openh264_recorder.h"
 #include "recorder/raw_h264_recorder.h"
+#include "recorder/raw_mjpeg_recorder.h"
 #if defined(USE_RPI_HW_ENCODER)
 #include "recorder/v4l2_h264_recorder.h"
 #elif defined(USE_JETSON_HW_ENCODER)
 #include "recorder/jetson_recorder.h"
 #endif
 
-const int ROTATION_PERIOD = 60;
-const unsigned long MIN_FREE_BYTE = 400 * 1024 * 1024;
 const char *CONTAINER_FORMAT = "mp4";
+const char *PASSTHROUGH_CONTAINER_FORMAT = "matroska";
+const char *PASSTHROUGH_EXTENSION = "mkv";
 const char *PREVIEW_IMAGE_EXTENSION = ".jpg";
+const char *PROXY_SUFFIX = "_proxy";
+// Batch the small muxer writes into large sequential writes to the card.
+const int IO_BUFFER_SIZE = 1024 * 1024;
+const int64_t SYNC_BYTES = 8 * 1024 * 1024;
+const int SYNC_INTERVAL_MS = 2000;
+
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+using IoBuffer = const uint8_t *;
+#else
+using IoBuffer = uint8_t *;
+#endif
+
+struct FileSink {
+    int fd;
+    int64_t unsynced_bytes;
+    std::chrono::steady_clock::time_point last_sync_time;
+};
+
+static void SyncFile(FileSink *sink) {
+    auto start = std::chrono::steady_clock::now();
+    if (fdatasync(sink->fd) < 0) {
+        ERROR_PRINT("fdatasync failed: %s", strerror(errno));
+    }
+    auto now = std::chrono::steady_clock::now();
+    Metrics::Instance().Observe("recorder_disk_sync_latency_ms",
+                                std::chrono::duration<double, std::milli>(now - start).count());
+    sink->unsynced_bytes = 0;
+    sink->last_sync_time = now;
+}
+
+static int WriteFile(void *opaque, IoBuffer buf, int buf_size) {
+    auto sink = static_cast<FileSink *>(opaque);
+    int written = 0;
+    while (written < buf_size) {
+        ssize_t ret = write(sink->fd, buf + written, buf_size - written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return AVERROR(errno);
+        }
+        written += ret;
+    }
+
+    sink->unsynced_bytes += written;
+    if (sink->unsynced_bytes >= SYNC_BYTES ||
+        std::chrono::steady_clock::now() - sink->last_sync_time >=
+            std::chrono::milliseconds(SYNC_INTERVAL_MS)) {
+        SyncFile(sink);
+    }
+
+    return written;
+}
 
-AVFormatContext *RecUtil::CreateContainer(const std::string &full_path) {
+static int64_t SeekFile(void *opaque, int64_t offset, int whence) {
+    auto sink = static_cast<FileSink *>(opaque);
+    if (whence == AVSEEK_SIZE) {
+        struct stat st;
+        if (fstat(sink->fd, &st) < 0) {
+            return AVERROR(errno);
+        }
+        return st.st_size;
+    }
+
+    off_t ret = lseek(sink->fd, offset, whence & ~AVSEEK_FORCE);
+    return ret < 0 ? AVERROR(errno) : ret;
+}
+
+AVFormatContext *RecUtil::CreateContainer(const std::string &full_path, const char *format) {
     AVFormatContext *fmt_ctx = nullptr;
 
-    if (avformat_alloc_output_context2(&fmt_ctx, nullptr, CONTAINER_FORMAT, full_path.c_str()) <
-        0) {
+    if (avformat_alloc_output_context2(&fmt_ctx, nullptr, format, full_path.c_str()) < 0) {
         ERROR_PRINT("Could not alloc output context");
         return nullptr;
     }
 
-    if (!(fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-        if (avio_open(&fmt_ctx->pb, full_path.c_str(), AVIO_FLAG_WRITE) < 0) {
-            ERROR_PRINT("Could not open %s", full_path.c_str());
-            return nullptr;
-        }
+    int fd = open(full_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ERROR_PRINT("Could not open %s", full_path.c_str());
+        avformat_free_context(fmt_ctx);
+        return nullptr;
     }
 
+    auto buffer = static_cast<uint8_t *>(av_malloc(IO_BUFFER_SIZE));
+    auto sink = new FileSink{fd, 0, std::chrono::steady_clock::now()};
+    fmt_ctx->pb = avio_alloc_context(buffer, IO_BUFFER_SIZE, 1, sink, nullptr, WriteFile, SeekFile);
+    if (buffer == nullptr || fmt_ctx->pb == nullptr) {
+        ERROR_PRINT("Could not alloc io context for %s", full_path.c_str());
+        av_free(buffer);
+        close(fd);
+        delete sink;
+        avformat_free_context(fmt_ctx);
+        return nullptr;
+    }
+    fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
     return fmt_ctx;
 }
 
 void RecUtil::CloseContext(AVFormatContext *fmt_ctx) {
-    if (fmt_ctx) {
-        av_write_trailer(fmt_ctx);
-        if (!(fmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-            avio_closep(&fmt_ctx->pb);
-        }
-        avformat_free_context(fmt_ctx);
+    if (!fmt_ctx) {
+        return;
+    }
+
+    if (fmt_ctx->pb) {
+        avio_flush(fmt_ctx->pb);
+        auto sink = static_cast<FileSink *>(fmt_ctx->pb->opaque);
+        av_freep(&fmt_ctx->pb->buffer);
+        avio_context_free(&fmt_ctx->pb);
+
+        SyncFile(sink);
+        close(sink->fd);
+        delete sink;
     }
+    avformat_free_context(fmt_ctx);
 }
 
 std::unique_ptr<RecorderManager> RecorderManager::Create(std::shared_ptr<VideoCapturer> video_src,
@@ -59,51 +151,105 @@ std::unique_ptr<RecorderManager> RecorderManager::Create(std::shared_ptr<VideoCa
     auto instance = std::make_unique<RecorderManager>(config);
 
     if (video_src) {
-        instance->CreateVideoRecorder(video_src);
-        instance->SubscribeVideoSource(video_src);
+        instance->CreateOutputs(video_src);
+        for (auto &output : instance->outputs) {
+            instance->CreateVideoRecorder(output.get());
+            instance->SubscribeVideoSource(output.get());
+        }
     }
     if (audio_src) {
         instance->CreateAudioRecorder(audio_src);
         instance->SubscribeAudioSource(audio_src);
     }
 
-    instance->worker_ = std::make_unique<Worker>("rotation_worker", [config]() {
-        DEBUG_PRINT("Rotate files.");
-        while (!Utils::CheckDriveSpace(config.record_path, MIN_FREE_BYTE)) {
-            Utils::RotateFiles(config.record_path);
-        }
-        std::this_thread::sleep_for(std::chrono::seconds(ROTATION_PERIOD));
-    });
-    instance->worker_->Run();
-
     return instance;
 }
 
-void RecorderManager::CreateVideoRecorder(std::shared_ptr<VideoCapturer> capturer) {
+void RecorderManager::CreateOutputs(std::shared_ptr<VideoCapturer> capturer) {
     video_src_ = capturer;
     fps = capturer->fps();
-    width = capturer->width(config.record_stream_idx);
-    height = capturer->height(config.record_stream_idx);
-    video_recorder = ([this, capturer]() -> std::unique_ptr<VideoRecorder> {
+
+    int src_width = capturer->width(config.record_stream_idx);
+    int src_height = capturer->height(config.record_stream_idx);
+    outputs.push_back(std::make_unique<RecordOutput>(RecordOutput{
+        .stream_idx = config.record_stream_idx,
+        .width = src_width,
+        .height = src_height,
+        .bitrate = config.record_bitrate * 1000,
+        .file_duration = config.file_duration,
+        .suffix = "",
+        .scaling = false,
+        .passthrough = config.record_mjpeg && capturer->format() == V4L2_PIX_FMT_MJPEG,
+    }));
+
+    if (config.proxy_width <= 0 || config.record_mode == RecordMode::Snapshot) {
+        return;
+    }
+    if (capturer->format() == V4L2_PIX_FMT_H264) {
+        WARN_PRINT("Proxy recording is not supported for h264 cameras.");
+        return;
+    }
+
+    // bind the proxy to the native sub stream if it has the same size, or scale the main one.
+    bool is_sub_stream = capturer->has_sub_stream() && capturer->width(1) == config.proxy_width &&
+                         capturer->height(1) == config.proxy_height;
+    outputs.push_back(std::make_unique<RecordOutput>(RecordOutput{
+        .stream_idx = is_sub_stream ? 1 : config.record_stream_idx,
+        .width = config.proxy_width,
+        .height = config.proxy_height,
+        .bitrate = config.proxy_bitrate * 1000,
+        .file_duration =
+            config.proxy_file_duration > 0 ? config.proxy_file_duration : config.file_duration,
+        .suffix = PROXY_SUFFIX,
+        .scaling = !is_sub_stream &&
+                   (config.proxy_width != src_width || config.proxy_height != src_height),
+        .passthrough = false,
+    }));
+    INFO_PRINT("Record a %dx%d proxy from stream %d%s.", config.proxy_width, config.proxy_height,
+               outputs.back()->stream_idx, outputs.back()->scaling ? " with scaling" : "");
+}
+
+void RecorderManager::CreateVideoRecorder(RecordOutput *output) {
+    auto capturer = video_src_;
+    bool is_timelapse = config.record_mode == RecordMode::Timelapse;
+    if (is_timelapse && capturer->format() == V4L2_PIX_FMT_H264) {
+        WARN_PRINT("Timelapse is not supported for h264 cameras, record the full stream instead.");
+        is_timelapse = false;
+    }
+
+    output->video_recorder = ([this, capturer, output,
+                               is_timelapse]() -> std::unique_ptr<VideoRecorder> {
         if (config.record_mode == RecordMode::Snapshot) {
             return nullptr;
         }
-        if (capturer->format() == V4L2_PIX_FMT_H264) {
+        int width = output->width;
+        int height = output->height;
+        int record_fps = is_timelapse ? config.timelapse_fps : fps;
+        if (output->passthrough) {
+            return RawMjpegRecorder::Create(width, height, record_fps,
+                                            config.record_mjpeg_decimation);
+        } else if (capturer->format() == V4L2_PIX_FMT_H264) {
             return RawH264Recorder::Create(width, height, fps);
         } else if (config.hw_accel) {
 #if defined(USE_RPI_HW_ENCODER)
-            return V4L2H264Recorder::Create(width, height, fps);
+            return V4L2H264Recorder::Create(width, height, record_fps, output->bitrate);
 #elif defined(USE_JETSON_HW_ENCODER)
-            return JetsonRecorder::Create(width, height, fps);
+            return JetsonRecorder::Create(width, height, record_fps, output->bitrate);
 #endif
         }
-        return Openh264Recorder::Create(width, height, fps);
+        return Openh264Recorder::Create(width, height, record_fps, output->bitrate);
     })();
+
+    if (output->video_recorder && is_timelapse) {
+        output->video_recorder->SetFrameSampler(
+            std::make_unique<FrameSampler>(config.timelapse_interval, config.timelapse_motion));
+    }
 }
 
 void RecorderManager::CreateAudioRecorder(std::shared_ptr<PaCapturer> capturer) {
     audio_recorder = ([this, capturer]() -> std::unique_ptr<AudioRecorder> {
-        if (config.record_mode == RecordMode::Snapshot) {
+        if (config.record_mode == RecordMode::Snapshot ||
+            config.record_mode == RecordMode::Timelapse) {
             return nullptr;
         } else {
             return AudioRecorder::Create(capturer->config().sample_rate);
@@ -113,177 +259,205 @@ void RecorderManager::CreateAudioRecorder(std::shared_ptr<PaCapturer> capturer)
 
 RecorderManager::RecorderManager(Args config)
     : config(config),
-      fmt_ctx(nullptr),
-      has_first_keyframe(false),
       record_path(config.record_path),
-      elapsed_time_(0.0) {}
-
-void RecorderManager::SubscribeVideoSource(std::shared_ptr<VideoCapturer> video_src) {
-    video_subscription_ = video_src->Subscribe(
-        [this](V4L2FrameBufferRef buffer) {
-            // waiting first keyframe to start recorders.
-            if (!has_first_keyframe && ((buffer->flags() & V4L2_BUF_FLAG_KEYFRAME) ||
-                                        video_src_->format() != V4L2_PIX_FMT_H264)) {
-                Start();
-                last_created_time_ = buffer->timestamp();
-            }
+      retention_(RetentionManager::Create(
+          config.record_path, {.max_total_bytes = (uint64_t)config.max_record_size << 20,
+                               .max_age_sec = config.max_record_age * 3600,
+                               .min_free_bytes = (uint64_t)config.min_free_space << 20})),
+      disk_writer_(DiskWriter::Create(RecUtil::CloseContext)),
+      thumbnail_writer_(config.record_mode != RecordMode::Video
+                            ? ThumbnailWriter::Create(config.thumbnail_width, config.jpeg_quality,
+                                                      config.hw_accel)
+                            : nullptr) {}
+
+void RecorderManager::SubscribeVideoSource(RecordOutput *output) {
+    auto on_frame = [this, output](V4L2FrameBufferRef buffer) {
+        if (output->scaling) {
+            ScaleFrame(output, buffer);
+        } else {
+            OnVideoFrame(output, buffer);
+        }
+    };
+    output->subscription = output->passthrough
+                               ? video_src_->SubscribeCompressed(on_frame)
+                               : video_src_->Subscribe(on_frame, output->stream_idx);
+
+    if (output->video_recorder) {
+        output->video_recorder->OnPacketed([this, output](AVPacket *pkt, AVRational time_base) {
+            this->WriteIntoFile(output, pkt, time_base);
+        });
+    }
+}
 
-            // restart to write in the new file.
-            if (elapsed_time_ >= config.file_duration) {
-                last_created_time_ = buffer->timestamp();
-                Stop();
-                Start();
-            }
+void RecorderManager::OnVideoFrame(RecordOutput *output, V4L2FrameBufferRef buffer) {
+    // waiting first keyframe to start recorders.
+    if (!output->has_first_keyframe && IsKeyFrame(buffer)) {
+        output->last_created_time = buffer->timestamp();
+        Start(output);
+    }
 
-            if (has_first_keyframe && video_recorder) {
-                video_recorder->OnBuffer(buffer);
-            }
+    // restart to write in the new file.
+    if (output->elapsed_time >= output->file_duration) {
+        output->last_created_time = buffer->timestamp();
+        Stop(output);
+        Start(output);
+    }
 
-            elapsed_time_ = (buffer->timestamp().tv_sec - last_created_time_.tv_sec) +
-                            (buffer->timestamp().tv_usec - last_created_time_.tv_usec) / 1000000.0;
-        },
-        config.record_stream_idx);
+    if (!output->pending_thumbnail_path.empty() && IsKeyFrame(buffer)) {
+        // the captured buffer is requeued after this callback, so the writer takes a copy.
+        thumbnail_writer_->Write(buffer->Clone(), output->pending_thumbnail_path);
+        output->pending_thumbnail_path.clear();
+    }
 
-    if (video_recorder) {
-        video_recorder->OnPacketed([this](AVPacket *pkt) {
-            this->WriteIntoFile(pkt);
-        });
+    if (output->has_first_keyframe && output->video_recorder) {
+        output->video_recorder->OnBuffer(buffer);
     }
+
+    output->elapsed_time =
+        (buffer->timestamp().tv_sec - output->last_created_time.tv_sec) +
+        (buffer->timestamp().tv_usec - output->last_created_time.tv_usec) / 1000000.0;
+}
+
+void RecorderManager::ScaleFrame(RecordOutput *output, V4L2FrameBufferRef buffer) {
+    if (!output->scaler) {
+#if defined(USE_RPI_HW_ENCODER)
+        if (config.hw_accel) {
+            output->scaler = V4L2Scaler::Create(buffer->width(), buffer->height(), buffer->format(),
+                                                output->width, output->height,
+                                                video_src_->is_dma_capture(), false);
+        }
+#endif
+        if (!output->scaler) {
+            // the capture thread only copies the frame, the scaling runs on the scaler's thread.
+            output->scaler = LibyuvScaler::Create(output->width, output->height);
+        }
+    }
+
+    output->scaler->EmplaceBuffer(
+        buffer, [this, output, timestamp = buffer->timestamp()](V4L2FrameBufferRef scaled) {
+            scaled->SetTimestamp(timestamp);
+            OnVideoFrame(output, scaled);
+        });
 }
 
 void RecorderManager::SubscribeAudioSource(std::shared_ptr<PaCapturer> audio_src) {
-    if (!audio_recorder) {
+    if (!audio_recorder || outputs.empty()) {
         return;
     }
 
-    audio_subscription_ = audio_src->Subscribe([this](PaBuffer buffer) {
-        if (has_first_keyframe) {
+    // the audio goes into the main output only.
+    auto output = outputs.front().get();
+    audio_subscription_ = audio_src->Subscribe([this, output](PaBuffer buffer) {
+        if (output->has_first_keyframe) {
             audio_recorder->OnBuffer(buffer);
         }
     });
 
-    audio_recorder->OnPacketed([this](AVPacket *pkt) {
-        this->WriteIntoFile(pkt);
+    audio_recorder->OnPacketed([this, output](AVPacket *pkt, AVRational time_base) {
+        this->WriteIntoFile(output, pkt, time_base);
     });
 }
 
-void RecorderManager::WriteIntoFile(AVPacket *pkt) {
+void RecorderManager::WriteIntoFile(RecordOutput *output, AVPacket *pkt, AVRational time_base) {
     std::lock_guard<std::mutex> lock(ctx_mux);
 
-    if (!fmt_ctx)
+    if (!output->fmt_ctx)
         return;
 
-    if (!header_written_) {
-        if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
-            return;
-        }
-
-        AVCodecParameters *codecpar = fmt_ctx->streams[pkt->stream_index]->codecpar;
-
-        if (codecpar->codec_id == AV_CODEC_ID_AV1) {
-            av_free(codecpar->extradata);
-            codecpar->extradata = (uint8_t *)av_malloc(pkt->size + AV_INPUT_BUFFER_PADDING_SIZE);
-            memcpy(codecpar->extradata, pkt->data, pkt->size);
-            memset(codecpar->extradata + pkt->size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
-            codecpar->extradata_size = pkt->size;
-        }
-
-        if (avformat_write_header(fmt_ctx, nullptr) < 0) {
-            ERROR_PRINT("Error writing header");
-            return;
-        }
-        header_written_ = true;
-    }
-
-    int ret;
-    if (fmt_ctx->nb_streams > pkt->stream_index &&
-        (ret = av_interleaved_write_frame(fmt_ctx, pkt)) < 0) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE];
-        av_strerror(ret, err_buf, sizeof(err_buf));
-        fprintf(stderr, "Error occurred: %s\n", err_buf);
-    }
+    disk_writer_->Write(output->fmt_ctx, pkt, time_base);
 }
 
-void RecorderManager::Start() {
-    if (!Utils::CheckDriveSpace(record_path, MIN_FREE_BYTE)) {
-        auto task = std::async(std::launch::async, [this]() {
-            Utils::RotateFiles(record_path);
-        });
-    }
-
-    FileInfo new_file(record_path, CONTAINER_FORMAT);
+void RecorderManager::Start(RecordOutput *output) {
+    bool is_main = output == outputs.front().get();
+    FileInfo new_file(record_path, output->passthrough ? PASSTHROUGH_EXTENSION : CONTAINER_FORMAT,
+                      output->suffix);
     auto folder = new_file.GetFolderPath();
     Utils::CreateFolder(folder);
 
     if (config.record_mode != RecordMode::Snapshot) {
         std::lock_guard<std::mutex> lock(ctx_mux);
-        fmt_ctx = RecUtil::CreateContainer(new_file.GetFullPath());
-        if (fmt_ctx == nullptr) {
+        output->fmt_ctx = RecUtil::CreateContainer(
+            new_file.GetFullPath(),
+            output->passthrough ? PASSTHROUGH_CONTAINER_FORMAT : CONTAINER_FORMAT);
+        if (output->fmt_ctx == nullptr) {
             usleep(1000);
             return;
         }
 
-        if (video_recorder) {
-            video_recorder->AddStream(fmt_ctx);
+        if (output->video_recorder) {
+            output->video_recorder->AddStream(output->fmt_ctx);
         }
-        if (audio_recorder) {
-            audio_recorder->AddStream(fmt_ctx);
+        if (is_main && audio_recorder) {
+            audio_recorder->AddStream(output->fmt_ctx);
         }
 
-        header_written_ = false;
-
-        av_dump_format(fmt_ctx, 0, new_file.GetFullPath().c_str(), 1);
+        av_dump_format(output->fmt_ctx, 0, new_file.GetFullPath().c_str(), 1);
+        retention_->AddFile(new_file.GetFullPath());
     }
 
-    if (video_recorder) {
-        video_recorder->Start();
+    // the segment starts at the capture time of its first video frame.
+    if (output->video_recorder) {
+        output->video_recorder->SetBaseTime(output->last_created_time);
+        output->video_recorder->Start();
     }
-    if (audio_recorder) {
+    if (is_main && audio_recorder) {
+        audio_recorder->SetBaseTime(output->last_created_time);
         audio_recorder->Start();
     }
 
-    if (config.record_mode != RecordMode::Video) {
+    if (is_main && config.record_mode != RecordMode::Video) {
         auto image_path = ReplaceExtension(new_file.GetFullPath(), PREVIEW_IMAGE_EXTENSION);
-        MakePreviewImage(image_path);
+        output->pending_thumbnail_path = image_path;
+        retention_->AddFile(image_path);
     }
 
-    has_first_keyframe = true;
+    // apply the quotas with the previous segment's final size.
+    retention_->Trigger();
+
+    output->has_first_keyframe = true;
 }
 
-void RecorderManager::Stop() {
-    if (video_recorder) {
-        video_recorder->Stop();
+void RecorderManager::Stop(RecordOutput *output) {
+    if (output->video_recorder) {
+        output->video_recorder->Stop();
     }
-    if (audio_recorder) {
+    if (output == outputs.front().get() && audio_recorder) {
         audio_recorder->Stop();
     }
 
     {
         std::lock_guard<std::mutex> lock(ctx_mux);
-        RecUtil::CloseContext(fmt_ctx);
-        fmt_ctx = nullptr;
-        header_written_ = false;
+        disk_writer_->Close(output->fmt_ctx);
+        output->fmt_ctx = nullptr;
+    }
+}
+
+void RecorderManager::Stop() {
+    for (auto &output : outputs) {
+        Stop(output.get());
     }
 }
 
 RecorderManager::~RecorderManager() {
     printf("~RecorderManager\n");
+    // no frame or audio arrives after unsubscribing and releasing the scalers.
+    for (auto &output : outputs) {
+        auto released = std::move(output->subscription);
+    }
+    {
+        auto released = std::move(audio_subscription_);
+    }
+    for (auto &output : outputs) {
+        output->scaler.reset();
+    }
     Stop();
-    worker_.reset();
-    video_recorder.reset();
+    retention_.reset();
+    outputs.clear();
     audio_recorder.reset();
 }
 
-void RecorderManager::MakePreviewImage(std::string path) {
-    std::thread([this, path]() {
-        std::this_thread::sleep_for(std::chrono::seconds(3));
-        if (video_src_ == nullptr) {
-            return;
-        }
-        auto i420buff = video_src_->GetI420Frame(config.record_stream_idx);
-        Utils::CreateJpegImage(i420buff->DataY(), i420buff->width(), i420buff->height(), path,
-                               config.jpeg_quality);
-    }).detach();
+bool RecorderManager::IsKeyFrame(V4L2FrameBufferRef buffer) const {
+    return (buffer->flags() & V4L2_BUF_FLAG_KEYFRAME) || video_src_->format() != V4L2_PIX_FMT_H264;
 }
 
 std::string RecorderManager::ReplaceExtension(const std::string &url,
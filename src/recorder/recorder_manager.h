@@ -2,6 +2,7 @@
 #define RECORDER_MANAGER_H_
 
 #include <mutex>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -14,16 +15,24 @@ extern "C" {
 #include "capturer/video_capturer.h"
 #include "common/worker.h"
 #include "recorder/audio_recorder.h"
+#include "recorder/disk_writer.h"
+#include "recorder/libyuv_scaler.h"
+#include "recorder/retention_manager.h"
+#include "recorder/thumbnail_writer.h"
 #include "recorder/video_recorder.h"
+#if defined(USE_RPI_HW_ENCODER)
+#include "codecs/v4l2/v4l2_scaler.h"
+#endif
 
 enum RecordMode {
     Video,
-    Snapshot
+    Snapshot,
+    Timelapse
 };
 
 class RecUtil {
   public:
-    static AVFormatContext *CreateContainer(const std::string &full_path);
+    static AVFormatContext *CreateContainer(const std::string &full_path, const char *format);
     static void CloseContext(AVFormatContext *fmt_ctx);
 };
 
@@ -34,40 +43,67 @@ class RecorderManager {
                                                    Args config);
     RecorderManager(Args config);
     ~RecorderManager();
-    void WriteIntoFile(AVPacket *pkt);
-    void Start();
     void Stop();
 
   protected:
+    /**
+     * One recorded video stream with its own encoder settings and segments, e.g. the
+     * full-resolution archive and a low-bitrate proxy. The first output is the main one,
+     * it carries the audio and the thumbnails.
+     */
+    struct RecordOutput {
+        int stream_idx;
+        int width;
+        int height;
+        // in bps, 0 derives it from the resolution and fps.
+        int bitrate;
+        int file_duration;
+        // appended to the file names, e.g. `_proxy`.
+        std::string suffix;
+        // scale the frames of `stream_idx` down to the output size.
+        bool scaling;
+        // mux the compressed camera frames as they are, into Matroska.
+        bool passthrough;
+
+        AVFormatContext *fmt_ctx = nullptr;
+        bool has_first_keyframe = false;
+        double elapsed_time = 0.0;
+        struct timeval last_created_time = {};
+        // taken from the first keyframe of the segment.
+        std::string pending_thumbnail_path;
+        std::unique_ptr<VideoRecorder> video_recorder;
+        std::unique_ptr<IFrameProcessor> scaler;
+        Subscription subscription;
+    };
+
     std::mutex ctx_mux;
     Args config;
     uint fps;
-    int width;
-    int height;
     std::string record_path;
-    AVFormatContext *fmt_ctx;
-    bool has_first_keyframe;
-    std::unique_ptr<VideoRecorder> video_recorder;
+    std::vector<std::unique_ptr<RecordOutput>> outputs;
     std::unique_ptr<AudioRecorder> audio_recorder;
 
-    void CreateVideoRecorder(std::shared_ptr<VideoCapturer> video_src);
+    void CreateOutputs(std::shared_ptr<VideoCapturer> video_src);
+    void CreateVideoRecorder(RecordOutput *output);
     void CreateAudioRecorder(std::shared_ptr<PaCapturer> aduio_src);
-    void SubscribeVideoSource(std::shared_ptr<VideoCapturer> video_src);
+    void SubscribeVideoSource(RecordOutput *output);
     void SubscribeAudioSource(std::shared_ptr<PaCapturer> aduio_src);
+    void OnVideoFrame(RecordOutput *output, V4L2FrameBufferRef buffer);
+    void ScaleFrame(RecordOutput *output, V4L2FrameBufferRef buffer);
+    void WriteIntoFile(RecordOutput *output, AVPacket *pkt, AVRational time_base);
+    void Start(RecordOutput *output);
+    void Stop(RecordOutput *output);
 
   private:
-    double elapsed_time_;
-    std::mutex rotation_mtx_;
-    std::unique_ptr<Worker> worker_;
-    struct timeval last_created_time_;
+    std::unique_ptr<RetentionManager> retention_;
     std::shared_ptr<VideoCapturer> video_src_;
 
-    bool header_written_ = false;
+    std::unique_ptr<DiskWriter> disk_writer_;
+    std::unique_ptr<ThumbnailWriter> thumbnail_writer_;
 
     Subscription audio_subscription_;
-    Subscription video_subscription_;
 
-    void MakePreviewImage(std::string path);
+    bool IsKeyFrame(V4L2FrameBufferRef buffer) const;
     std::string ReplaceExtension(const std::string &url, const std::string &new_extension);
 };
 
@@ -0,0 +1,247 @@
+#include "recorder/retention_manager.h"
+
+#include <filesystem>
+#include <set>
+#include <sys/statvfs.h>
+#include <vector>
+
+#include "common/logging.h"
+#include "common/metrics.h"
+#include "common/utils.h"
+
+namespace fs = std::filesystem;
+
+const int ENFORCE_PERIOD = 60;
+const std::vector<std::string> MEDIA_EXTENSIONS = {".mp4", ".mkv", ".jpg"};
+// the length of `YYYYmmdd_HHMMSS`, a variant suffix like `_proxy` may follow.
+const size_t DATETIME_LENGTH = 15;
+
+static uint64_t GetFreeBytes(const std::string &path) {
+    struct statvfs stat;
+    if (statvfs(path.c_str(), &stat) != 0) {
+        return 0;
+    }
+    return (uint64_t)stat.f_bsize * stat.f_bavail;
+}
+
+static bool IsMediaFile(const fs::path &path) {
+    auto ext = path.extension().string();
+    for (const auto &media_ext : MEDIA_EXTENSIONS) {
+        if (ext == media_ext) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::string GetVariant(const std::string &stem) {
+    auto filename = fs::path(stem).filename().string();
+    return filename.size() > DATETIME_LENGTH ? filename.substr(DATETIME_LENGTH) : "";
+}
+
+static uint64_t GetSegmentBytes(const std::string &stem) {
+    uint64_t bytes = 0;
+    for (const auto &ext : MEDIA_EXTENSIONS) {
+        std::error_code ec;
+        auto size = fs::file_size(stem + ext, ec);
+        if (!ec) {
+            bytes += size;
+        }
+    }
+    return bytes;
+}
+
+std::unique_ptr<RetentionManager> RetentionManager::Create(const std::string &root,
+                                                           RetentionPolicy policy) {
+    auto ptr = std::make_unique<RetentionManager>(root, policy);
+    ptr->Scan();
+    ptr->worker_ = std::make_unique<Worker>("RetentionWorker", [ptr = ptr.get()]() {
+        ptr->WaitAndEnforce();
+    });
+    ptr->worker_->Run();
+    ptr->Trigger();
+    return ptr;
+}
+
+RetentionManager::RetentionManager(const std::string &root, RetentionPolicy policy)
+    : root_(root),
+      policy_(policy),
+      total_bytes_(0),
+      triggered_(false),
+      stopping_(false) {}
+
+RetentionManager::~RetentionManager() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    worker_.reset();
+}
+
+void RetentionManager::Scan() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(root_, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file() || !IsMediaFile(it->path())) {
+            continue;
+        }
+
+        auto stem = fs::path(it->path()).replace_extension("").string();
+        auto &segment = segments_[stem];
+        segment.created_time = Utils::ParseDatetime(it->path().stem().string());
+        segment.stale = false;
+        auto bytes = it->file_size(ec);
+        if (!ec) {
+            segment.bytes += bytes;
+            total_bytes_ += bytes;
+        }
+        ec.clear();
+    }
+
+    INFO_PRINT("Found %zu recorded segments, %lu MiB in total.", segments_.size(),
+               (unsigned long)(total_bytes_ >> 20));
+}
+
+void RetentionManager::AddFile(const std::string &file_path) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto stem = fs::path(file_path).replace_extension("").string();
+    auto result = segments_.emplace(stem, Segment());
+    if (result.second) {
+        result.first->second.created_time = std::chrono::system_clock::now();
+    }
+    result.first->second.stale = true;
+}
+
+void RetentionManager::Trigger() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        triggered_ = true;
+    }
+    cv_.notify_one();
+}
+
+void RetentionManager::WaitAndEnforce() {
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait_for(lock, std::chrono::seconds(ENFORCE_PERIOD), [this]() {
+            return triggered_ || stopping_;
+        });
+        if (stopping_) {
+            return;
+        }
+        triggered_ = false;
+    }
+
+    Enforce();
+}
+
+void RetentionManager::Enforce() {
+    std::vector<std::string> victims;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        RefreshSizes();
+        Metrics::Instance().Set("recorder_retention_bytes", total_bytes_);
+
+        uint64_t free_bytes = policy_.min_free_bytes ? GetFreeBytes(root_) : 0;
+        uint64_t deficit =
+            free_bytes < policy_.min_free_bytes ? policy_.min_free_bytes - free_bytes : 0;
+        uint64_t remaining_bytes = total_bytes_;
+        auto writing = GetWritingSegments();
+
+        // the oldest segments first, but never the ones still being written.
+        for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+            bool over_quota = policy_.max_total_bytes && remaining_bytes > policy_.max_total_bytes;
+            if (!over_quota && deficit == 0 && !IsExpired(it->second)) {
+                break;
+            }
+            if (writing.count(it->first)) {
+                continue;
+            }
+            victims.push_back(it->first);
+            remaining_bytes -= it->second.bytes;
+            deficit -= std::min(deficit, it->second.bytes);
+        }
+    }
+
+    if (victims.empty()) {
+        return;
+    }
+
+    // unlink the batch without holding the lock, so new segments are never blocked.
+    for (const auto &stem : victims) {
+        DeleteSegment(stem);
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &stem : victims) {
+        auto it = segments_.find(stem);
+        if (it != segments_.end()) {
+            total_bytes_ -= std::min(total_bytes_, it->second.bytes);
+            segments_.erase(it);
+        }
+    }
+
+    Metrics::Instance().Increment("recorder_retention_deleted_total", victims.size());
+    Metrics::Instance().Set("recorder_retention_segments", segments_.size());
+    Metrics::Instance().Set("recorder_retention_bytes", total_bytes_);
+}
+
+std::set<std::string> RetentionManager::GetWritingSegments() const {
+    // the newest segment of each variant, e.g. the main recording and its proxy.
+    std::set<std::string> variants;
+    std::set<std::string> writing;
+    for (auto it = segments_.rbegin(); it != segments_.rend(); ++it) {
+        if (variants.insert(GetVariant(it->first)).second) {
+            writing.insert(it->first);
+        }
+    }
+    return writing;
+}
+
+void RetentionManager::RefreshSizes() {
+    auto writing = GetWritingSegments();
+    // the segments still being written stay stale, wherever they sort among the variants.
+    for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+        if (!it->second.stale) {
+            continue;
+        }
+        uint64_t bytes = GetSegmentBytes(it->first);
+        total_bytes_ = total_bytes_ - std::min(total_bytes_, it->second.bytes) + bytes;
+        it->second.bytes = bytes;
+        it->second.stale = writing.count(it->first) > 0;
+    }
+}
+
+bool RetentionManager::IsExpired(const Segment &segment) const {
+    if (policy_.max_age_sec <= 0) {
+        return false;
+    }
+    return std::chrono::system_clock::now() - segment.created_time >
+           std::chrono::seconds(policy_.max_age_sec);
+}
+
+void RetentionManager::DeleteSegment(const std::string &stem) {
+    for (const auto &ext : MEDIA_EXTENSIONS) {
+        std::error_code ec;
+        if (fs::remove(stem + ext, ec)) {
+            INFO_PRINT("Deleted file: %s%s", stem.c_str(), ext.c_str());
+        }
+    }
+
+    // clean up the hour and date folders if empty.
+    fs::path folder = fs::path(stem).parent_path();
+    for (int depth = 0; depth < 2; depth++) {
+        auto relative = folder.lexically_relative(root_);
+        if (relative.empty() || relative == ".") {
+            break;
+        }
+        std::error_code ec;
+        if (!fs::is_empty(folder, ec) || ec || !fs::remove(folder, ec)) {
+            break;
+        }
+        INFO_PRINT("Deleted empty folder: %s", folder.string().c_str());
+        folder = folder.parent_path();
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef RETENTION_MANAGER_H_
+#define RETENTION_MANAGER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "common/worker.h"
+
+struct RetentionPolicy {
+    // 0 means unlimited.
+    uint64_t max_total_bytes = 0;
+    // 0 means unlimited.
+    int max_age_sec = 0;
+    uint64_t min_free_bytes = 0;
+};
+
+/**
+ * Keep the recorded segments in an oldest-first index, built once at startup
+ * and updated as new files are created, so enforcing the quotas never walks
+ * the record folder again. Deletions run in batches on its own worker.
+ */
+class RetentionManager {
+  public:
+    static std::unique_ptr<RetentionManager> Create(const std::string &root,
+                                                    RetentionPolicy policy);
+
+    RetentionManager(const std::string &root, RetentionPolicy policy);
+    ~RetentionManager();
+
+    // Register a newly created media file, e.g. `.mp4` or its `.jpg` thumbnail.
+    void AddFile(const std::string &file_path);
+    // Enforce the policies as soon as possible instead of the next period.
+    void Trigger();
+
+  private:
+    struct Segment {
+        std::chrono::system_clock::time_point created_time;
+        uint64_t bytes = 0;
+        // the size is not final while the segment is still being written.
+        bool stale = true;
+    };
+
+    std::string root_;
+    RetentionPolicy policy_;
+    uint64_t total_bytes_;
+    bool triggered_;
+    bool stopping_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    // keyed by the path without extension, which sorts in recording order.
+    std::map<std::string, Segment> segments_;
+    std::unique_ptr<Worker> worker_;
+
+    void Scan();
+    void WaitAndEnforce();
+    void Enforce();
+    void RefreshSizes();
+    std::set<std::string> GetWritingSegments() const;
+    bool IsExpired(const Segment &segment) const;
+    void DeleteSegment(const std::string &stem);
+};
+
+#endif // RETENTION_MANAGER_H_
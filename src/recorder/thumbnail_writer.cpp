@@ -0,0 +1,161 @@
+#include "recorder/thumbnail_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <third_party/libyuv/include/libyuv.h>
+
+#include "common/logging.h"
+#include "common/utils.h"
+
+// One pending thumbnail per output is enough, they are minutes apart.
+const int MAX_PENDING_THUMBNAILS = 2;
+
+static void GetThumbnailSize(int src_width, int src_height, int max_width, int *width,
+                             int *height) {
+    // the V4L2 jpeg encoder expects the planes aligned to whole macroblocks.
+    int w = max_width > 0 ? std::min(max_width, src_width) : src_width;
+    *width = std::max(w & ~31, 32);
+    *height = std::max((src_height * *width / src_width + 8) & ~15, 16);
+}
+
+std::unique_ptr<ThumbnailWriter> ThumbnailWriter::Create(int width, int quality,
+                                                         bool use_hw_encoder) {
+    auto ptr = std::make_unique<ThumbnailWriter>(width, quality, use_hw_encoder);
+    ptr->worker_ = std::make_unique<Worker>("ThumbnailWriter", [ptr = ptr.get()]() {
+        ptr->ProcessTask();
+    });
+    ptr->worker_->Run();
+    return ptr;
+}
+
+ThumbnailWriter::ThumbnailWriter(int width, int quality, bool use_hw_encoder)
+    : width_(width),
+      quality_(quality),
+      use_hw_encoder_(use_hw_encoder),
+      warned_h264_(false),
+      tasks_(MAX_PENDING_THUMBNAILS) {}
+
+ThumbnailWriter::~ThumbnailWriter() {
+    worker_.reset();
+#if defined(USE_RPI_HW_ENCODER)
+    hw_encoder_.reset();
+#endif
+}
+
+void ThumbnailWriter::Write(V4L2FrameBufferRef frame_buffer, const std::string &path) {
+    if (!tasks_.push({frame_buffer, path})) {
+        DEBUG_PRINT("Thumbnail writer skip %s due to overloaded queue.", path.c_str());
+    }
+}
+
+void ThumbnailWriter::ProcessTask() {
+    auto item = tasks_.pop(100);
+    if (!item) {
+        return;
+    }
+    auto task = item.value();
+
+    auto thumbnail = Downscale(task.frame_buffer);
+    if (!thumbnail) {
+        return;
+    }
+
+    if (use_hw_encoder_ && EncodeByHardware(thumbnail, task.path)) {
+        return;
+    }
+
+    int width = thumbnail->width();
+    int height = thumbnail->height();
+    auto y_data = static_cast<const uint8_t *>(thumbnail->Data());
+    auto u_data = y_data + width * height;
+    auto v_data = u_data + width / 2 * height / 2;
+    try {
+        auto jpg_buffer = Utils::ConvertI420ToJpeg(y_data, width, u_data, width / 2, v_data,
+                                                   width / 2, width, height, quality_);
+        Utils::WriteJpegImage(std::move(jpg_buffer), task.path);
+    } catch (const std::exception &e) {
+        ERROR_PRINT("Failed to create thumbnail %s: %s", task.path.c_str(), e.what());
+    }
+}
+
+V4L2FrameBufferRef ThumbnailWriter::Downscale(V4L2FrameBufferRef frame_buffer) {
+    int src_width = frame_buffer->width();
+    int src_height = frame_buffer->height();
+    int width, height;
+    GetThumbnailSize(src_width, src_height, width_, &width, &height);
+
+    const uint8_t *src_y, *src_u, *src_v;
+    int src_stride_y, src_stride_uv;
+    rtc::scoped_refptr<webrtc::I420BufferInterface> i420_buffer;
+    if (frame_buffer->format() == V4L2_PIX_FMT_YUV420) {
+        // the encoders below expect the rows packed.
+        if (width == src_width && height == src_height && frame_buffer->stride() == src_width) {
+            return frame_buffer;
+        }
+        // read the planes in place instead of copying the full frame into an i420 buffer.
+        src_stride_y = frame_buffer->stride();
+        src_stride_uv = (src_stride_y + 1) / 2;
+        if (frame_buffer->size() <
+            (uint32_t)(src_stride_y * src_height + src_stride_uv * ((src_height + 1) / 2) * 2)) {
+            ERROR_PRINT("Thumbnail frame is smaller than its %dx%d planes.", src_stride_y,
+                        src_height);
+            return nullptr;
+        }
+        src_y = static_cast<const uint8_t *>(frame_buffer->Data());
+        src_u = src_y + src_stride_y * src_height;
+        src_v = src_u + src_stride_uv * ((src_height + 1) / 2);
+    } else if (frame_buffer->format() == V4L2_PIX_FMT_H264) {
+        if (!warned_h264_) {
+            WARN_PRINT("Thumbnails are not supported for h264 camera frames, none will be saved.");
+            warned_h264_ = true;
+        }
+        return nullptr;
+    } else {
+        i420_buffer = frame_buffer->ToI420();
+        src_stride_y = i420_buffer->StrideY();
+        src_stride_uv = i420_buffer->StrideU();
+        src_y = i420_buffer->DataY();
+        src_u = i420_buffer->DataU();
+        src_v = i420_buffer->DataV();
+    }
+
+    int y_size = width * height;
+    auto thumbnail = V4L2FrameBuffer::Create(width, height, y_size * 3 / 2, V4L2_PIX_FMT_YUV420);
+    uint8_t *dst_y = thumbnail->MutableData();
+    uint8_t *dst_u = dst_y + y_size;
+    uint8_t *dst_v = dst_u + y_size / 4;
+    libyuv::I420Scale(src_y, src_stride_y, src_u, src_stride_uv, src_v, src_stride_uv, src_width,
+                      src_height, dst_y, width, dst_u, width / 2, dst_v, width / 2, width, height,
+                      libyuv::kFilterBox);
+    thumbnail->SetTimestamp(frame_buffer->timestamp());
+
+    return thumbnail;
+}
+
+bool ThumbnailWriter::EncodeByHardware(V4L2FrameBufferRef thumbnail, const std::string &path) {
+#if defined(USE_RPI_HW_ENCODER)
+    if (!hw_encoder_ || hw_width_ != thumbnail->width() || hw_height_ != thumbnail->height()) {
+        hw_encoder_.reset();
+        hw_width_ = thumbnail->width();
+        hw_height_ = thumbnail->height();
+        hw_encoder_ = V4L2JpegEncoder::Create(hw_width_, hw_height_, quality_);
+        if (!hw_encoder_) {
+            WARN_PRINT("V4L2 jpeg encoder is unavailable, use libjpeg for thumbnails.");
+            use_hw_encoder_ = false;
+            return false;
+        }
+    }
+
+    hw_encoder_->EmplaceBuffer(thumbnail, [path](V4L2FrameBufferRef jpeg_buffer) {
+        Buffer buffer;
+        buffer.length = jpeg_buffer->size();
+        buffer.start.reset(static_cast<uint8_t *>(malloc(buffer.length)));
+        memcpy(buffer.start.get(), jpeg_buffer->Data(), buffer.length);
+        Utils::WriteJpegImage(std::move(buffer), path);
+    });
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,52 @@
+#ifndef THUMBNAIL_WRITER_H_
+#define THUMBNAIL_WRITER_H_
+
+#include <string>
+
+#include "common/thread_safe_queue.h"
+#include "common/v4l2_frame_buffer.h"
+#include "common/worker.h"
+#if defined(USE_RPI_HW_ENCODER)
+#include "codecs/v4l2/v4l2_jpeg_encoder.h"
+#endif
+
+/**
+ * Encode the segment thumbnails on a dedicated thread. The frame is scaled down
+ * from its yuv planes and handed to libjpeg as raw yuv, or to the V4L2 jpeg
+ * encoder if it is available.
+ */
+class ThumbnailWriter {
+  public:
+    // `width` 0 keeps the frame width, `use_hw_encoder` falls back to libjpeg if unavailable.
+    static std::unique_ptr<ThumbnailWriter> Create(int width, int quality, bool use_hw_encoder);
+
+    ThumbnailWriter(int width, int quality, bool use_hw_encoder);
+    ~ThumbnailWriter();
+
+    // The frame must own its data, e.g. a clone of the captured buffer.
+    void Write(V4L2FrameBufferRef frame_buffer, const std::string &path);
+
+  private:
+    struct Task {
+        V4L2FrameBufferRef frame_buffer;
+        std::string path;
+    };
+
+    int width_;
+    int quality_;
+    bool use_hw_encoder_;
+    bool warned_h264_;
+    ThreadSafeQueue<Task> tasks_;
+#if defined(USE_RPI_HW_ENCODER)
+    std::unique_ptr<V4L2JpegEncoder> hw_encoder_;
+    int hw_width_ = 0;
+    int hw_height_ = 0;
+#endif
+    std::unique_ptr<Worker> worker_;
+
+    void ProcessTask();
+    V4L2FrameBufferRef Downscale(V4L2FrameBufferRef frame_buffer);
+    bool EncodeByHardware(V4L2FrameBufferRef thumbnail, const std::string &path);
+};
+
+#endif // THUMBNAIL_WRITER_H_
@@ -6,14 +6,16 @@
 
 class V4L2H264Recorder : public VideoRecorder {
   public:
-    static std::unique_ptr<V4L2H264Recorder> Create(int width, int height, int fps);
-    V4L2H264Recorder(int width, int height, int fps);
+    static std::unique_ptr<V4L2H264Recorder> Create(int width, int height, int fps,
+                                                    int bitrate = 0);
+    V4L2H264Recorder(int width, int height, int fps, int bitrate);
 
   protected:
     void ReleaseEncoder() override;
     void Encode(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) override;
 
   private:
+    int bitrate_;
     std::unique_ptr<V4L2Encoder> encoder_;
 };
 
@@ -11,7 +11,7 @@ VideoRecorder::VideoRecorder(int width, int height, int fps, AVCodecID encoder_i
       width(width),
       height(height),
       encoder_id(encoder_id),
-      base_time_initialized(false) {}
+      sampled_count_(0) {}
 
 void VideoRecorder::InitializeEncoderCtx(AVCodecContext *&encoder) {
     AVRational frame_rate = {.num = (int)fps, .den = 1};
@@ -26,15 +26,40 @@ void VideoRecorder::InitializeEncoderCtx(AVCodecContext *&encoder) {
     encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 }
 
+void VideoRecorder::SetFrameSampler(std::unique_ptr<FrameSampler> sampler) {
+    sampler_ = std::move(sampler);
+}
+
 void VideoRecorder::OnBuffer(rtc::scoped_refptr<V4L2FrameBuffer> frame_buffer) {
-    if (!frame_buffer_queue.push(frame_buffer->Clone())) {
+    // decide before cloning, so the skipped frames cost nothing.
+    if (sampler_ && !sampler_->Pick(frame_buffer)) {
+        return;
+    }
+
+    auto clone = frame_buffer->Clone();
+    if (sampler_) {
+        // lay the sampled frames out at the playback frame rate.
+        int64_t timestamp_us = base_time_us + sampled_count_ * 1000000 / fps;
+        clone->SetTimestamp({.tv_sec = (time_t)(timestamp_us / 1000000),
+                             .tv_usec = (suseconds_t)(timestamp_us % 1000000)});
+    }
+
+    if (!frame_buffer_queue.push(clone)) {
         INFO_PRINT("frame_buffer_queue skip a frame due to overloaded queue.\n");
+        return;
+    }
+    sampled_count_++;
+}
+
+void VideoRecorder::OnStart() {
+    sampled_count_ = 0;
+    if (sampler_) {
+        sampler_->Reset();
     }
 }
 
 void VideoRecorder::OnStop() {
     std::lock_guard<std::mutex> lock(encoder_mtx_);
-    base_time_initialized = false;
     ReleaseEncoder();
 }
 
@@ -51,19 +76,9 @@ void VideoRecorder::OnEncoded(uint8_t *start, uint32_t length, timeval timestamp
         pkt->flags |= AV_PKT_FLAG_KEY;
     }
 
-    if (!base_time_initialized) {
-        base_time_ = timestamp;
-        base_time_initialized = true;
-    }
-
-    int64_t elapsed_usec = (int64_t)(timestamp.tv_sec - base_time_.tv_sec) * 1000000LL +
-                           (int64_t)(timestamp.tv_usec - base_time_.tv_usec);
-
-    AVRational usec_base = {1, 1000000};
+    pkt->pts = pkt->dts = ToMicroseconds(timestamp) - base_time_us;
 
-    pkt->pts = pkt->dts = av_rescale_q(elapsed_usec, usec_base, st->time_base);
-
-    OnPacketed(pkt);
+    OnPacketed(pkt, {1, 1000000});
 
     av_packet_free(&pkt);
 }
@@ -77,6 +92,11 @@ bool VideoRecorder::ConsumeBuffer() {
 
     auto frame_buffer = item.value();
 
+    // frames left from the previous segment are earlier than the shared zero.
+    if (ToMicroseconds(frame_buffer->timestamp()) < base_time_us) {
+        return false;
+    }
+
     std::lock_guard<std::mutex> lock(encoder_mtx_);
 
     if (!IsEncoderReady()) {
@@ -12,6 +12,7 @@ extern "C" {
 #include "codecs/v4l2/v4l2_decoder.h"
 #include "common/thread_safe_queue.h"
 #include "common/v4l2_frame_buffer.h"
+#include "recorder/frame_sampler.h"
 #include "recorder/recorder.h"
 
 class VideoRecorder : public Recorder<rtc::scoped_refptr<V4L2FrameBuffer>> {
@@ -19,7 +20,10 @@ class VideoRecorder : public Recorder<rtc::scoped_refptr<V4L2FrameBuffer>> {
     VideoRecorder(int width, int height, int fps, AVCodecID encoder_id);
     virtual ~VideoRecorder(){};
     void OnBuffer(rtc::scoped_refptr<V4L2FrameBuffer> buffer) override;
+    void OnStart() override;
     void OnStop() override final;
+    // Record only the sampled frames, played back at the recorder's fps.
+    void SetFrameSampler(std::unique_ptr<FrameSampler> sampler);
 
   protected:
     int fps;
@@ -37,8 +41,8 @@ class VideoRecorder : public Recorder<rtc::scoped_refptr<V4L2FrameBuffer>> {
 
   private:
     std::mutex encoder_mtx_;
-    struct timeval base_time_;
-    std::atomic<bool> base_time_initialized;
+    std::unique_ptr<FrameSampler> sampler_;
+    int64_t sampled_count_;
 
     void InitializeEncoderCtx(AVCodecContext *&encoder) override;
 };
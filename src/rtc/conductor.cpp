@@ -1,6 +1,8 @@
 #include "rtc/conductor.h"
 
 #include <algorithm>
+#include <map>
+#include <sstream>
 
 #include <api/audio_codecs/builtin_audio_decoder_factory.h>
 #include <api/audio_codecs/builtin_audio_encoder_factory.h>
@@ -29,11 +31,59 @@
 #include "capturer/libargus_egl_capturer.h"
 #endif
 #include "capturer/v4l2_capturer.h"
+#include "common/encoder_stats.h"
 #include "common/logging.h"
+#include "common/roi_controller.h"
 #include "common/utils.h"
 #include "customized_video_encoder_factory.h"
 #include "track/v4l2dma_track_source.h"
 
+const size_t MAX_TRANSFER_STREAMS = 16;
+
+// the options of a file request, `<path>?offset=<n>&length=<n>&stream=<id>&moov_first=1`.
+static std::map<std::string, std::string> ParseTransferQuery(const std::string &request,
+                                                             std::string *path) {
+    std::map<std::string, std::string> options;
+    auto query_pos = request.rfind('?');
+    *path = request.substr(0, query_pos);
+    if (query_pos == std::string::npos) {
+        return options;
+    }
+
+    std::stringstream query(request.substr(query_pos + 1));
+    std::string option;
+    while (std::getline(query, option, '&')) {
+        auto eq_pos = option.find('=');
+        if (eq_pos != std::string::npos) {
+            options[option.substr(0, eq_pos)] = option.substr(eq_pos + 1);
+        }
+    }
+    return options;
+}
+
+// the metadata boxes first so a player can start before the media data arrives.
+static std::vector<RtcTransfer::Range> MoovFirstRanges(const std::string &path, size_t offset,
+                                                       size_t length) {
+    auto boxes = Utils::GetMp4Boxes(path);
+    std::stable_partition(boxes.begin(), boxes.end(), [](const Mp4Box &box) {
+        return box.type != "mdat";
+    });
+
+    std::vector<RtcTransfer::Range> ranges;
+    size_t end = offset + length;
+    for (const auto &box : boxes) {
+        size_t start = std::max<size_t>(box.offset, offset);
+        size_t stop = std::min<size_t>(box.offset + box.size, end);
+        if (start < stop) {
+            ranges.push_back({start, stop - start});
+        }
+    }
+    if (ranges.empty()) {
+        ranges.push_back({offset, length});
+    }
+    return ranges;
+}
+
 std::shared_ptr<Conductor> Conductor::Create(Args args) {
     // Generate default UID if not provided (required for msid stream ID)
     if (args.uid.empty()) {
@@ -45,6 +95,8 @@ std::shared_ptr<Conductor> Conductor::Create(Args args) {
     }
     
     auto ptr = std::make_shared<Conductor>(args);
+    // the encoder factory drives the camera when it passes its H264 through.
+    ptr->InitializeVideoSource();
     ptr->InitializePeerConnectionFactory();
     ptr->InitializeTracks();
     ptr->InitializeIpcServer();
@@ -52,6 +104,7 @@ std::shared_ptr<Conductor> Conductor::Create(Args args) {
     // Initialize UART controller if enabled
     if (args.enable_uart_control) {
         ptr->uart_controller_ = UartController::Create(args.uart_device, args.uart_baud);
+        ptr->car_control_ = CarControl::Create(ptr->uart_controller_, args.control_deadman_ms);
     }
     
     return ptr;
@@ -64,6 +117,8 @@ Conductor::~Conductor() {
     if (ipc_server_) {
         ipc_server_->Stop();
     }
+    // the deadman must not drive the car after it is stopped.
+    car_control_ = nullptr;
     if (uart_controller_) {
         uart_controller_->Stop();
     }
@@ -80,6 +135,33 @@ std::shared_ptr<PaCapturer> Conductor::AudioSource() const { return audio_captur
 
 std::shared_ptr<VideoCapturer> Conductor::VideoSource() const { return video_capture_source_; }
 
+void Conductor::InitializeVideoSource() {
+    if (args.camera.empty()) {
+        return;
+    }
+
+    video_capture_source_ = ([this]() -> std::shared_ptr<VideoCapturer> {
+        if (!args.use_libcamera && !args.use_libargus) {
+            INFO_PRINT("Use v4l2 capturer.");
+            return V4L2Capturer::Create(args);
+        }
+#if defined(USE_LIBCAMERA_CAPTURE)
+        else if (args.use_libcamera) {
+            INFO_PRINT("Use libcamera capturer.");
+            return LibcameraCapturer::Create(args);
+        }
+#elif defined(USE_LIBARGUS_CAPTURE)
+        else if (args.use_libargus) {
+            INFO_PRINT("Use libargus capturer.");
+            // return LibargusBufferCapturer::Create(args);
+            return LibargusEglCapturer::Create(args);
+        }
+#endif
+        ERROR_PRINT("Capturer is undefined.");
+        return nullptr;
+    })();
+}
+
 void Conductor::InitializeTracks() {
     if (audio_track_ == nullptr && !args.no_audio) {
         audio_capture_source_ = PaCapturer::Create(args);
@@ -87,30 +169,9 @@ void Conductor::InitializeTracks() {
         audio_track_ = peer_connection_factory_->CreateAudioTrack("audio_track", options.get());
     }
 
-    if (video_track_ == nullptr && !args.camera.empty()) {
-        video_capture_source_ = ([this]() -> std::shared_ptr<VideoCapturer> {
-            if (!args.use_libcamera && !args.use_libargus) {
-                INFO_PRINT("Use v4l2 capturer.");
-                return V4L2Capturer::Create(args);
-            }
-#if defined(USE_LIBCAMERA_CAPTURE)
-            else if (args.use_libcamera) {
-                INFO_PRINT("Use libcamera capturer.");
-                return LibcameraCapturer::Create(args);
-            }
-#elif defined(USE_LIBARGUS_CAPTURE)
-            else if (args.use_libargus) {
-                INFO_PRINT("Use libargus capturer.");
-                // return LibargusBufferCapturer::Create(args);
-                return LibargusEglCapturer::Create(args);
-            }
-#endif
-            ERROR_PRINT("Capturer is undefined.");
-            return nullptr;
-        })();
-
+    if (video_track_ == nullptr && video_capture_source_) {
         video_track_source_ = ([this]() -> rtc::scoped_refptr<ScaleTrackSource> {
-            if (args.hw_accel) {
+            if (args.hw_accel || args.h264_passthrough) {
                 return V4L2DmaTrackSource::Create(video_capture_source_);
             } else {
                 return ScaleTrackSource::Create(video_capture_source_);
@@ -123,7 +184,8 @@ void Conductor::InitializeTracks() {
     }
 }
 
-void Conductor::AddTracks(rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection) {
+void Conductor::AddTracks(rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection,
+                          bool is_simulcast) {
     if (!peer_connection->GetSenders().empty()) {
         DEBUG_PRINT("Already add tracks.");
         return;
@@ -136,7 +198,9 @@ void Conductor::AddTracks(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pe
         }
     }
 
-    if (video_track_) {
+    if (video_track_ && is_simulcast) {
+        AddSimulcastTrack(peer_connection);
+    } else if (video_track_) {
         auto video_res = peer_connection->AddTrack(video_track_, {args.uid});
         if (!video_res.ok()) {
             ERROR_PRINT("Failed to add video track, %s", video_res.error().message());
@@ -149,6 +213,32 @@ void Conductor::AddTracks(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pe
     }
 }
 
+void Conductor::AddSimulcastTrack(
+    rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection) {
+    // the encodings go from the lowest resolution up, each one halves the next.
+    const std::vector<std::string> rids = {"q", "h", "f"};
+    webrtc::RtpTransceiverInit init;
+    init.stream_ids = {args.uid};
+    for (int i = 0; i < args.simulcast_layers; i++) {
+        webrtc::RtpEncodingParameters encoding;
+        encoding.rid = rids[rids.size() - args.simulcast_layers + i];
+        encoding.scale_resolution_down_by = 1 << (args.simulcast_layers - 1 - i);
+        init.send_encodings.push_back(encoding);
+    }
+
+    auto video_res = peer_connection->AddTransceiver(video_track_, init);
+    if (!video_res.ok()) {
+        ERROR_PRINT("Failed to add simulcast video track, %s", video_res.error().message());
+        return;
+    }
+
+    auto video_sender_ = video_res.value()->sender();
+    webrtc::RtpParameters parameters = video_sender_->GetParameters();
+    parameters.degradation_preference = webrtc::DegradationPreference::MAINTAIN_FRAMERATE;
+    video_sender_->SetParameters(parameters);
+    INFO_PRINT("Publish %d simulcast layers.", args.simulcast_layers);
+}
+
 rtc::scoped_refptr<RtcPeer> Conductor::CreatePeerConnection(PeerConfig config) {
     config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
     webrtc::PeerConnectionInterface::IceServer server;
@@ -177,7 +267,9 @@ rtc::scoped_refptr<RtcPeer> Conductor::CreatePeerConnection(PeerConfig config) {
 
     InitializeDataChannels(peer);
 
-    AddTracks(peer->GetPeer());
+    // only an SFU can pick a layer per subscriber, a direct viewer gets the single stream.
+    AddTracks(peer->GetPeer(),
+              args.simulcast_layers > 1 && peer->isSfuPeer() && peer->isPublisher());
 
     DEBUG_PRINT("Peer connection(%s) is created! ", peer->id().c_str());
     return peer;
@@ -217,6 +309,9 @@ void Conductor::InitializeDataChannels(rtc::scoped_refptr<RtcPeer> peer) {
 
     if (!peer->isSfuPeer()) {
         InitializeCommandChannel(peer);
+        if (car_control_) {
+            InitializeControlChannel(peer);
+        }
     }
 }
 
@@ -249,6 +344,29 @@ void Conductor::InitializeCommandChannel(rtc::scoped_refptr<RtcPeer> peer) {
         });
 }
 
+void Conductor::InitializeControlChannel(rtc::scoped_refptr<RtcPeer> peer) {
+    auto control_channel = peer->CreateControlChannel();
+    if (!control_channel) {
+        return;
+    }
+
+    // the channel keeps its own sequence, the other drivers and viewers don't reset it.
+    control_channel->SetMessageHandler([car_control = car_control_,
+                                        session = car_control_->CreateSession(),
+                                        channel = std::weak_ptr<RawChannel>(control_channel)](
+                                           const std::string &message) {
+        // the echoes and latency reports go back to the sender.
+        auto reply = [channel](const std::string &response) {
+            if (auto control_channel = channel.lock()) {
+                control_channel->Send(response);
+            }
+        };
+        if (!car_control->OnMessage(*session, message, reply)) {
+            ERROR_PRINT("Invalid car control message (%zu bytes)", message.size());
+        }
+    });
+}
+
 void Conductor::TakeSnapshot(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt) {
     try {
         auto quality = std::clamp(pkt.take_snapshot_request().quality(), 0u, 100u);
@@ -278,8 +396,10 @@ void Conductor::QueryFile(std::shared_ptr<RtcChannel> datachannel, const protoco
     auto type = req.type();
     const std::string &parameter = req.parameter();
 
+    // the mjpeg recordings are muxed into matroska.
+    std::string extension = args.record_mjpeg ? ".mkv" : ".mp4";
     if (type == protocol::QueryFileType::LATEST_FILE || parameter.empty()) {
-        auto path = Utils::FindSecondNewestFile(args.record_path, ".mp4");
+        auto path = Utils::FindSecondNewestFile(args.record_path, extension);
         DEBUG_PRINT("LATEST: %s", path.c_str());
         SendFileResponse(datachannel, path);
     } else if (type == protocol::QueryFileType::BEFORE_FILE) {
@@ -289,7 +409,7 @@ void Conductor::QueryFile(std::shared_ptr<RtcChannel> datachannel, const protoco
             SendFileResponse(datachannel, path);
         }
     } else if (type == protocol::QueryFileType::BEFORE_TIME) {
-        auto path = Utils::FindFilesFromDatetime(args.record_path, parameter);
+        auto path = Utils::FindFilesFromDatetime(args.record_path, parameter, extension);
         DEBUG_PRINT("TIME_MATCH: %s", path.c_str());
         SendFileResponse(datachannel, path);
     }
@@ -327,18 +447,89 @@ void Conductor::TransferFile(std::shared_ptr<RtcChannel> datachannel, const prot
         return;
     }
 
-    const std::string &path = pkt.transfer_file_request().filepath();
+    const std::string &request = pkt.transfer_file_request().filepath();
+    if (request.empty()) {
+        // a request without a file stops the ongoing transfers.
+        datachannel->CancelTransfers(protocol::CommandType::TRANSFER_FILE);
+        return;
+    }
 
-    try {
-        std::ifstream file(path, std::ios::binary | std::ios::ate);
-        if (!file) {
-            ERROR_PRINT("Unable to open file: %s", path.c_str());
+    std::string path;
+    auto options = ParseTransferQuery(request, &path);
+    const std::string &stream_id = options["stream"];
+    if (!stream_id.empty()) {
+        // a resumed stream may leave out the path it was opened with.
+        auto stream_path = FindTransferStream(stream_id);
+        if (path.empty()) {
+            path = stream_path;
+        } else if (!stream_path.empty() && stream_path != path) {
+            ERROR_PRINT("Stream %s belongs to another file: %s", stream_id.c_str(),
+                        stream_path.c_str());
             return;
         }
-        datachannel->Send(file);
-        DEBUG_PRINT("Sent Video: %s", path.c_str());
+    }
+
+    auto transfer = path.empty() ? nullptr : datachannel->SendFile(path);
+    if (!transfer) {
+        ERROR_PRINT("Unable to open file: %s", request.c_str());
+        return;
+    }
+
+    size_t offset = 0;
+    size_t length = transfer->total();
+    try {
+        if (!options["offset"].empty()) {
+            offset = std::stoull(options["offset"]);
+        }
+        if (!options["length"].empty()) {
+            length = std::stoull(options["length"]);
+        }
     } catch (const std::exception &e) {
-        ERROR_PRINT("%s", e.what());
+        ERROR_PRINT("Invalid file range: %s", request.c_str());
+        return;
+    }
+    offset = std::min(offset, transfer->total());
+    length = std::min(length, transfer->total() - offset);
+
+    if (options["moov_first"] == "1") {
+        transfer->SetRanges(MoovFirstRanges(path, offset, length));
+    } else {
+        transfer->SetRanges({{offset, length}});
+    }
+    if (!stream_id.empty()) {
+        transfer->SetStreamId(stream_id);
+    }
+    SaveTransferStream(transfer->stream_id(), path);
+    transfer->OnProgress([path, next_percent = 25ul](size_t sent, size_t total) mutable {
+        if (sent * 100 >= total * next_percent) {
+            DEBUG_PRINT("Sending video %s: %lu%%", path.c_str(), next_percent);
+            next_percent += 25;
+        }
+    });
+    transfer->OnDone([path](bool is_completed) {
+        DEBUG_PRINT("%s Video: %s", is_completed ? "Sent" : "Cancelled", path.c_str());
+    });
+    datachannel->Send(transfer);
+}
+
+std::string Conductor::FindTransferStream(const std::string &stream_id) {
+    std::lock_guard<std::mutex> lock(transfer_streams_mtx_);
+    for (const auto &[id, path] : transfer_streams_) {
+        if (id == stream_id) {
+            return path;
+        }
+    }
+    return "";
+}
+
+void Conductor::SaveTransferStream(const std::string &stream_id, const std::string &path) {
+    std::lock_guard<std::mutex> lock(transfer_streams_mtx_);
+    transfer_streams_.remove_if([&stream_id](const auto &stream) {
+        return stream.first == stream_id;
+    });
+    transfer_streams_.emplace_front(stream_id, path);
+    if (transfer_streams_.size() > MAX_TRANSFER_STREAMS) {
+        transfer_streams_.pop_back();
     }
 }
 
@@ -376,14 +567,10 @@ void Conductor::ControlCar(std::shared_ptr<RtcChannel> datachannel, const protoc
     int throttle = cmd.throttle();
     int steer = cmd.steer();
 
-    // Clamp values to safe ranges
-    throttle = std::clamp(throttle, -500, 500);
-    steer = std::clamp(steer, -1000, 1000);
-
     DEBUG_PRINT("Car control: throttle=%d, steer=%d", throttle, steer);
 
-    if (uart_controller_ && uart_controller_->IsConnected()) {
-        uart_controller_->SendCommand(throttle, steer);
+    if (car_control_ && uart_controller_->IsConnected()) {
+        car_control_->Drive(throttle, steer);
     } else {
         WARN_PRINT("UART controller not available or not connected");
     }
@@ -436,7 +623,8 @@ void Conductor::InitializePeerConnectionFactory() {
     media_dependencies.audio_decoder_factory = webrtc::CreateBuiltinAudioDecoderFactory();
     media_dependencies.audio_processing = webrtc::AudioProcessingBuilder().Create();
     media_dependencies.audio_mixer = nullptr;
-    media_dependencies.video_encoder_factory = CreateCustomizedVideoEncoderFactory(args);
+    media_dependencies.video_encoder_factory =
+        CreateCustomizedVideoEncoderFactory(args, video_capture_source_);
     media_dependencies.video_decoder_factory = std::make_unique<webrtc::VideoDecoderFactoryTemplate<
         webrtc::OpenH264DecoderTemplateAdapter, webrtc::LibvpxVp8DecoderTemplateAdapter,
         webrtc::LibvpxVp9DecoderTemplateAdapter, webrtc::Dav1dDecoderTemplateAdapter>>();
@@ -451,6 +639,22 @@ void Conductor::InitializeIpcServer() {
         ipc_server_ = UnixSocketServer::Create(args.socket_path);
         ipc_server_->Start();
     }
+
+    if (ipc_server_ && args.enable_roi) {
+        // the detections are still relayed to the viewers, e.g. to draw the boxes.
+        ipc_server_->RegisterPeerCallback("roi", [](const std::string &msg) {
+            RoiController::Instance().OnMessage(msg);
+        });
+    }
+
+    if (ipc_server_ && args.publish_encoder_stats) {
+        std::weak_ptr<UnixSocketServer> ipc = ipc_server_;
+        EncoderStats::SetPublisher([ipc](const std::string &msg) {
+            if (auto ipc_server = ipc.lock()) {
+                ipc_server->Write(msg);
+            }
+        });
+    }
 }
 
 void Conductor::BindIpcToDataChannel(std::shared_ptr<RtcChannel> channel) {
@@ -484,7 +688,12 @@ void Conductor::BindDataChannelToIpcReceiver(std::shared_ptr<RtcChannel> channel
     if (!channel || !ipc_server_)
         return;
 
-    channel->RegisterHandler([this](const std::string &msg) {
+    bool accepts_roi =
+        args.enable_roi && channel->label() == ChannelModeToString(ChannelMode::Lossy);
+    channel->RegisterHandler([this, accepts_roi](const std::string &msg) {
+        if (accepts_roi && RoiController::Instance().OnMessage(msg)) {
+            return;
+        }
         ipc_server_->Write(msg);
     });
     DEBUG_PRINT("DataChannel (%s) connected to IPC server for receiving.",
@@ -4,7 +4,9 @@
 #include <condition_variable>
 #include <functional>
 #include <iostream>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include <api/peer_connection_interface.h>
@@ -13,6 +15,7 @@
 #include "args.h"
 #include "capturer/pa_capturer.h"
 #include "capturer/video_capturer.h"
+#include "common/car_control.h"
 #include "common/uart_controller.h"
 #include "rtc/rtc_peer.h"
 #include "track/scale_track_source.h"
@@ -29,27 +32,34 @@ class Conductor {
     std::shared_ptr<PaCapturer> AudioSource() const;
     std::shared_ptr<VideoCapturer> VideoSource() const;
     std::shared_ptr<UartController> GetUartController() const { return uart_controller_; }
+    std::shared_ptr<CarControl> GetCarControl() const { return car_control_; }
 
   private:
     Args args;
 
+    void InitializeVideoSource();
     void InitializePeerConnectionFactory();
     void InitializeTracks();
     void InitializeIpcServer();
     void InitializeDataChannels(rtc::scoped_refptr<RtcPeer> peer);
     void InitializeCommandChannel(rtc::scoped_refptr<RtcPeer> peer);
+    void InitializeControlChannel(rtc::scoped_refptr<RtcPeer> peer);
 
     void BindIpcToDataChannel(std::shared_ptr<RtcChannel> channel);
     void BindIpcToDataChannelSender(std::shared_ptr<RtcChannel> channel);
     void BindDataChannelToIpcReceiver(std::shared_ptr<RtcChannel> channel);
 
-    void AddTracks(rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection);
+    void AddTracks(rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection,
+                   bool is_simulcast);
+    void AddSimulcastTrack(rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection);
     void TakeSnapshot(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt);
     void QueryFile(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt);
     void TransferFile(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt);
     void ControlCamera(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt);
     void ControlCar(std::shared_ptr<RtcChannel> datachannel, const protocol::Packet &pkt);
     void SendFileResponse(std::shared_ptr<RtcChannel> datachannel, const std::string &path);
+    std::string FindTransferStream(const std::string &stream_id);
+    void SaveTransferStream(const std::string &stream_id, const std::string &path);
 
     std::unique_ptr<rtc::Thread> network_thread_;
     std::unique_ptr<rtc::Thread> worker_thread_;
@@ -64,6 +74,11 @@ class Conductor {
 
     std::shared_ptr<UnixSocketServer> ipc_server_;
     std::shared_ptr<UartController> uart_controller_;
+    std::shared_ptr<CarControl> car_control_;
+
+    // the recent file streams by id, most recent first, so a receiver can resume one.
+    std::mutex transfer_streams_mtx_;
+    std::list<std::pair<std::string, std::string>> transfer_streams_;
 };
 
 #endif // CONDUCTOR_H_
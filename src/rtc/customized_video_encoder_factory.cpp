@@ -2,6 +2,7 @@
 
 #if defined(USE_RPI_HW_ENCODER)
 #include "codecs/v4l2/v4l2_h264_encoder.h"
+#include "codecs/v4l2/v4l2_simulcast_encoder.h"
 #elif defined(USE_JETSON_HW_ENCODER)
 #include "codecs/jetson/jetson_video_encoder.h"
 #endif
@@ -12,14 +13,97 @@
 #include <modules/video_coding/codecs/vp8/include/vp8.h>
 #include <modules/video_coding/codecs/vp9/include/vp9.h>
 
-std::unique_ptr<webrtc::VideoEncoderFactory> CreateCustomizedVideoEncoderFactory(Args args) {
-    return std::make_unique<CustomizedVideoEncoderFactory>(args);
+#include "rtc/h264_passthrough_encoder.h"
+
+static std::unique_ptr<webrtc::VideoEncoder>
+CreateEncoder(const Args &args, const VpxTuning &vpx_tuning,
+              std::shared_ptr<PassthroughCameraControl> camera_control,
+              const webrtc::SdpVideoFormat &format) {
+    if (args.h264_passthrough) {
+        if (!absl::EqualsIgnoreCase(format.name, cricket::kH264CodecName) || !camera_control) {
+            return nullptr;
+        }
+        return H264PassthroughEncoder::Create(camera_control);
+    }
+
+#if defined(USE_JETSON_HW_ENCODER)
+    if (args.hw_accel) {
+        return JetsonVideoEncoder::Create(args);
+    }
+#endif
+
+    if (absl::EqualsIgnoreCase(format.name, cricket::kH264CodecName)) {
+#if defined(USE_RPI_HW_ENCODER)
+        if (args.hw_accel && args.simulcast_layers > 1) {
+            return V4L2SimulcastEncoder::Create(args);
+        } else if (args.hw_accel) {
+            return V4L2H264Encoder::Create(args);
+        }
+#endif
+        return webrtc::H264Encoder::Create(cricket::VideoCodec(format));
+    } else if (absl::EqualsIgnoreCase(format.name, cricket::kVp8CodecName)) {
+        return TunedVpxEncoder::Create(webrtc::VP8Encoder::Create(), vpx_tuning);
+    } else if (absl::EqualsIgnoreCase(format.name, cricket::kVp9CodecName)) {
+        return TunedVpxEncoder::Create(webrtc::VP9Encoder::Create(cricket::VideoCodec(format)),
+                                       vpx_tuning);
+    } else if (absl::EqualsIgnoreCase(format.name, cricket::kAv1CodecName)) {
+        return webrtc::CreateLibaomAv1Encoder();
+    }
+
+    return nullptr;
+}
+
+std::unique_ptr<webrtc::VideoEncoderFactory>
+CreateCustomizedVideoEncoderFactory(Args args, std::shared_ptr<VideoCapturer> video_src) {
+    return std::make_unique<CustomizedVideoEncoderFactory>(args, video_src);
+}
+
+CustomizedVideoEncoderFactory::CustomizedVideoEncoderFactory(
+    Args args, std::shared_ptr<VideoCapturer> video_src)
+    : args_(args),
+      vpx_tuning_({.vp8_cpu_speed = args.vp8_cpu_speed,
+                   .vp9_speed = args.vp9_speed,
+                   .threads = args.vpx_threads,
+                   .no_denoise = args.vpx_no_denoise,
+                   .screen_content = args.vpx_screen_content}) {
+    if (!args_.hw_accel && !args_.h264_passthrough) {
+        TunedVpxEncoder::InitFieldTrials(vpx_tuning_);
+    }
+    // a shared encoder schedules the keyframes itself, the one it wraps forces every request.
+    Args encoder_args = args_;
+    if (args_.shared_encoder) {
+        encoder_args.keyframe_merge_window = 0;
+        encoder_args.keyframe_min_interval = 0;
+    }
+    if (args_.h264_passthrough && video_src) {
+        camera_control_ = std::make_shared<PassthroughCameraControl>(
+            video_src,
+            KeyFrameSchedulerConfig{.merge_window_ms = encoder_args.keyframe_merge_window,
+                                    .min_interval_ms = encoder_args.keyframe_min_interval});
+    }
+    if (args_.shared_encoder) {
+        auto vpx_tuning = vpx_tuning_;
+        auto camera_control = camera_control_;
+        hub_ = std::make_shared<SharedEncoderHub>(
+            [encoder_args, vpx_tuning, camera_control](const webrtc::SdpVideoFormat &format) {
+                return CreateEncoder(encoder_args, vpx_tuning, camera_control, format);
+            },
+            static_cast<RatePolicy>(args_.shared_rate_policy),
+            KeyFrameSchedulerConfig{.merge_window_ms = args_.keyframe_merge_window,
+                                    .min_interval_ms = args_.keyframe_min_interval});
+    }
 }
 
 std::vector<webrtc::SdpVideoFormat> CustomizedVideoEncoderFactory::GetSupportedFormats() const {
     std::vector<webrtc::SdpVideoFormat> supported_codecs;
 
-    if (args_.hw_accel) {
+    if (args_.h264_passthrough) {
+        // the camera is set to constrained baseline, the only stream it can offer.
+        supported_codecs.push_back(CreateH264Format(
+            webrtc::H264Profile::kProfileConstrainedBaseline, webrtc::H264Level::kLevel4, "1"));
+        supported_codecs.push_back(CreateH264Format(
+            webrtc::H264Profile::kProfileConstrainedBaseline, webrtc::H264Level::kLevel4, "0"));
+    } else if (args_.hw_accel) {
 #if defined(USE_RPI_HW_ENCODER)
         // hw h264
         supported_codecs.push_back(CreateH264Format(
@@ -68,26 +152,8 @@ std::vector<webrtc::SdpVideoFormat> CustomizedVideoEncoderFactory::GetSupportedF
 
 std::unique_ptr<webrtc::VideoEncoder>
 CustomizedVideoEncoderFactory::CreateVideoEncoder(const webrtc::SdpVideoFormat &format) {
-#if defined(USE_JETSON_HW_ENCODER)
-    if (args_.hw_accel) {
-        return JetsonVideoEncoder::Create(args_);
+    if (hub_) {
+        return std::make_unique<SharedVideoEncoderProxy>(hub_, format);
     }
-#endif
-
-    if (absl::EqualsIgnoreCase(format.name, cricket::kH264CodecName)) {
-#if defined(USE_RPI_HW_ENCODER)
-        if (args_.hw_accel) {
-            return V4L2H264Encoder::Create(args_);
-        }
-#endif
-        return webrtc::H264Encoder::Create(cricket::VideoCodec(format));
-    } else if (absl::EqualsIgnoreCase(format.name, cricket::kVp8CodecName)) {
-        return webrtc::VP8Encoder::Create();
-    } else if (absl::EqualsIgnoreCase(format.name, cricket::kVp9CodecName)) {
-        return webrtc::VP9Encoder::Create(cricket::VideoCodec(format));
-    } else if (absl::EqualsIgnoreCase(format.name, cricket::kAv1CodecName)) {
-        return webrtc::CreateLibaomAv1Encoder();
-    }
-
-    return nullptr;
+    return CreateEncoder(args_, vpx_tuning_, camera_control_, format);
 }
@@ -4,13 +4,17 @@
 #include <api/video_codecs/video_encoder_factory.h>
 
 #include "args.h"
+#include "capturer/video_capturer.h"
+#include "rtc/h264_passthrough_encoder.h"
+#include "rtc/shared_video_encoder.h"
+#include "rtc/tuned_vpx_encoder.h"
 
-std::unique_ptr<webrtc::VideoEncoderFactory> CreateCustomizedVideoEncoderFactory(Args args);
+std::unique_ptr<webrtc::VideoEncoderFactory>
+CreateCustomizedVideoEncoderFactory(Args args, std::shared_ptr<VideoCapturer> video_src);
 
 class CustomizedVideoEncoderFactory : public webrtc::VideoEncoderFactory {
   public:
-    CustomizedVideoEncoderFactory(Args args)
-        : args_(args){};
+    CustomizedVideoEncoderFactory(Args args, std::shared_ptr<VideoCapturer> video_src);
     ~CustomizedVideoEncoderFactory() = default;
 
     std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
@@ -20,6 +24,11 @@ class CustomizedVideoEncoderFactory : public webrtc::VideoEncoderFactory {
 
   private:
     Args args_;
+    VpxTuning vpx_tuning_;
+    // the camera producing the H264 stream in passthrough mode, shared by all peers.
+    std::shared_ptr<PassthroughCameraControl> camera_control_;
+    // all peers share the encoders if set.
+    std::shared_ptr<SharedEncoderHub> hub_;
 };
 
 #endif // CUSTOMIZED_VIDEO_ENCODER_FACTORY_H_
@@ -0,0 +1,239 @@
+#include "rtc/h264_passthrough_encoder.h"
+#include "common/logging.h"
+#include "common/v4l2_frame_buffer.h"
+
+#include <algorithm>
+#include <climits>
+
+#define NAL_UNIT_TYPE_IDR 5
+#define NAL_UNIT_TYPE_SPS 7
+#define NAL_UNIT_TYPE_PPS 8
+
+PassthroughCameraControl::PassthroughCameraControl(std::shared_ptr<VideoCapturer> capturer,
+                                                   KeyFrameSchedulerConfig keyframe_config)
+    : capturer_(std::move(capturer)),
+      camera_bitrate_bps_(0),
+      keyframe_scheduler_("passthrough", keyframe_config) {}
+
+void PassthroughCameraControl::SetBitrate(const void *peer, uint32_t bitrate_bps) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    bitrates_[peer] = bitrate_bps;
+    ApplyBitrate();
+}
+
+void PassthroughCameraControl::RemovePeer(const void *peer) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (bitrates_.erase(peer) > 0) {
+        // the leaving peer may have been the one holding the rate down.
+        ApplyBitrate();
+    }
+}
+
+void PassthroughCameraControl::RequestKeyFrame(KeyFrameReason reason) {
+    keyframe_scheduler_.Request(reason);
+}
+
+void PassthroughCameraControl::OnFrame(bool is_keyframe) {
+    if (is_keyframe) {
+        keyframe_scheduler_.OnKeyFrame();
+    }
+    if (keyframe_scheduler_.ShouldForceKeyFrame() &&
+        !capturer_->SetControls(V4L2_CID_MPEG_VIDEO_FORCE_KEY_FRAME, 1)) {
+        ERROR_PRINT("Unable to force the camera to a key frame");
+    }
+}
+
+void PassthroughCameraControl::ApplyBitrate() {
+    if (bitrates_.empty()) {
+        return;
+    }
+
+    uint32_t bitrate_bps = UINT32_MAX;
+    for (const auto &it : bitrates_) {
+        bitrate_bps = std::min(bitrate_bps, it.second);
+    }
+    if (bitrate_bps == camera_bitrate_bps_) {
+        return;
+    }
+    if (!capturer_->SetControls(V4L2_CID_MPEG_VIDEO_BITRATE, bitrate_bps)) {
+        ERROR_PRINT("Unable to set the camera bitrate: %u", bitrate_bps);
+        return;
+    }
+    camera_bitrate_bps_ = bitrate_bps;
+}
+
+std::unique_ptr<webrtc::VideoEncoder>
+H264PassthroughEncoder::Create(std::shared_ptr<PassthroughCameraControl> camera_control) {
+    return std::make_unique<H264PassthroughEncoder>(std::move(camera_control));
+}
+
+H264PassthroughEncoder::H264PassthroughEncoder(
+    std::shared_ptr<PassthroughCameraControl> camera_control)
+    : camera_control_(std::move(camera_control)),
+      callback_(nullptr),
+      bitrate_adjuster_(.85, 1),
+      is_waiting_keyframe_(true),
+      last_sequence_(-1) {}
+
+H264PassthroughEncoder::~H264PassthroughEncoder() { camera_control_->RemovePeer(this); }
+
+int32_t H264PassthroughEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
+                                           const VideoEncoder::Settings &settings) {
+    codec_ = *codec_settings;
+    bitrate_adjuster_.SetTargetBitrateBps(codec_settings->startBitrate * 1000);
+
+    encoded_image_.timing_.flags = webrtc::VideoSendTiming::TimingFrameFlags::kInvalid;
+    encoded_image_.content_type_ = webrtc::VideoContentType::UNSPECIFIED;
+
+    if (codec_.codecType != webrtc::kVideoCodecH264) {
+        return WEBRTC_VIDEO_CODEC_ERROR;
+    }
+
+    // the new receiver can only start from a keyframe.
+    is_waiting_keyframe_ = true;
+    last_sequence_ = -1;
+    camera_control_->RequestKeyFrame(KeyFrameReason::NewReceiver);
+
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t
+H264PassthroughEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) {
+    callback_ = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t H264PassthroughEncoder::Release() {
+    camera_control_->RemovePeer(this);
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t H264PassthroughEncoder::Encode(const webrtc::VideoFrame &frame,
+                                       const std::vector<webrtc::VideoFrameType> *frame_types) {
+    if (!frame_types) {
+        return WEBRTC_VIDEO_CODEC_NO_OUTPUT;
+    }
+
+    if ((*frame_types)[0] == webrtc::VideoFrameType::kEmptyFrame) {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+    rtc::scoped_refptr<webrtc::VideoFrameBuffer> frame_buffer = frame.video_frame_buffer();
+
+    if (frame_buffer->type() != webrtc::VideoFrameBuffer::Type::kNative) {
+        return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+    }
+
+    auto v4l2_frame_buffer = V4L2FrameBufferRef(static_cast<V4L2FrameBuffer *>(frame_buffer.get()));
+    if (v4l2_frame_buffer->format() != V4L2_PIX_FMT_H264) {
+        return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+    }
+
+    // a frame dropped on the way, by the camera or by WebRTC, breaks the reference chain.
+    int64_t sequence = v4l2_frame_buffer->GetRawBuffer().inner.sequence;
+    if (last_sequence_ >= 0 && sequence != last_sequence_ + 1 && !is_waiting_keyframe_) {
+        DEBUG_PRINT("Frame gap %ld -> %ld, wait for the next keyframe.", (long)last_sequence_,
+                    (long)sequence);
+        is_waiting_keyframe_ = true;
+        // the receiver starts over from the next keyframe, as a new one would.
+        camera_control_->RequestKeyFrame(KeyFrameReason::NewReceiver);
+    }
+    last_sequence_ = sequence;
+
+    if ((*frame_types)[0] == webrtc::VideoFrameType::kVideoFrameKey) {
+        camera_control_->RequestKeyFrame(KeyFrameReason::ReceiverRequest);
+    }
+
+    bool is_keyframe = (v4l2_frame_buffer->flags() & V4L2_BUF_FLAG_KEYFRAME) &&
+                       IsDecodableKeyFrame(v4l2_frame_buffer->Data(), v4l2_frame_buffer->size());
+    camera_control_->OnFrame(is_keyframe);
+    if (is_waiting_keyframe_ && !is_keyframe) {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+    is_waiting_keyframe_ = false;
+
+    SendFrame(frame, v4l2_frame_buffer, is_keyframe);
+
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+void H264PassthroughEncoder::SetRates(const RateControlParameters &parameters) {
+    if (parameters.bitrate.get_sum_bps() <= 0) {
+        return;
+    }
+    bitrate_adjuster_.SetTargetBitrateBps(parameters.bitrate.get_sum_bps());
+    camera_control_->SetBitrate(this, bitrate_adjuster_.GetAdjustedBitrateBps());
+}
+
+webrtc::VideoEncoder::EncoderInfo H264PassthroughEncoder::GetEncoderInfo() const {
+    EncoderInfo info;
+    info.supports_native_handle = true;
+    info.is_hardware_accelerated = true;
+    info.implementation_name = "H264 Camera Passthrough";
+    return info;
+}
+
+void H264PassthroughEncoder::SendFrame(const webrtc::VideoFrame &frame,
+                                       V4L2FrameBufferRef frame_buffer, bool is_keyframe) {
+    auto encoded_image_buffer = webrtc::EncodedImageBuffer::Create(
+        static_cast<const uint8_t *>(frame_buffer->Data()), frame_buffer->size());
+
+    webrtc::CodecSpecificInfo codec_specific;
+    codec_specific.codecType = webrtc::kVideoCodecH264;
+    codec_specific.codecSpecific.H264.packetization_mode =
+        webrtc::H264PacketizationMode::NonInterleaved;
+
+    encoded_image_.SetEncodedData(encoded_image_buffer);
+    encoded_image_.SetTimestamp(frame.timestamp());
+    encoded_image_.SetColorSpace(frame.color_space());
+    encoded_image_._encodedWidth = frame_buffer->width();
+    encoded_image_._encodedHeight = frame_buffer->height();
+    encoded_image_.capture_time_ms_ = frame.render_time_ms();
+    encoded_image_.ntp_time_ms_ = frame.ntp_time_ms();
+    encoded_image_.rotation_ = frame.rotation();
+    encoded_image_._frameType = is_keyframe ? webrtc::VideoFrameType::kVideoFrameKey
+                                            : webrtc::VideoFrameType::kVideoFrameDelta;
+
+    auto result = callback_->OnEncodedImage(encoded_image_, &codec_specific);
+    if (result.error != webrtc::EncodedImageCallback::Result::OK) {
+        ERROR_PRINT("Failed to send the frame => %d", result.error);
+    }
+}
+
+bool H264PassthroughEncoder::IsDecodableKeyFrame(const void *start, uint32_t length) {
+    if (start == nullptr || length < 4) {
+        return false;
+    }
+
+    // the camera repeats the sequence headers, a receiver joining here needs all three.
+    bool has_idr = false;
+    bool has_sps = false;
+    bool has_pps = false;
+    const uint8_t *data = static_cast<const uint8_t *>(start);
+    for (uint32_t i = 0; i < length - 4; ++i) {
+        if (data[i] == 0x00 && data[i + 1] == 0x00 &&
+            ((data[i + 2] == 0x01) || (data[i + 2] == 0x00 && data[i + 3] == 0x01))) {
+            size_t start_code_size = (data[i + 2] == 0x01) ? 3 : 4;
+            uint8_t nal_unit_type = data[i + start_code_size] & 0x1F;
+            switch (nal_unit_type) {
+                case NAL_UNIT_TYPE_IDR:
+                    has_idr = true;
+                    break;
+                case NAL_UNIT_TYPE_SPS:
+                    has_sps = true;
+                    break;
+                case NAL_UNIT_TYPE_PPS:
+                    has_pps = true;
+                    break;
+                default:
+                    break;
+            }
+            // the slice data follows the first IDR header, no need to scan it.
+            if (has_idr) {
+                break;
+            }
+            i += start_code_size;
+        }
+    }
+
+    return has_idr && has_sps && has_pps;
+}
@@ -0,0 +1,77 @@
+#ifndef H264_PASSTHROUGH_ENCODER_H_
+#define H264_PASSTHROUGH_ENCODER_H_
+
+#include <map>
+#include <mutex>
+
+// WebRTC
+#include <api/video_codecs/video_encoder.h>
+#include <common_video/include/bitrate_adjuster.h>
+#include <modules/video_coding/codecs/h264/include/h264.h>
+
+#include "capturer/video_capturer.h"
+#include "common/keyframe_scheduler.h"
+
+/**
+ * The camera controls shared by the passthrough encoders of every peer. The
+ * camera follows the lowest bitrate any peer asks for, and the keyframe
+ * requests of all the peers go through one scheduler.
+ */
+class PassthroughCameraControl {
+  public:
+    PassthroughCameraControl(std::shared_ptr<VideoCapturer> capturer,
+                             KeyFrameSchedulerConfig keyframe_config);
+
+    void SetBitrate(const void *peer, uint32_t bitrate_bps);
+    void RemovePeer(const void *peer);
+    void RequestKeyFrame(KeyFrameReason reason);
+    // called for every camera frame by every peer.
+    void OnFrame(bool is_keyframe);
+
+  private:
+    std::shared_ptr<VideoCapturer> capturer_;
+    std::mutex mtx_;
+    std::map<const void *, uint32_t> bitrates_;
+    uint32_t camera_bitrate_bps_;
+    KeyFrameScheduler keyframe_scheduler_;
+
+    void ApplyBitrate();
+};
+
+/**
+ * Send the H264 stream of the camera as it is. The encoder controls of the
+ * WebRTC side, keyframe requests and the target bitrate, are forwarded to the
+ * camera through the shared `PassthroughCameraControl` instead.
+ */
+class H264PassthroughEncoder : public webrtc::VideoEncoder {
+  public:
+    static std::unique_ptr<webrtc::VideoEncoder>
+    Create(std::shared_ptr<PassthroughCameraControl> camera_control);
+    H264PassthroughEncoder(std::shared_ptr<PassthroughCameraControl> camera_control);
+    ~H264PassthroughEncoder() override;
+
+    int32_t InitEncode(const webrtc::VideoCodec *codec_settings,
+                       const VideoEncoder::Settings &settings) override;
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) override;
+    int32_t Release() override;
+    int32_t Encode(const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types) override;
+    void SetRates(const RateControlParameters &parameters) override;
+    webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const override;
+
+  private:
+    std::shared_ptr<PassthroughCameraControl> camera_control_;
+    webrtc::VideoCodec codec_;
+    webrtc::EncodedImage encoded_image_;
+    webrtc::EncodedImageCallback *callback_;
+    webrtc::BitrateAdjuster bitrate_adjuster_;
+    // the deltas after a missing frame are undecodable until the next keyframe.
+    bool is_waiting_keyframe_;
+    int64_t last_sequence_;
+
+    void SendFrame(const webrtc::VideoFrame &frame, V4L2FrameBufferRef frame_buffer,
+                   bool is_keyframe);
+    static bool IsDecodableKeyFrame(const void *start, uint32_t length);
+};
+
+#endif // H264_PASSTHROUGH_ENCODER_H_
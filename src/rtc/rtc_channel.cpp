@@ -1,8 +1,217 @@
 #include "rtc/rtc_channel.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include <rtc_base/time_utils.h>
+
 #include "common/logging.h"
 
-const int CHUNK_SIZE = 64 * 1024; // 64KB
+// the chunk size follows the drain rate so a chunk takes about CHUNK_DURATION_MS on the wire.
+const size_t MIN_CHUNK_SIZE = 16 * 1024;
+const size_t MAX_CHUNK_SIZE = 128 * 1024;
+const size_t INITIAL_CHUNK_SIZE = 64 * 1024;
+const int64_t CHUNK_DURATION_MS = 50;
+const int64_t DRAIN_RATE_WINDOW_MS = 200;
+// stop feeding the channel above the high watermark and resume below the low one.
+const uint64_t HIGH_WATERMARK = 1024 * 1024;
+const uint64_t LOW_WATERMARK = 256 * 1024;
+
+struct ChunkTags {
+    // the field tags of `Packet.stream_chunk` and `StreamChunk.data`.
+    std::string chunk;
+    std::string data;
+};
+
+// the tags are taken from a serialized one-byte chunk, so they follow the protocol definition.
+static const ChunkTags &GetChunkTags() {
+    static const ChunkTags tags = [] {
+        protocol::Packet pkt;
+        pkt.mutable_stream_chunk()->set_data("x");
+        std::string chunk = pkt.stream_chunk().SerializeAsString();
+        std::string packet = pkt.SerializeAsString();
+        // both lengths of the one-byte chunk fit in a single varint byte.
+        return ChunkTags{packet.substr(0, packet.size() - chunk.size() - 1),
+                         chunk.substr(0, chunk.size() - 2)};
+    }();
+    return tags;
+}
+
+static size_t VarintSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static uint8_t *WriteVarint(uint8_t *dst, uint64_t value) {
+    while (value >= 0x80) {
+        *dst++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *dst++ = static_cast<uint8_t>(value);
+    return dst;
+}
+
+std::shared_ptr<RtcTransfer> RtcTransfer::Create(protocol::CommandType type, size_t total,
+                                                 Reader reader) {
+    return std::make_shared<RtcTransfer>(type, total, std::move(reader));
+}
+
+std::shared_ptr<RtcTransfer> RtcTransfer::Create(protocol::CommandType type, std::string data) {
+    auto source = std::make_shared<std::string>(std::move(data));
+    size_t total = source->size();
+    return Create(type, total, [source](uint8_t *buf, size_t offset, size_t size) {
+        if (offset >= source->size()) {
+            return size_t(0);
+        }
+        size_t read_size = std::min(size, source->size() - offset);
+        memcpy(buf, source->data() + offset, read_size);
+        return read_size;
+    });
+}
+
+RtcTransfer::RtcTransfer(protocol::CommandType type, size_t total, Reader reader)
+    : type_(type),
+      stream_id_(Utils::GenerateUuid()),
+      total_(total),
+      ranges_({{0, total}}),
+      range_idx_(0),
+      range_sent_(0),
+      ranges_length_(total),
+      sent_(0),
+      is_cancelled_(false),
+      stage_(Stage::Header),
+      reader_(std::move(reader)) {
+    protocol::Packet pkt;
+    pkt.set_type(type_);
+    type_prefix_ = pkt.SerializeAsString();
+}
+
+void RtcTransfer::OnProgress(ProgressHandler handler) { on_progress_ = std::move(handler); }
+
+void RtcTransfer::OnDone(DoneHandler handler) { on_done_ = std::move(handler); }
+
+void RtcTransfer::SetRanges(std::vector<Range> ranges) {
+    ranges_.clear();
+    ranges_length_ = 0;
+    for (auto &range : ranges) {
+        if (range.offset >= total_) {
+            continue;
+        }
+        range.length = std::min(range.length, total_ - range.offset);
+        if (range.length > 0) {
+            ranges_.push_back(range);
+            ranges_length_ += range.length;
+        }
+    }
+}
+
+void RtcTransfer::SetStreamId(const std::string &stream_id) { stream_id_ = stream_id; }
+
+void RtcTransfer::Cancel() { is_cancelled_ = true; }
+
+protocol::CommandType RtcTransfer::type() const { return type_; }
+
+std::string RtcTransfer::stream_id() const { return stream_id_; }
+
+size_t RtcTransfer::sent() const { return sent_; }
+
+size_t RtcTransfer::total() const { return total_; }
+
+bool RtcTransfer::IsCancelled() const { return is_cancelled_; }
+
+size_t RtcTransfer::ChunkPrefixSize(const std::string &meta, size_t data_size) const {
+    const auto &tags = GetChunkTags();
+    size_t chunk_size = meta.size() + tags.data.size() + VarintSize(data_size) + data_size;
+    return type_prefix_.size() + tags.chunk.size() + VarintSize(chunk_size) + chunk_size -
+           data_size;
+}
+
+void RtcTransfer::WriteChunkPrefix(uint8_t *dst, const std::string &meta, size_t data_size) const {
+    const auto &tags = GetChunkTags();
+    size_t chunk_size = meta.size() + tags.data.size() + VarintSize(data_size) + data_size;
+    dst = std::copy(type_prefix_.begin(), type_prefix_.end(), dst);
+    dst = std::copy(tags.chunk.begin(), tags.chunk.end(), dst);
+    dst = WriteVarint(dst, chunk_size);
+    dst = std::copy(meta.begin(), meta.end(), dst);
+    dst = std::copy(tags.data.begin(), tags.data.end(), dst);
+    WriteVarint(dst, data_size);
+}
+
+bool RtcTransfer::NextPacket(rtc::CopyOnWriteBuffer *packet, size_t chunk_size) {
+    if (stage_ == Stage::Chunks) {
+        while (range_idx_ < ranges_.size() && range_sent_ == ranges_[range_idx_].length) {
+            range_idx_++;
+            range_sent_ = 0;
+        }
+
+        if (!is_cancelled_ && range_idx_ < ranges_.size()) {
+            const auto &range = ranges_[range_idx_];
+            size_t offset = range.offset + range_sent_;
+            size_t read_limit = std::min(chunk_size, range.length - range_sent_);
+
+            // the chunk is framed by hand around the payload, which is read in place.
+            protocol::StreamChunk chunk;
+            chunk.set_stream_id(stream_id_);
+            chunk.set_offset(offset);
+            std::string meta = chunk.SerializeAsString();
+
+            size_t prefix_size = ChunkPrefixSize(meta, read_limit);
+            rtc::CopyOnWriteBuffer buffer(prefix_size + read_limit);
+            uint8_t *payload = buffer.MutableData() + prefix_size;
+            size_t read_size = reader_(payload, offset, read_limit);
+            if (read_size > 0) {
+                if (read_size < read_limit) {
+                    // a shorter payload may need shorter length fields.
+                    size_t short_prefix_size = ChunkPrefixSize(meta, read_size);
+                    memmove(buffer.MutableData() + short_prefix_size, payload, read_size);
+                    prefix_size = short_prefix_size;
+                }
+                buffer.SetSize(prefix_size + read_size);
+                WriteChunkPrefix(buffer.MutableData(), meta, read_size);
+                *packet = std::move(buffer);
+
+                range_sent_ += read_size;
+                sent_ += read_size;
+                if (on_progress_) {
+                    on_progress_(sent_, ranges_length_);
+                }
+                return true;
+            }
+        }
+        // finished, cancelled, or the source ended short of the announced length.
+        stage_ = Stage::Trailer;
+    }
+
+    protocol::Packet pkt;
+    pkt.set_type(type_);
+    if (stage_ == Stage::Header) {
+        auto *header = pkt.mutable_stream_header();
+        header->set_stream_id(stream_id_);
+        header->set_total_length(total_);
+        stage_ = Stage::Chunks;
+    } else if (stage_ == Stage::Trailer) {
+        auto *trailer = pkt.mutable_stream_trailer();
+        trailer->set_stream_id(stream_id_);
+        stage_ = Stage::Done;
+    } else {
+        return false;
+    }
+
+    std::string serialized = pkt.SerializeAsString();
+    *packet = rtc::CopyOnWriteBuffer(serialized.data(), serialized.size());
+    return true;
+}
+
+void RtcTransfer::Finish() {
+    reader_ = nullptr;
+    if (on_done_) {
+        on_done_(!is_cancelled_ && sent_ == ranges_length_);
+    }
+}
 
 std::shared_ptr<RtcChannel>
 RtcChannel::Create(rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel) {
@@ -12,7 +221,12 @@ RtcChannel::Create(rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel
 RtcChannel::RtcChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel)
     : data_channel(data_channel),
       id_(Utils::GenerateUuid()),
-      label_(data_channel->label()) {
+      label_(data_channel->label()),
+      is_sending_(false),
+      is_pending_(false),
+      chunk_size_(INITIAL_CHUNK_SIZE),
+      drained_bytes_(0),
+      drain_start_ms_(-1) {
     data_channel->RegisterObserver(this);
 }
 RtcChannel::~RtcChannel() { DEBUG_PRINT("datachannel (%s) is released!", label_.c_str()); }
@@ -25,6 +239,42 @@ void RtcChannel::OnStateChange() {
     webrtc::DataChannelInterface::DataState state = data_channel->state();
     DEBUG_PRINT("[%s] OnStateChange => %s", data_channel->label().c_str(),
                 webrtc::DataChannelInterface::DataStateString(state));
+    // start the queued streams once open, drop them once closing.
+    SendQueued();
+}
+
+void RtcChannel::OnBufferedAmountChange(uint64_t sent_data_size) {
+    UpdateChunkSize(sent_data_size);
+    if (data_channel->buffered_amount() <= LOW_WATERMARK) {
+        SendQueued();
+    }
+}
+
+void RtcChannel::UpdateChunkSize(uint64_t sent_data_size) {
+    int64_t now_ms = rtc::TimeMillis();
+    if (drain_start_ms_ < 0) {
+        drain_start_ms_ = now_ms;
+        drained_bytes_ = 0;
+        return;
+    }
+    drained_bytes_ += sent_data_size;
+
+    int64_t elapsed_ms = now_ms - drain_start_ms_;
+    if (elapsed_ms < DRAIN_RATE_WINDOW_MS) {
+        return;
+    }
+    // an idle gap is not a slow link, start a new window.
+    if (elapsed_ms > DRAIN_RATE_WINDOW_MS * 5) {
+        drain_start_ms_ = now_ms;
+        drained_bytes_ = 0;
+        return;
+    }
+
+    size_t target = std::clamp<size_t>(drained_bytes_ * CHUNK_DURATION_MS / elapsed_ms,
+                                       MIN_CHUNK_SIZE, MAX_CHUNK_SIZE);
+    chunk_size_ = (chunk_size_ * 3 + target) / 4;
+    drain_start_ms_ = now_ms;
+    drained_bytes_ = 0;
 }
 
 void RtcChannel::Terminate() {
@@ -83,53 +333,91 @@ void RtcChannel::Next(const std::string &message) {
     }
 }
 
-void RtcChannel::Send(protocol::CommandType type, const uint8_t *data, size_t size) {
-    auto stream_id = Utils::GenerateUuid();
+void RtcChannel::Send(std::shared_ptr<RtcTransfer> transfer) {
+    {
+        std::lock_guard<std::mutex> lock(send_mtx_);
+        send_queue_.push_back(std::move(transfer));
+    }
+    SendQueued();
+}
 
-    protocol::Packet header_pkt;
-    header_pkt.set_type(type);
-    auto *header = header_pkt.mutable_stream_header();
-    header->set_stream_id(stream_id);
-    header->set_total_length(size);
+void RtcChannel::SendQueued() {
+    {
+        std::lock_guard<std::mutex> lock(send_mtx_);
+        if (is_sending_) {
+            is_pending_ = true;
+            return;
+        }
+        is_sending_ = true;
+    }
 
-    std::string header_buf = header_pkt.SerializeAsString();
-    Send((uint8_t *)header_buf.data(), header_buf.size());
+    // the data channel calls block on its threads, whose callbacks take the lock.
+    while (true) {
+        auto state = data_channel->state();
+        if (state == webrtc::DataChannelInterface::kClosing ||
+            state == webrtc::DataChannelInterface::kClosed) {
+            std::deque<std::shared_ptr<RtcTransfer>> dropped;
+            {
+                std::lock_guard<std::mutex> lock(send_mtx_);
+                dropped.swap(send_queue_);
+            }
+            for (auto &transfer : dropped) {
+                transfer->Cancel();
+                transfer->Finish();
+            }
+        }
 
-    size_t offset = 0;
-    while (offset < size) {
-        protocol::Packet chunk_pkt;
-        chunk_pkt.set_type(type);
-        auto *chunk = chunk_pkt.mutable_stream_chunk();
-        auto read_size = std::min((size_t)CHUNK_SIZE, size - offset);
-        chunk->set_stream_id(stream_id);
-        chunk->set_offset(offset);
-        chunk->set_data(data + offset, read_size);
+        rtc::CopyOnWriteBuffer packet;
+        while (state == webrtc::DataChannelInterface::kOpen &&
+               data_channel->buffered_amount() < HIGH_WATERMARK) {
+            std::shared_ptr<RtcTransfer> transfer;
+            {
+                std::lock_guard<std::mutex> lock(send_mtx_);
+                if (send_queue_.empty()) {
+                    break;
+                }
+                // only the sending thread pops, the front stays until it is done.
+                transfer = send_queue_.front();
+            }
+            if (!transfer->NextPacket(&packet, chunk_size_)) {
+                {
+                    std::lock_guard<std::mutex> lock(send_mtx_);
+                    send_queue_.pop_front();
+                }
+                transfer->Finish();
+                continue;
+            }
+            Send(std::move(packet));
+        }
 
-        std::string chunk_buf = chunk_pkt.SerializeAsString();
-        Send((uint8_t *)chunk_buf.data(), chunk_buf.size());
-        offset += read_size;
+        std::lock_guard<std::mutex> lock(send_mtx_);
+        if (!is_pending_) {
+            is_sending_ = false;
+            return;
+        }
+        is_pending_ = false;
     }
+}
 
-    protocol::Packet trailer_pkt;
-    trailer_pkt.set_type(type);
-    auto *trailer = trailer_pkt.mutable_stream_trailer();
-    trailer->set_stream_id(stream_id);
-
-    std::string trailer_buf = trailer_pkt.SerializeAsString();
-    Send((uint8_t *)trailer_buf.data(), trailer_buf.size());
+void RtcChannel::CancelTransfers(protocol::CommandType type) {
+    {
+        std::lock_guard<std::mutex> lock(send_mtx_);
+        for (auto &transfer : send_queue_) {
+            if (transfer->type() == type) {
+                transfer->Cancel();
+            }
+        }
+    }
+    // the cancelled streams may be waiting for a drain that never comes.
+    SendQueued();
 }
 
-void RtcChannel::Send(const uint8_t *data, size_t size) {
+void RtcChannel::Send(rtc::CopyOnWriteBuffer packet) {
     if (data_channel->state() != webrtc::DataChannelInterface::kOpen) {
         return;
     }
 
-    while (data_channel->buffered_amount() + size > data_channel->MaxSendQueueSize()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
-
-    rtc::CopyOnWriteBuffer buffer(data, size);
-    webrtc::DataBuffer data_buffer(buffer, true);
+    webrtc::DataBuffer data_buffer(std::move(packet), true);
     data_channel->Send(data_buffer);
 }
 
@@ -140,63 +428,45 @@ void RtcChannel::Send(const protocol::QueryFileResponse &response) {
         return;
     }
 
-    Send(protocol::CommandType::QUERY_FILE, (uint8_t *)body.c_str(), body.size());
+    Send(RtcTransfer::Create(protocol::CommandType::QUERY_FILE, std::move(body)));
 }
 
 void RtcChannel::Send(Buffer image) {
-    Send(protocol::CommandType::TAKE_SNAPSHOT, (uint8_t *)image.start.get(), image.length);
-    DEBUG_PRINT("Image sent: %lu bytes", image.length);
+    auto source = std::make_shared<Buffer>(std::move(image));
+    size_t total = source->length;
+    auto transfer = RtcTransfer::Create(
+        protocol::CommandType::TAKE_SNAPSHOT, total,
+        [source, total](uint8_t *buf, size_t offset, size_t size) {
+            if (offset >= total) {
+                return size_t(0);
+            }
+            size_t read_size = std::min(size, total - offset);
+            memcpy(buf, source->start.get() + offset, read_size);
+            return read_size;
+        });
+    transfer->OnDone([total](bool is_completed) {
+        DEBUG_PRINT("Image %s: %lu bytes", is_completed ? "sent" : "cancelled", total);
+    });
+    Send(transfer);
 }
 
-void RtcChannel::Send(std::ifstream &file) {
-    if (!file.is_open())
-        return;
-
-    auto type = protocol::CommandType::TRANSFER_FILE;
-
-    file.seekg(0, std::ios::end);
-    size_t total_size = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    auto stream_id = Utils::GenerateUuid();
-
-    protocol::Packet header_pkt;
-    header_pkt.set_type(type);
-    auto *header = header_pkt.mutable_stream_header();
-    header->set_stream_id(stream_id);
-    header->set_total_length(total_size);
-
-    std::string header_data = header_pkt.SerializeAsString();
-    Send((uint8_t *)header_data.data(), header_data.size());
-
-    std::vector<char> buffer(CHUNK_SIZE);
-    std::vector<uint8_t> serialization_buf(CHUNK_SIZE + 256);
-    size_t offset = 0;
-    while (file.read(buffer.data(), CHUNK_SIZE) || file.gcount() > 0) {
-        size_t read_size = file.gcount();
-
-        protocol::Packet chunk_pkt;
-        chunk_pkt.set_type(type);
-        auto *chunk = chunk_pkt.mutable_stream_chunk();
-        chunk->set_stream_id(stream_id);
-        chunk->set_offset(offset);
-        chunk->set_data(buffer.data(), read_size);
-
-        std::string chunk_data = chunk_pkt.SerializeAsString();
-        Send((uint8_t *)chunk_data.data(), chunk_data.size());
-
-        offset += read_size;
+std::shared_ptr<RtcTransfer> RtcChannel::SendFile(const std::string &path) {
+    auto file = std::make_shared<std::ifstream>(path, std::ios::binary | std::ios::ate);
+    if (!file->is_open()) {
+        return nullptr;
     }
 
-    protocol::Packet trailer_pkt;
-    trailer_pkt.set_type(type);
-    auto *trailer = trailer_pkt.mutable_stream_trailer();
-    trailer->set_stream_id(stream_id);
+    size_t total_size = file->tellg();
 
-    std::string trailer_data = trailer_pkt.SerializeAsString();
-    Send((uint8_t *)trailer_data.data(), trailer_data.size());
+    return RtcTransfer::Create(protocol::CommandType::TRANSFER_FILE, total_size,
+                               [file](uint8_t *buf, size_t offset, size_t size) {
+                                   file->clear();
+                                   file->seekg(offset, std::ios::beg);
+                                   file->read(reinterpret_cast<char *>(buf), size);
+                                   return static_cast<size_t>(file->gcount());
+                               });
 }
 
 void RtcChannel::Send(const std::string &message) {
-    Send(protocol::CommandType::CUSTOM, (uint8_t *)message.c_str(), message.length());
+    Send(RtcTransfer::Create(protocol::CommandType::CUSTOM, message));
 }
@@ -1,17 +1,98 @@
 #ifndef DATA_CHANNEL_H_
 #define DATA_CHANNEL_H_
 
+#include <atomic>
+#include <deque>
 #include <fstream>
 #include <map>
+#include <mutex>
 #include <vector>
 
 #include "proto/packet.pb.h"
 #include <api/data_channel_interface.h>
+#include <rtc_base/copy_on_write_buffer.h>
 
 #include "common/interface/subject.h"
 #include "common/utils.h"
 #include "ipc/unix_socket_server.h"
 
+/**
+ * A stream of header, chunks and trailer queued on a `RtcChannel`. The chunks
+ * are read from the source only as the channel drains, so a large file neither
+ * blocks the caller nor sits in memory. The header announces the size of the
+ * whole source and every chunk carries its offset in it, so a transfer may send
+ * only some ranges of the source, in any order.
+ */
+class RtcTransfer {
+  public:
+    // fill up to `size` bytes from `offset` of the source, 0 past its end.
+    using Reader = std::function<size_t(uint8_t *buf, size_t offset, size_t size)>;
+    // `total` is the length of the ranges to send.
+    using ProgressHandler = std::function<void(size_t sent, size_t total)>;
+    using DoneHandler = std::function<void(bool is_completed)>;
+
+    struct Range {
+        size_t offset;
+        size_t length;
+    };
+
+    static std::shared_ptr<RtcTransfer> Create(protocol::CommandType type, size_t total,
+                                               Reader reader);
+    static std::shared_ptr<RtcTransfer> Create(protocol::CommandType type, std::string data);
+
+    RtcTransfer(protocol::CommandType type, size_t total, Reader reader);
+
+    // set before the transfer is queued.
+    void OnProgress(ProgressHandler handler);
+    void OnDone(DoneHandler handler);
+    // the whole source by default.
+    void SetRanges(std::vector<Range> ranges);
+    // continue a stream the receiver already holds a part of.
+    void SetStreamId(const std::string &stream_id);
+    // safe from any thread, the receiver gets the trailer before all the announced bytes.
+    void Cancel();
+
+    protocol::CommandType type() const;
+    std::string stream_id() const;
+    size_t sent() const;
+    size_t total() const;
+    bool IsCancelled() const;
+
+    // the hand-framed `Packet` of a chunk, `meta` is its serialized `StreamChunk` without the
+    // data, and the `data_size` bytes of the data follow the prefix.
+    size_t ChunkPrefixSize(const std::string &meta, size_t data_size) const;
+    void WriteChunkPrefix(uint8_t *dst, const std::string &meta, size_t data_size) const;
+
+  private:
+    friend class RtcChannel;
+    enum class Stage {
+        Header,
+        Chunks,
+        Trailer,
+        Done
+    };
+
+    protocol::CommandType type_;
+    std::string stream_id_;
+    size_t total_;
+    std::vector<Range> ranges_;
+    size_t range_idx_;
+    size_t range_sent_;
+    size_t ranges_length_;
+    std::atomic<size_t> sent_;
+    std::atomic<bool> is_cancelled_;
+    Stage stage_;
+    Reader reader_;
+    // the serialized `Packet.type`, ahead of every chunk.
+    std::string type_prefix_;
+    ProgressHandler on_progress_;
+    DoneHandler on_done_;
+
+    // false once the trailer is out.
+    bool NextPacket(rtc::CopyOnWriteBuffer *packet, size_t chunk_size);
+    void Finish();
+};
+
 class RtcChannel : public webrtc::DataChannelObserver,
                    public std::enable_shared_from_this<RtcChannel> {
   public:
@@ -34,21 +115,26 @@ class RtcChannel : public webrtc::DataChannelObserver,
     // webrtc::DataChannelObserver
     void OnStateChange() override;
     void OnMessage(const webrtc::DataBuffer &buffer) override;
+    void OnBufferedAmountChange(uint64_t sent_data_size) override;
     void OnClosed(std::function<void()> func);
 
     void Terminate();
     void RegisterHandler(protocol::CommandType type, CommandHandler func);
     void RegisterHandler(CustomPayloadHandler func);
 
+    // the streams are sent one after another in the order they are queued.
+    void Send(std::shared_ptr<RtcTransfer> transfer);
     void Send(const protocol::QueryFileResponse &response);
     void Send(Buffer image);
-    void Send(std::ifstream &file);
     void Send(const std::string &message);
+    // not queued yet, pass it to Send() after setting its handlers. nullptr if unreadable.
+    std::shared_ptr<RtcTransfer> SendFile(const std::string &path);
+    void CancelTransfers(protocol::CommandType type);
 
   protected:
     rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel;
 
-    virtual void Send(const uint8_t *data, size_t size);
+    virtual void Send(rtc::CopyOnWriteBuffer packet);
     void Next(const std::string &message);
 
   private:
@@ -60,7 +146,19 @@ class RtcChannel : public webrtc::DataChannelObserver,
     std::vector<Subscription> subscriptions_;
     std::map<protocol::CommandType, Subject<protocol::Packet>> observers_map_;
 
-    void Send(protocol::CommandType type, const uint8_t *data, size_t size);
+    // one thread sends at a time without holding the lock, the calls meanwhile, also from the
+    // channel's own callbacks, make it go over the queue once more.
+    std::mutex send_mtx_;
+    bool is_sending_;
+    bool is_pending_;
+    std::deque<std::shared_ptr<RtcTransfer>> send_queue_;
+    // follows the rate the channel drains at.
+    std::atomic<size_t> chunk_size_;
+    uint64_t drained_bytes_;
+    int64_t drain_start_ms_;
+
+    void SendQueued();
+    void UpdateChunkSize(uint64_t sent_data_size);
 };
 
 #endif // DATA_CHANNEL_H_
@@ -71,6 +71,7 @@ void RtcPeer::Terminate() {
     if (reliable_channel_) {
         reliable_channel_->Terminate();
     }
+    control_channel_ = nullptr;
 }
 
 std::string RtcPeer::id() const { return id_; }
@@ -168,6 +169,25 @@ std::shared_ptr<RtcChannel> RtcPeer::CreateDataChannel(ChannelMode mode, int cha
     return channel;
 }
 
+std::shared_ptr<RawChannel> RtcPeer::CreateControlChannel() {
+    struct webrtc::DataChannelInit init;
+    init.ordered = false;
+    init.maxRetransmits = 0;
+    init.id = static_cast<int>(ChannelMode::Control);
+    init.negotiated = true;
+
+    auto label = ChannelModeToString(ChannelMode::Control);
+    auto result = peer_connection_->CreateDataChannelOrError(label, &init);
+    if (!result.ok()) {
+        ERROR_PRINT("Failed to create data channel: %s", label.c_str());
+        return nullptr;
+    }
+
+    DEBUG_PRINT("The Control data channel is established successfully.");
+    control_channel_ = RawChannel::Create(result.MoveValue());
+    return control_channel_;
+}
+
 void RtcPeer::CreateAnswer() {
     DEBUG_PRINT("[PEER] CreateAnswer() entered for peer id=%s", id_.c_str());
     
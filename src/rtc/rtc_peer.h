@@ -10,12 +10,14 @@
 
 #include "args.h"
 #include "common/logging.h"
+#include "rtc/raw_channel.h"
 #include "rtc/rtc_channel.h"
 
 enum ChannelMode {
     Command,
     Lossy,
-    Reliable
+    Reliable,
+    Control
 };
 
 static inline std::string ChannelModeToString(ChannelMode id) {
@@ -26,6 +28,8 @@ static inline std::string ChannelModeToString(ChannelMode id) {
             return "_lossy";
         case Reliable:
             return "_reliable";
+        case Control:
+            return "control";
         default:
             return "unknown";
     }
@@ -116,6 +120,8 @@ class RtcPeer : public webrtc::PeerConnectionObserver,
     rtc::scoped_refptr<webrtc::PeerConnectionInterface> GetPeer();
     std::shared_ptr<RtcChannel> CreateDataChannel(ChannelMode mode);
     std::shared_ptr<RtcChannel> CreateDataChannel(ChannelMode mode, int channel_id, bool negotiated);
+    // unordered and never retransmitted, a late command is worse than a lost one.
+    std::shared_ptr<RawChannel> CreateControlChannel();
     void CreateAnswer();
     std::string RestartIce(std::string ice_ufrag, std::string ice_pwd);
     void SetOnDataChannelCallback(OnRtcChannelCallback callback);
@@ -161,6 +167,7 @@ class RtcPeer : public webrtc::PeerConnectionObserver,
     std::shared_ptr<RtcChannel> cmd_channel_;
     std::shared_ptr<RtcChannel> lossy_channel_;
     std::shared_ptr<RtcChannel> reliable_channel_;
+    std::shared_ptr<RawChannel> control_channel_;
     rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer_connection_;
     rtc::VideoSinkInterface<webrtc::VideoFrame> *custom_video_sink_;
 };
@@ -36,7 +36,9 @@ void SfuChannel::OnMessage(const webrtc::DataBuffer &buffer) {
     Next(payload);
 }
 
-void SfuChannel::Send(const uint8_t *data, size_t size) { SendUserData(topic_, data, size); }
+void SfuChannel::Send(rtc::CopyOnWriteBuffer packet) {
+    SendUserData(topic_, packet.cdata(), packet.size());
+}
 
 void SfuChannel::SendUserData(const std::string &topic, const uint8_t *data, size_t size) {
     if (data_channel->state() != webrtc::DataChannelInterface::kOpen) {
@@ -24,7 +24,7 @@ class SfuChannel : public RtcChannel {
     void OnMessage(const webrtc::DataBuffer &buffer) override;
 
   protected:
-    void Send(const uint8_t *data, size_t size) override;
+    void Send(rtc::CopyOnWriteBuffer packet) override;
 
   private:
     std::string topic_;
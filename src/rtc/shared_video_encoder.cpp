@@ -0,0 +1,363 @@
+#include "rtc/shared_video_encoder.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "common/logging.h"
+#include "common/metrics.h"
+
+// unique across the shared encoders, so their per-peer series never collide.
+static std::atomic<uint32_t> next_peer_id{0};
+
+static std::string MakeEncoderKey(const webrtc::SdpVideoFormat &format,
+                                  const webrtc::VideoCodec *codec_settings) {
+    // the peers with the same order of magnitude of max bitrate share a tier.
+    int tier = 0;
+    for (unsigned int kbps = codec_settings->maxBitrate; kbps > 1; kbps >>= 1) {
+        tier++;
+    }
+    return format.ToString() + "|" + std::to_string(codec_settings->width) + "x" +
+           std::to_string(codec_settings->height) + "|" +
+           std::to_string(codec_settings->numberOfSimulcastStreams) + "|" + std::to_string(tier);
+}
+
+SharedEncoder::SharedEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder, RatePolicy policy,
+                             KeyFrameSchedulerConfig keyframe_config)
+    : policy_(policy),
+      encoder_(std::move(encoder)),
+      last_frame_us_(-1),
+      keyframe_scheduler_("shared", keyframe_config) {}
+
+SharedEncoder::~SharedEncoder() {
+    std::lock_guard<std::mutex> lock(encoder_mtx_);
+    encoder_->Release();
+}
+
+int32_t SharedEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
+                                  const webrtc::VideoEncoder::Settings &settings) {
+    std::lock_guard<std::mutex> lock(encoder_mtx_);
+    int32_t ret = encoder_->InitEncode(codec_settings, settings);
+    if (ret != WEBRTC_VIDEO_CODEC_OK) {
+        return ret;
+    }
+    encoder_->RegisterEncodeCompleteCallback(this);
+
+    std::lock_guard<std::mutex> info_lock(info_mtx_);
+    info_ = encoder_->GetEncoderInfo();
+    return ret;
+}
+
+void SharedEncoder::Attach(SharedVideoEncoderProxy *peer) {
+    std::lock_guard<std::mutex> lock(peers_mtx_);
+    peers_[peer] = Peer{.id = std::to_string(next_peer_id++)};
+}
+
+void SharedEncoder::Detach(SharedVideoEncoderProxy *peer) {
+    std::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+    std::vector<std::string> peer_metrics;
+    {
+        std::lock_guard<std::mutex> lock(peers_mtx_);
+        auto it = peers_.find(peer);
+        if (it == peers_.end()) {
+            return;
+        }
+        for (const auto &[reason, count] : it->second.keyframe_requests) {
+            peer_metrics.push_back(PeerRequestsMetric(it->second.id, reason));
+        }
+        peers_.erase(it);
+        rates = SelectRates();
+    }
+    for (const auto &name : peer_metrics) {
+        Metrics::Instance().Remove(name);
+    }
+    // the leaving peer may have been the one holding the rate down or up.
+    ApplyRates(rates);
+}
+
+void SharedEncoder::SetCallback(SharedVideoEncoderProxy *peer,
+                                webrtc::EncodedImageCallback *callback) {
+    std::lock_guard<std::mutex> lock(peers_mtx_);
+    auto it = peers_.find(peer);
+    if (it != peers_.end()) {
+        it->second.callback = callback;
+    }
+}
+
+int32_t SharedEncoder::Encode(SharedVideoEncoderProxy *peer, const webrtc::VideoFrame &frame,
+                              const std::vector<webrtc::VideoFrameType> *frame_types) {
+    bool is_key_requested =
+        frame_types && std::any_of(frame_types->begin(), frame_types->end(), [](auto type) {
+            return type == webrtc::VideoFrameType::kVideoFrameKey;
+        });
+
+    // keep the encoder lock across the check, so the frames reach the encoder in order.
+    std::lock_guard<std::mutex> lock(encoder_mtx_);
+    std::optional<KeyFrameReason> reason;
+    std::string peer_id;
+    uint64_t peer_requests = 0;
+    {
+        std::lock_guard<std::mutex> peers_lock(peers_mtx_);
+        auto it = peers_.find(peer);
+        if (is_key_requested && it != peers_.end()) {
+            reason = it->second.has_keyframe ? KeyFrameReason::ReceiverRequest
+                                             : KeyFrameReason::NewReceiver;
+            peer_id = it->second.id;
+            peer_requests = ++it->second.keyframe_requests[reason.value()];
+        }
+    }
+    // the scheduler publishes its metrics, keep it out of the peers lock.
+    if (reason) {
+        Metrics::Instance().Set(PeerRequestsMetric(peer_id, reason.value()), peer_requests);
+        keyframe_scheduler_.Request(reason.value(), peer_id);
+    }
+
+    // the same frame arrives once from every peer, only the first one is encoded.
+    if (frame.timestamp_us() <= last_frame_us_) {
+        return WEBRTC_VIDEO_CODEC_OK;
+    }
+    last_frame_us_ = frame.timestamp_us();
+    bool force_keyframe = keyframe_scheduler_.ShouldForceKeyFrame();
+
+    std::vector<webrtc::VideoFrameType> types(frame_types ? frame_types->size() : 1,
+                                              force_keyframe
+                                                  ? webrtc::VideoFrameType::kVideoFrameKey
+                                                  : webrtc::VideoFrameType::kVideoFrameDelta);
+    return encoder_->Encode(frame, &types);
+}
+
+void SharedEncoder::SetRates(SharedVideoEncoderProxy *peer,
+                             const webrtc::VideoEncoder::RateControlParameters &parameters) {
+    std::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+    {
+        std::lock_guard<std::mutex> lock(peers_mtx_);
+        auto it = peers_.find(peer);
+        if (it == peers_.end()) {
+            return;
+        }
+        it->second.rates = parameters;
+        rates = SelectRates();
+    }
+    ApplyRates(rates);
+}
+
+std::optional<webrtc::VideoEncoder::RateControlParameters> SharedEncoder::SelectRates() const {
+    std::vector<const webrtc::VideoEncoder::RateControlParameters *> candidates;
+    const webrtc::VideoEncoder::RateControlParameters *paused = nullptr;
+    for (const auto &it : peers_) {
+        if (!it.second.rates) {
+            continue;
+        }
+        // a peer paused for bandwidth must not stop the encoding for the others.
+        if (it.second.rates->bitrate.get_sum_bps() == 0) {
+            paused = &it.second.rates.value();
+            continue;
+        }
+        candidates.push_back(&it.second.rates.value());
+    }
+    if (candidates.empty()) {
+        // every peer is paused, or none has set its rates yet.
+        return paused ? std::optional(*paused) : std::nullopt;
+    }
+
+    // pick one peer's parameters as a whole, so the layer allocation stays consistent.
+    std::sort(candidates.begin(), candidates.end(), [](auto a, auto b) {
+        return a->bitrate.get_sum_bps() < b->bitrate.get_sum_bps();
+    });
+    switch (policy_) {
+        case RatePolicy::MinRate:
+            return *candidates.front();
+        case RatePolicy::MaxRate:
+            return *candidates.back();
+        default:
+            return *candidates[(candidates.size() - 1) / 2];
+    }
+}
+
+void SharedEncoder::ApplyRates(std::optional<webrtc::VideoEncoder::RateControlParameters> rates) {
+    if (!rates) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(encoder_mtx_);
+    encoder_->SetRates(rates.value());
+    Metrics::Instance().Set("webrtc_shared_encoder_bitrate_bps", rates->bitrate.get_sum_bps());
+
+    std::lock_guard<std::mutex> info_lock(info_mtx_);
+    info_ = encoder_->GetEncoderInfo();
+}
+
+webrtc::VideoEncoder::EncoderInfo SharedEncoder::GetEncoderInfo() const {
+    std::lock_guard<std::mutex> lock(info_mtx_);
+    return info_;
+}
+
+std::string SharedEncoder::PeerRequestsMetric(const std::string &peer_id, KeyFrameReason reason) {
+    return "keyframe_peer_requests_total{encoder=\"shared\",peer=\"" + peer_id + "\",reason=\"" +
+           KeyFrameScheduler::ReasonToString(reason) + "\"}";
+}
+
+size_t SharedEncoder::peer_count() {
+    std::lock_guard<std::mutex> lock(peers_mtx_);
+    return peers_.size();
+}
+
+webrtc::EncodedImageCallback::Result
+SharedEncoder::OnEncodedImage(const webrtc::EncodedImage &encoded_image,
+                              const webrtc::CodecSpecificInfo *codec_specific_info) {
+    bool is_keyframe = encoded_image._frameType == webrtc::VideoFrameType::kVideoFrameKey;
+
+    if (is_keyframe) {
+        keyframe_scheduler_.OnKeyFrame();
+    }
+
+    std::lock_guard<std::mutex> lock(peers_mtx_);
+    for (auto &it : peers_) {
+        auto &peer = it.second;
+        if (!peer.callback || (!peer.has_keyframe && !is_keyframe)) {
+            continue;
+        }
+        peer.has_keyframe = true;
+
+        auto result = peer.callback->OnEncodedImage(encoded_image, codec_specific_info);
+        if (result.error != webrtc::EncodedImageCallback::Result::OK) {
+            ERROR_PRINT("Failed to send the frame => %d", result.error);
+        }
+    }
+
+    return Result(Result::OK);
+}
+
+void SharedEncoder::OnDroppedFrame(DropReason reason) {
+    std::lock_guard<std::mutex> lock(peers_mtx_);
+    for (auto &it : peers_) {
+        if (it.second.callback) {
+            it.second.callback->OnDroppedFrame(reason);
+        }
+    }
+}
+
+SharedEncoderHub::SharedEncoderHub(EncoderCreator creator, RatePolicy policy,
+                                   KeyFrameSchedulerConfig keyframe_config)
+    : creator_(std::move(creator)),
+      policy_(policy),
+      keyframe_config_(keyframe_config) {}
+
+std::shared_ptr<SharedEncoder>
+SharedEncoderHub::Acquire(const webrtc::SdpVideoFormat &format,
+                          const webrtc::VideoCodec *codec_settings,
+                          const webrtc::VideoEncoder::Settings &settings) {
+    auto key = MakeEncoderKey(format, codec_settings);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (auto it = encoders_.begin(); it != encoders_.end();) {
+        it = it->second.expired() ? encoders_.erase(it) : std::next(it);
+    }
+
+    auto it = encoders_.find(key);
+    if (it != encoders_.end()) {
+        if (auto shared = it->second.lock()) {
+            return shared;
+        }
+    }
+
+    auto encoder = creator_(format);
+    if (!encoder) {
+        return nullptr;
+    }
+    auto shared = std::make_shared<SharedEncoder>(std::move(encoder), policy_, keyframe_config_);
+    if (shared->InitEncode(codec_settings, settings) != WEBRTC_VIDEO_CODEC_OK) {
+        ERROR_PRINT("Failed to initialize the shared encoder: %s", key.c_str());
+        return nullptr;
+    }
+    encoders_[key] = shared;
+    INFO_PRINT("Shared encoder is created: %s", key.c_str());
+
+    return shared;
+}
+
+webrtc::VideoEncoder::EncoderInfo
+SharedEncoderHub::GetEncoderInfo(const webrtc::SdpVideoFormat &format) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto key = format.ToString();
+    auto it = infos_.find(key);
+    if (it != infos_.end()) {
+        return it->second;
+    }
+
+    auto encoder = creator_(format);
+    auto info = encoder ? encoder->GetEncoderInfo() : webrtc::VideoEncoder::EncoderInfo();
+    infos_[key] = info;
+    return info;
+}
+
+void SharedEncoderHub::UpdatePeerGauge() {
+    size_t peers = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (const auto &it : encoders_) {
+            if (auto shared = it.second.lock()) {
+                peers += shared->peer_count();
+            }
+        }
+    }
+    Metrics::Instance().Set("webrtc_shared_encoder_peers", peers);
+}
+
+SharedVideoEncoderProxy::SharedVideoEncoderProxy(std::shared_ptr<SharedEncoderHub> hub,
+                                                 const webrtc::SdpVideoFormat &format)
+    : hub_(hub),
+      format_(format),
+      callback_(nullptr) {}
+
+SharedVideoEncoderProxy::~SharedVideoEncoderProxy() { Release(); }
+
+int32_t SharedVideoEncoderProxy::InitEncode(const webrtc::VideoCodec *codec_settings,
+                                            const VideoEncoder::Settings &settings) {
+    Release();
+
+    shared_ = hub_->Acquire(format_, codec_settings, settings);
+    if (!shared_) {
+        return WEBRTC_VIDEO_CODEC_ERROR;
+    }
+    shared_->Attach(this);
+    shared_->SetCallback(this, callback_);
+    hub_->UpdatePeerGauge();
+
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t
+SharedVideoEncoderProxy::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) {
+    callback_ = callback;
+    if (shared_) {
+        shared_->SetCallback(this, callback_);
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t SharedVideoEncoderProxy::Release() {
+    if (shared_) {
+        shared_->Detach(this);
+        shared_.reset();
+        hub_->UpdatePeerGauge();
+    }
+    return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t SharedVideoEncoderProxy::Encode(const webrtc::VideoFrame &frame,
+                                        const std::vector<webrtc::VideoFrameType> *frame_types) {
+    if (!shared_) {
+        return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+    }
+    return shared_->Encode(this, frame, frame_types);
+}
+
+void SharedVideoEncoderProxy::SetRates(const RateControlParameters &parameters) {
+    if (shared_) {
+        shared_->SetRates(this, parameters);
+    }
+}
+
+webrtc::VideoEncoder::EncoderInfo SharedVideoEncoderProxy::GetEncoderInfo() const {
+    return shared_ ? shared_->GetEncoderInfo() : hub_->GetEncoderInfo(format_);
+}
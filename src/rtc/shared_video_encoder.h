@@ -0,0 +1,134 @@
+#ifndef SHARED_VIDEO_ENCODER_H_
+#define SHARED_VIDEO_ENCODER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <api/video_codecs/sdp_video_format.h>
+#include <api/video_codecs/video_encoder.h>
+
+#include "common/keyframe_scheduler.h"
+
+class SharedVideoEncoderProxy;
+
+enum RatePolicy {
+    MinRate,
+    MaxRate,
+    MedianRate
+};
+
+/**
+ * A real encoder shared by the peers viewing the same stream. Each frame is
+ * encoded once, by whichever peer delivers it first, and the encoded image is
+ * fanned out to every attached peer.
+ */
+class SharedEncoder : public webrtc::EncodedImageCallback {
+  public:
+    SharedEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder, RatePolicy policy,
+                  KeyFrameSchedulerConfig keyframe_config);
+    ~SharedEncoder() override;
+
+    int32_t InitEncode(const webrtc::VideoCodec *codec_settings,
+                       const webrtc::VideoEncoder::Settings &settings);
+    void Attach(SharedVideoEncoderProxy *peer);
+    void Detach(SharedVideoEncoderProxy *peer);
+    void SetCallback(SharedVideoEncoderProxy *peer, webrtc::EncodedImageCallback *callback);
+    int32_t Encode(SharedVideoEncoderProxy *peer, const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types);
+    void SetRates(SharedVideoEncoderProxy *peer,
+                  const webrtc::VideoEncoder::RateControlParameters &parameters);
+    webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const;
+    size_t peer_count();
+
+    Result OnEncodedImage(const webrtc::EncodedImage &encoded_image,
+                          const webrtc::CodecSpecificInfo *codec_specific_info) override;
+    void OnDroppedFrame(DropReason reason) override;
+
+  private:
+    struct Peer {
+        std::string id;
+        webrtc::EncodedImageCallback *callback = nullptr;
+        // the deltas are useless to a peer until its first keyframe.
+        bool has_keyframe = false;
+        std::optional<webrtc::VideoEncoder::RateControlParameters> rates;
+        // published per reason while the peer is attached.
+        std::map<KeyFrameReason, uint64_t> keyframe_requests;
+    };
+
+    RatePolicy policy_;
+    std::mutex encoder_mtx_;
+    std::unique_ptr<webrtc::VideoEncoder> encoder_;
+    int64_t last_frame_us_;
+
+    std::mutex peers_mtx_;
+    std::map<SharedVideoEncoderProxy *, Peer> peers_;
+    KeyFrameScheduler keyframe_scheduler_;
+
+    mutable std::mutex info_mtx_;
+    webrtc::VideoEncoder::EncoderInfo info_;
+
+    std::optional<webrtc::VideoEncoder::RateControlParameters> SelectRates() const;
+    static std::string PeerRequestsMetric(const std::string &peer_id, KeyFrameReason reason);
+    void ApplyRates(std::optional<webrtc::VideoEncoder::RateControlParameters> rates);
+};
+
+/**
+ * Keep one `SharedEncoder` per codec, resolution and bitrate tier.
+ */
+class SharedEncoderHub {
+  public:
+    using EncoderCreator =
+        std::function<std::unique_ptr<webrtc::VideoEncoder>(const webrtc::SdpVideoFormat &)>;
+
+    SharedEncoderHub(EncoderCreator creator, RatePolicy policy,
+                     KeyFrameSchedulerConfig keyframe_config);
+
+    // Return the running encoder matching the settings, or create one.
+    std::shared_ptr<SharedEncoder> Acquire(const webrtc::SdpVideoFormat &format,
+                                           const webrtc::VideoCodec *codec_settings,
+                                           const webrtc::VideoEncoder::Settings &settings);
+    // The info of the codec before any encoder is initialized.
+    webrtc::VideoEncoder::EncoderInfo GetEncoderInfo(const webrtc::SdpVideoFormat &format);
+    // Publish the number of peers attached to all the running encoders.
+    void UpdatePeerGauge();
+
+  private:
+    EncoderCreator creator_;
+    RatePolicy policy_;
+    KeyFrameSchedulerConfig keyframe_config_;
+    std::mutex mtx_;
+    std::map<std::string, std::weak_ptr<SharedEncoder>> encoders_;
+    std::map<std::string, webrtc::VideoEncoder::EncoderInfo> infos_;
+};
+
+/**
+ * The per-peer encoder handed to WebRTC, it forwards everything to the shared one.
+ */
+class SharedVideoEncoderProxy : public webrtc::VideoEncoder {
+  public:
+    SharedVideoEncoderProxy(std::shared_ptr<SharedEncoderHub> hub,
+                            const webrtc::SdpVideoFormat &format);
+    ~SharedVideoEncoderProxy() override;
+
+    int32_t InitEncode(const webrtc::VideoCodec *codec_settings,
+                       const VideoEncoder::Settings &settings) override;
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) override;
+    int32_t Release() override;
+    int32_t Encode(const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types) override;
+    void SetRates(const RateControlParameters &parameters) override;
+    webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const override;
+
+  private:
+    std::shared_ptr<SharedEncoderHub> hub_;
+    webrtc::SdpVideoFormat format_;
+    webrtc::EncodedImageCallback *callback_;
+    std::shared_ptr<SharedEncoder> shared_;
+};
+
+#endif // SHARED_VIDEO_ENCODER_H_
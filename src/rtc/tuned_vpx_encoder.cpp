@@ -0,0 +1,104 @@
+#include "rtc/tuned_vpx_encoder.h"
+
+#include <algorithm>
+#include <string>
+
+#include <system_wrappers/include/field_trial.h>
+
+#include "common/logging.h"
+
+// larger than any frame, so one speed applies to every resolution.
+const int MAX_FRAME_PIXELS = 7680 * 4320;
+
+// the field trials are referenced, not copied, so they must outlive the encoders.
+static std::string vpx_field_trials;
+
+void TunedVpxEncoder::InitFieldTrials(VpxTuning &tuning) {
+    std::string field_trials;
+    if (tuning.vp8_cpu_speed > 0) {
+        tuning.vp8_cpu_speed = std::clamp(tuning.vp8_cpu_speed, 4, 16);
+        // the vp8 speed is only honoured on arm, x86 keeps WebRTC's own.
+        std::string vp8_speed = std::to_string(-tuning.vp8_cpu_speed);
+        field_trials += "WebRTC-VP8-CpuSpeed-Arm/pixels:" + std::to_string(MAX_FRAME_PIXELS) +
+                        ",cpu_speed:" + vp8_speed + ",cpu_speed_le_cores:" + vp8_speed + "/";
+    }
+    if (tuning.vp9_speed > 0) {
+        tuning.vp9_speed = std::clamp(tuning.vp9_speed, 5, 9);
+        std::string vp9_speed = std::to_string(tuning.vp9_speed);
+        field_trials += "WebRTC-VP9-PerformanceFlags/min_pixel_count:0,base_layer_speed:" +
+                        vp9_speed + ",high_layer_speed:" + vp9_speed + ",deblock_mode:0/";
+    }
+    if (field_trials.empty()) {
+        return;
+    }
+    vpx_field_trials = field_trials;
+    webrtc::field_trial::InitFieldTrialsFromString(vpx_field_trials.c_str());
+
+    DEBUG_PRINT("Software vpx encoders: vp8 speed %d, vp9 speed %d", tuning.vp8_cpu_speed,
+                tuning.vp9_speed);
+}
+
+std::unique_ptr<webrtc::VideoEncoder>
+TunedVpxEncoder::Create(std::unique_ptr<webrtc::VideoEncoder> encoder, VpxTuning tuning) {
+    return std::make_unique<TunedVpxEncoder>(std::move(encoder), tuning);
+}
+
+TunedVpxEncoder::TunedVpxEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder, VpxTuning tuning)
+    : encoder_(std::move(encoder)),
+      tuning_(tuning) {}
+
+void TunedVpxEncoder::SetFecControllerOverride(
+    webrtc::FecControllerOverride *fec_controller_override) {
+    encoder_->SetFecControllerOverride(fec_controller_override);
+}
+
+int32_t TunedVpxEncoder::InitEncode(const webrtc::VideoCodec *codec_settings,
+                                    const VideoEncoder::Settings &settings) {
+    webrtc::VideoCodec codec = *codec_settings;
+    if (tuning_.screen_content) {
+        codec.mode = webrtc::VideoCodecMode::kScreensharing;
+    }
+    // the denoiser costs about as much as the encoding itself at the fast speeds.
+    if (tuning_.no_denoise && codec.codecType == webrtc::kVideoCodecVP8) {
+        codec.VP8()->denoisingOn = false;
+    } else if (tuning_.no_denoise && codec.codecType == webrtc::kVideoCodecVP9) {
+        codec.VP9()->denoisingOn = false;
+    }
+
+    // libvpx derives its threads from the cores and the resolution.
+    VideoEncoder::Settings tuned_settings = settings;
+    if (tuning_.threads > 0) {
+        tuned_settings.number_of_cores = tuning_.threads;
+    }
+
+    return encoder_->InitEncode(&codec, tuned_settings);
+}
+
+int32_t TunedVpxEncoder::RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) {
+    return encoder_->RegisterEncodeCompleteCallback(callback);
+}
+
+int32_t TunedVpxEncoder::Release() { return encoder_->Release(); }
+
+int32_t TunedVpxEncoder::Encode(const webrtc::VideoFrame &frame,
+                                const std::vector<webrtc::VideoFrameType> *frame_types) {
+    return encoder_->Encode(frame, frame_types);
+}
+
+void TunedVpxEncoder::SetRates(const RateControlParameters &parameters) {
+    encoder_->SetRates(parameters);
+}
+
+void TunedVpxEncoder::OnPacketLossRateUpdate(float packet_loss_rate) {
+    encoder_->OnPacketLossRateUpdate(packet_loss_rate);
+}
+
+void TunedVpxEncoder::OnRttUpdate(int64_t rtt_ms) { encoder_->OnRttUpdate(rtt_ms); }
+
+void TunedVpxEncoder::OnLossNotification(const LossNotification &loss_notification) {
+    encoder_->OnLossNotification(loss_notification);
+}
+
+webrtc::VideoEncoder::EncoderInfo TunedVpxEncoder::GetEncoderInfo() const {
+    return encoder_->GetEncoderInfo();
+}
@@ -0,0 +1,51 @@
+#ifndef TUNED_VPX_ENCODER_H_
+#define TUNED_VPX_ENCODER_H_
+
+#include <memory>
+
+#include <api/video_codecs/video_encoder.h>
+
+/**
+ * The knobs of WebRTC's libvpx encoders worth turning on a small board. The
+ * defaults leave WebRTC's own settings untouched.
+ */
+struct VpxTuning {
+    int vp8_cpu_speed = 0; // 4 to 16, higher is faster and blurrier, 0: WebRTC's
+    int vp9_speed = 0;     // 5 to 9, higher is faster and blurrier, 0: WebRTC's
+    int threads = 0;       // 0: all the cores
+    bool no_denoise = false;
+    bool screen_content = false;
+};
+
+/**
+ * Run a software VP8/VP9 encoder with the `VpxTuning` on top of WebRTC's
+ * defaults. The threads, denoiser and content mode go into its settings, the
+ * speeds into the field trials libvpx reads them from.
+ */
+class TunedVpxEncoder : public webrtc::VideoEncoder {
+  public:
+    // publish the speeds set, before any encoder is created.
+    static void InitFieldTrials(VpxTuning &tuning);
+    static std::unique_ptr<webrtc::VideoEncoder>
+    Create(std::unique_ptr<webrtc::VideoEncoder> encoder, VpxTuning tuning);
+    TunedVpxEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder, VpxTuning tuning);
+
+    void SetFecControllerOverride(webrtc::FecControllerOverride *fec_controller_override) override;
+    int32_t InitEncode(const webrtc::VideoCodec *codec_settings,
+                       const VideoEncoder::Settings &settings) override;
+    int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback *callback) override;
+    int32_t Release() override;
+    int32_t Encode(const webrtc::VideoFrame &frame,
+                   const std::vector<webrtc::VideoFrameType> *frame_types) override;
+    void SetRates(const RateControlParameters &parameters) override;
+    void OnPacketLossRateUpdate(float packet_loss_rate) override;
+    void OnRttUpdate(int64_t rtt_ms) override;
+    void OnLossNotification(const LossNotification &loss_notification) override;
+    webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const override;
+
+  private:
+    std::unique_ptr<webrtc::VideoEncoder> encoder_;
+    VpxTuning tuning_;
+};
+
+#endif // TUNED_VPX_ENCODER_H_
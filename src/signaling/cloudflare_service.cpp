@@ -545,6 +545,7 @@ void CloudflareService::SubscribeToControlDataChannel(const std::string &control
                     // Wrap in RawChannel for JSON messages (not Protobuf)
                     auto raw_channel = RawChannel::Create(data_channel_interface);
                     service->control_channel_ = raw_channel;
+                    service->control_session_ = nullptr;
 
                     // Register JSON message handler
                     raw_channel->SetMessageHandler([service](const std::string &message) {
@@ -571,6 +572,7 @@ void CloudflareService::SubscribeToControlDataChannel(const std::string &control
             // Wrap in RawChannel for JSON messages (not Protobuf)
             auto raw_channel = RawChannel::Create(data_channel_interface);
             service->control_channel_ = raw_channel;
+            service->control_session_ = nullptr;
 
             // Register JSON message handler
             raw_channel->SetMessageHandler([service](const std::string &message) {
@@ -582,16 +584,28 @@ void CloudflareService::SubscribeToControlDataChannel(const std::string &control
 }
 
 void CloudflareService::ProcessControlMessage(const std::string &json_message) {
+    auto car_control = conductor ? conductor->GetCarControl() : nullptr;
+    // the compact binary commands share the channel with the json ones.
+    auto reply = [channel = std::weak_ptr<RawChannel>(control_channel_)](
+                     const std::string &response) {
+        if (auto control_channel = channel.lock()) {
+            control_channel->Send(response);
+        }
+    };
+    if (car_control && !control_session_) {
+        // a new control channel starts its own sequence.
+        control_session_ = car_control->CreateSession();
+    }
+    if (car_control && car_control->OnMessage(*control_session_, json_message, reply)) {
+        return;
+    }
+
     try {
         auto data = nlohmann::json::parse(json_message);
 
         int throttle = data.value("throttle", 0);
         int steer = data.value("steer", 0);
 
-        // Clamp values to safe ranges
-        throttle = std::clamp(throttle, -500, 500);
-        steer = std::clamp(steer, -1000, 1000);
-
         // Log occasionally to reduce spam
         static int msg_count = 0;
         if ((throttle != 0 || steer != 0) && (msg_count++ % 100 == 0)) {
@@ -599,10 +613,10 @@ void CloudflareService::ProcessControlMessage(const std::string &json_message) {
         }
 
         // Send to UART controller via Conductor
-        if (conductor && conductor->config().enable_uart_control) {
+        if (car_control) {
             auto uart = conductor->GetUartController();
             if (uart && uart->IsConnected()) {
-                uart->SendCommand(throttle, steer);
+                car_control->Drive(throttle, steer);
             } else {
                 WARN_PRINT("UART controller not connected");
             }
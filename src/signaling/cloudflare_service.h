@@ -7,6 +7,8 @@
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 
+#include "common/car_control.h"
+
 // Forward declaration
 class RawChannel;
 
@@ -66,6 +68,7 @@ class CloudflareService : public SignalingService,
     rtc::scoped_refptr<RtcPeer> video_peer_;
     rtc::scoped_refptr<RtcPeer> control_peer_;
     std::shared_ptr<RawChannel> control_channel_;
+    std::shared_ptr<CarControl::Session> control_session_;
 
     // Config from Args
     std::string cf_app_id_;
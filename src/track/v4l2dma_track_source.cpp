@@ -7,6 +7,11 @@
 #endif
 #include "common/logging.h"
 
+#include <algorithm>
+
+// the sizes WebRTC's adaptation keeps switching between under congestion.
+const size_t MAX_CACHED_SCALERS = 3;
+
 rtc::scoped_refptr<V4L2DmaTrackSource>
 V4L2DmaTrackSource::Create(std::shared_ptr<VideoCapturer> capturer) {
     auto obj = rtc::make_ref_counted<V4L2DmaTrackSource>(std::move(capturer));
@@ -16,11 +21,9 @@ V4L2DmaTrackSource::Create(std::shared_ptr<VideoCapturer> capturer) {
 
 V4L2DmaTrackSource::V4L2DmaTrackSource(std::shared_ptr<VideoCapturer> capturer)
     : ScaleTrackSource(capturer),
-      is_dma_src_(capturer->is_dma_capture()),
-      config_width_(capturer->width()),
-      config_height_(capturer->height()) {}
+      is_dma_src_(capturer->is_dma_capture()) {}
 
-V4L2DmaTrackSource::~V4L2DmaTrackSource() { scaler.reset(); }
+V4L2DmaTrackSource::~V4L2DmaTrackSource() { scalers_.clear(); }
 
 void V4L2DmaTrackSource::StartTrack() {
     subscription_ = capturer->Subscribe(
@@ -48,18 +51,15 @@ void V4L2DmaTrackSource::OnFrameCaptured(V4L2FrameBufferRef frame_buffer) {
             return;
         }
 
-        if (!scaler || adapted_width != config_width_ || adapted_height != config_height_) {
-            config_width_ = adapted_width;
-            config_height_ = adapted_height;
+        auto scaler = AcquireScaler(frame_buffer->format(), adapted_width, adapted_height);
+        if (!scaler) {
+            return;
+        }
 #if defined(USE_RPI_HW_ENCODER)
-            scaler = V4L2Scaler::Create(width, height, frame_buffer->format(), config_width_,
-                                        config_height_, is_dma_src_, true);
+        static_cast<V4L2Scaler *>(scaler)->SetCrop(crop_x, crop_y, crop_width, crop_height);
 #elif defined(USE_JETSON_HW_ENCODER)
-            scaler = JetsonScaler::Create(width, height, config_width_, config_height_);
+        static_cast<JetsonScaler *>(scaler)->SetCrop(crop_x, crop_y, crop_width, crop_height);
 #endif
-            DEBUG_PRINT("New scaler is set: %dx%d -> %dx%d", width, height, config_width_,
-                        config_height_);
-        }
 
         scaler->EmplaceBuffer(frame_buffer,
                               [this, translated_timestamp_us](V4L2FrameBufferRef scaled_buffer) {
@@ -71,3 +71,34 @@ void V4L2DmaTrackSource::OnFrameCaptured(V4L2FrameBufferRef frame_buffer) {
                               });
     }
 }
+
+IFrameProcessor *V4L2DmaTrackSource::AcquireScaler(uint32_t src_format, int dst_width,
+                                                   int dst_height) {
+    auto it = std::find_if(scalers_.begin(), scalers_.end(), [&](const ScalerEntry &entry) {
+        return entry.width == dst_width && entry.height == dst_height;
+    });
+    if (it != scalers_.end()) {
+        scalers_.splice(scalers_.begin(), scalers_, it);
+        return scalers_.front().scaler.get();
+    }
+
+    std::unique_ptr<IFrameProcessor> scaler;
+#if defined(USE_RPI_HW_ENCODER)
+    scaler = V4L2Scaler::Create(width, height, src_format, dst_width, dst_height, is_dma_src_,
+                                true);
+#elif defined(USE_JETSON_HW_ENCODER)
+    scaler = JetsonScaler::Create(width, height, dst_width, dst_height);
+#endif
+    if (!scaler) {
+        ERROR_PRINT("Failed to create the scaler: %dx%d -> %dx%d", width, height, dst_width,
+                    dst_height);
+        return nullptr;
+    }
+    DEBUG_PRINT("New scaler is set: %dx%d -> %dx%d", width, height, dst_width, dst_height);
+
+    scalers_.push_front({dst_width, dst_height, std::move(scaler)});
+    if (scalers_.size() > MAX_CACHED_SCALERS) {
+        scalers_.pop_back();
+    }
+    return scalers_.front().scaler.get();
+}
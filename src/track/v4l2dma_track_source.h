@@ -1,6 +1,8 @@
 #ifndef V4L2DMA_TRACK_SOURCE_H_
 #define V4L2DMA_TRACK_SOURCE_H_
 
+#include <list>
+
 #include "common/interface/processor.h"
 #include "track/scale_track_source.h"
 
@@ -12,13 +14,19 @@ class V4L2DmaTrackSource : public ScaleTrackSource {
     void StartTrack() override;
 
   private:
+    struct ScalerEntry {
+        int width;
+        int height;
+        std::unique_ptr<IFrameProcessor> scaler;
+    };
+
     bool is_dma_src_;
-    int config_width_;
-    int config_height_;
     Subscription subscription_;
-    std::unique_ptr<IFrameProcessor> scaler;
+    // the scalers of the recent output sizes, the most recently used first.
+    std::list<ScalerEntry> scalers_;
 
     void OnFrameCaptured(V4L2FrameBufferRef frame_buffer);
+    IFrameProcessor *AcquireScaler(uint32_t src_format, int dst_width, int dst_height);
 };
 
 #endif